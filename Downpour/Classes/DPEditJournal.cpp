@@ -0,0 +1,220 @@
+//
+//  DPEditJournal.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPEditJournal.h"
+#include "DPLevelSaver.h"
+#include <cstdio>
+#include <cstring>
+
+#define kDPEditJournalMagic   0x4A455044
+#define kDPEditJournalVersion 1
+
+namespace DP
+{
+	static bool ReadFile(const std::string &path, std::vector<uint8> &bytes)
+	{
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if(!file)
+			return false;
+		
+		std::fseek(file, 0, SEEK_END);
+		long length = std::ftell(file);
+		std::fseek(file, 0, SEEK_SET);
+		
+		bytes.resize((length > 0) ? static_cast<size_t>(length) : 0);
+		bool result = (std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+		
+		std::fclose(file);
+		return result;
+	}
+	
+	static uint64 GetFileLength(const std::string &path)
+	{
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if(!file)
+			return 0;
+		
+		std::fseek(file, 0, SEEK_END);
+		long length = std::ftell(file);
+		std::fclose(file);
+		
+		return (length > 0) ? static_cast<uint64>(length) : 0;
+	}
+	
+	EditJournal::EditJournal() :
+		_file(nullptr),
+		_length(0)
+	{}
+	
+	EditJournal::~EditJournal()
+	{
+		Close();
+	}
+	
+	bool EditJournal::Open(const std::string &levelPath, const std::function<void (Entry, WireReader &)> &replay)
+	{
+		Close();
+		
+		uint64 levelLength = GetFileLength(levelPath);
+		std::vector<uint8> bytes;
+		size_t valid = sizeof(Header);
+		
+		if(ReadFile(GetJournalPath(levelPath), bytes) && bytes.size() >= sizeof(Header))
+		{
+			Header header;
+			std::memcpy(&header, bytes.data(), sizeof(Header));
+			
+			if(header.magic == kDPEditJournalMagic && header.version == kDPEditJournalVersion && header.levelLength == levelLength)
+			{
+				WireReader reader(bytes.data() + sizeof(Header), bytes.size() - sizeof(Header));
+				
+				while(!reader.IsAtEnd())
+				{
+					Entry entry = static_cast<Entry>(reader.ReadUInt8());
+					size_t length = reader.ReadUInt32();
+					const uint8 *payload = reader.ReadBytesInPlace(length);
+					
+					if(!reader.IsValid() || !payload)
+						break;
+					
+					WireReader entryReader(payload, length);
+					replay(entry, entryReader);
+					
+					valid = sizeof(Header) + reader.GetOffset();
+				}
+			}
+			else
+			{
+				RNInfo("Downpour: Dropping the journal of %s, the level was written without it", levelPath.c_str());
+			}
+		}
+		
+		// Rewriting cuts off a torn entry, appending behind it would make everything after it unreadable
+		const uint8 *entries = (valid > sizeof(Header) && bytes.size() >= valid) ? bytes.data() + sizeof(Header) : nullptr;
+		return Rewrite(levelPath, levelLength, entries, entries ? valid - sizeof(Header) : 0);
+	}
+	
+	void EditJournal::Close()
+	{
+		if(_file)
+		{
+			std::fclose(_file);
+			_file = nullptr;
+		}
+		
+		_levelPath.clear();
+		_length = 0;
+	}
+	
+	void EditJournal::Append(Entry entry, const WireWriter &writer)
+	{
+		if(!_file)
+			return;
+		
+		uint8 type = static_cast<uint8>(entry);
+		uint32 length = static_cast<uint32>(writer.GetLength());
+		
+		bool result = (std::fwrite(&type, sizeof(uint8), 1, _file) == 1);
+		result = result && (std::fwrite(&length, sizeof(uint32), 1, _file) == 1);
+		result = result && (std::fwrite(writer.GetBytes(), 1, length, _file) == length);
+		result = result && (std::fflush(_file) == 0);
+		
+		if(!result)
+		{
+			RNError("Downpour: Couldn't append to the journal of %s, edits are no longer journaled", _levelPath.c_str());
+			Close();
+			return;
+		}
+		
+		_length += sizeof(uint8) + sizeof(uint32) + length;
+	}
+	
+	bool EditJournal::HasEntries(const std::string &levelPath)
+	{
+		FILE *file = std::fopen(GetJournalPath(levelPath).c_str(), "rb");
+		if(!file)
+			return false;
+		
+		Header header;
+		bool result = (std::fread(&header, sizeof(Header), 1, file) == 1 && std::fgetc(file) != EOF);
+		
+		std::fclose(file);
+		
+		// Only a journal that Open() would replay counts
+		return (result && header.magic == kDPEditJournalMagic && header.version == kDPEditJournalVersion && header.levelLength == GetFileLength(levelPath));
+	}
+	
+	bool EditJournal::Compact(size_t offset, const std::string &levelPath, uint64 levelLength)
+	{
+		if(!_file)
+			return false;
+		
+		// Only the entries appended while the level was written are kept
+		std::vector<uint8> bytes(_length - std::min(offset, _length));
+		
+		std::fflush(_file);
+		std::fseek(_file, static_cast<long>(sizeof(Header) + _length - bytes.size()), SEEK_SET);
+		
+		bool result = (std::fread(bytes.data(), 1, bytes.size(), _file) == bytes.size());
+		std::string previous = GetJournalPath(_levelPath);
+		
+		if(!result || !Rewrite(levelPath, levelLength, bytes.data(), bytes.size()))
+			return false;
+		
+		if(previous != GetJournalPath(levelPath))
+			std::remove(previous.c_str());
+		
+		return true;
+	}
+	
+	bool EditJournal::Rewrite(const std::string &levelPath, uint64 levelLength, const uint8 *entries, size_t length)
+	{
+		Close();
+		
+		std::string path = GetJournalPath(levelPath);
+		std::string temporary = path + ".saving";
+		
+		Header header;
+		header.magic = kDPEditJournalMagic;
+		header.version = kDPEditJournalVersion;
+		header.levelLength = levelLength;
+		
+		FILE *file = std::fopen(temporary.c_str(), "wb");
+		if(!file)
+			return false;
+		
+		bool result = (std::fwrite(&header, sizeof(Header), 1, file) == 1);
+		result = result && (length == 0 || std::fwrite(entries, 1, length, file) == length);
+		result = (std::fclose(file) == 0 && result);
+		
+		if(!result || !LevelSaver::ReplaceFile(temporary, path))
+		{
+			std::remove(temporary.c_str());
+			return false;
+		}
+		
+		// Appending mode still allows reading the entries back when compacting
+		_file = std::fopen(path.c_str(), "a+b");
+		if(!_file)
+			return false;
+		
+		_levelPath = levelPath;
+		_length = length;
+		
+		return true;
+	}
+}
@@ -0,0 +1,80 @@
+//
+//  DPEditJournal.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPEDITJOURNAL_H__
+#define __DPEDITJOURNAL_H__
+
+#include <Rayne/Rayne.h>
+#include <functional>
+#include "DPWireBuffer.h"
+
+#define kDPEditJournalDefaultCompactLength (4 * 1024 * 1024)
+
+namespace DP
+{
+	// An append only file next to a level that records every committed edit since the level was last saved.
+	// Entries are flushed as they are appended, so they survive the editor crashing. The header remembers the
+	// length of the level the entries apply to, a journal left behind by an older version of the level is dropped.
+	class EditJournal
+	{
+	public:
+		enum class Entry : uint8
+		{
+			Create,
+			Delete,
+			Transform,
+			Property,
+			Sculpt
+		};
+		
+		EditJournal();
+		~EditJournal();
+		
+		// The entries already in the journal are handed to the function first, a torn last entry is discarded
+		bool Open(const std::string &levelPath, const std::function<void (Entry, WireReader &)> &replay);
+		void Close();
+		
+		bool IsOpen() const { return (_file != nullptr); }
+		const std::string &GetLevelPath() const { return _levelPath; }
+		size_t GetLength() const { return _length; }
+		
+		void Append(Entry entry, const WireWriter &writer);
+		
+		// Drops the entries before the offset once a save contains them, the journal then belongs to the
+		// saved level, which may be a different one when it was saved under a new name
+		bool Compact(size_t offset, const std::string &levelPath, uint64 levelLength);
+		
+		static std::string GetJournalPath(const std::string &levelPath) { return levelPath + ".journal"; }
+		static bool HasEntries(const std::string &levelPath);
+		
+	private:
+		struct Header
+		{
+			uint32 magic;
+			uint32 version;
+			uint64 levelLength;
+		};
+		
+		bool Rewrite(const std::string &levelPath, uint64 levelLength, const uint8 *entries, size_t length);
+		
+		FILE *_file;
+		std::string _levelPath;
+		size_t _length;
+	};
+}
+
+#endif /* __DPEDITJOURNAL_H__ */
@@ -17,6 +17,7 @@
 
 #include "DPGizmo.h"
 #include "DPWorkspace.h"
+#include "DPWorldAttachment.h"
 
 namespace DP
 {
@@ -200,6 +201,8 @@ namespace DP
 		SetHighlight(-1);
 		SetHighlight(selection, 3.0f);
 		_previousMouse = mousePos;
+		
+		WorldAttachment::GetSharedInstance()->BeginContinuousEdit();
 	}
 	
 	void Gizmo::ContinueMove(const RN::Vector2 &mousePos)
@@ -233,6 +236,9 @@ namespace DP
 	
 	void Gizmo::EndMove()
 	{
+		if(_active)
+			WorldAttachment::GetSharedInstance()->EndContinuousEdit();
+		
 		_active = false;
 		SetHighlight(-1);
 	}
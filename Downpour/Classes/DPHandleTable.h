@@ -0,0 +1,272 @@
+//
+//  DPHandleTable.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPHANDLETABLE_H__
+#define __DPHANDLETABLE_H__
+
+#include <Rayne/Rayne.h>
+
+namespace DP
+{
+	// Identifies a node across the session, independent of the LID the engine assigns locally.
+	// The low 32 bits are the slot index plus one, the high 32 bits the generation of the slot,
+	// so 0 is never a valid handle and a handle of a removed node never resolves to its successor.
+	typedef uint64 NetworkHandle;
+	
+	// Dense slot map from handles to values. Lookups are an index and a generation check, freed slots are
+	// reused through a free list. The server allocates handles, clients mirror them with InsertAt().
+	// Handles can also be reserved up front and handed out to a client, which fills them in with InsertAt().
+	template<class T>
+	class HandleTable
+	{
+	public:
+		HandleTable() :
+			_count(0),
+			_freeList(kInvalidIndex),
+			_isFreeListDirty(false)
+		{}
+		
+		static uint32 GetIndex(NetworkHandle handle) { return static_cast<uint32>(handle & 0xffffffff) - 1; }
+		static uint32 GetGeneration(NetworkHandle handle) { return static_cast<uint32>(handle >> 32); }
+		static NetworkHandle MakeHandle(uint32 index, uint32 generation) { return (static_cast<uint64>(generation) << 32) | (static_cast<uint64>(index) + 1); }
+		
+		void Reserve(size_t count)
+		{
+			_slots.reserve(count);
+		}
+		
+		NetworkHandle Insert(const T &value)
+		{
+			if(_isFreeListDirty)
+				RebuildFreeList();
+			
+			uint32 index = _freeList;
+			
+			if(index == kInvalidIndex)
+			{
+				index = static_cast<uint32>(_slots.size());
+				_slots.emplace_back();
+			}
+			else
+			{
+				_freeList = _slots[index].nextFree;
+			}
+			
+			Slot &slot = _slots[index];
+			slot.value = value;
+			slot.isUsed = true;
+			
+			_count ++;
+			
+			return MakeHandle(index, slot.generation);
+		}
+		
+		// Takes count slots out of circulation without filling them, until they are either inserted at or released
+		void Allocate(size_t count, std::vector<NetworkHandle> &handles)
+		{
+			if(_isFreeListDirty)
+				RebuildFreeList();
+			
+			handles.reserve(handles.size() + count);
+			
+			for(size_t i = 0; i < count; i ++)
+			{
+				uint32 index = _freeList;
+				
+				if(index == kInvalidIndex)
+				{
+					index = static_cast<uint32>(_slots.size());
+					_slots.emplace_back();
+				}
+				else
+				{
+					_freeList = _slots[index].nextFree;
+				}
+				
+				_slots[index].isReserved = true;
+				handles.push_back(MakeHandle(index, _slots[index].generation));
+			}
+		}
+		
+		bool IsReserved(NetworkHandle handle) const
+		{
+			uint32 index = GetIndex(handle);
+			return (index < _slots.size() && _slots[index].isReserved && _slots[index].generation == GetGeneration(handle));
+		}
+		
+		// Returns a reserved handle that was never inserted at back into circulation
+		bool Release(NetworkHandle handle)
+		{
+			if(!IsReserved(handle))
+				return false;
+			
+			uint32 index = GetIndex(handle);
+			Slot &slot = _slots[index];
+			
+			slot.generation ++;
+			slot.isReserved = false;
+			
+			if(!_isFreeListDirty)
+			{
+				slot.nextFree = _freeList;
+				_freeList = index;
+			}
+			
+			return true;
+		}
+		
+		// Puts the value under a handle allocated elsewhere, replacing whatever the slot held
+		bool InsertAt(NetworkHandle handle, const T &value)
+		{
+			if((handle & 0xffffffff) == 0)
+				return false;
+			
+			uint32 index = GetIndex(handle);
+			
+			if(index >= _slots.size())
+				_slots.resize(index + 1);
+			
+			Slot &slot = _slots[index];
+			
+			if(!slot.isUsed)
+				_count ++;
+			
+			slot.value = value;
+			slot.generation = GetGeneration(handle);
+			slot.isUsed = true;
+			slot.isReserved = false;
+			
+			// The slot may be anywhere in the free list, which is simply rebuilt before it is needed next
+			_isFreeListDirty = true;
+			return true;
+		}
+		
+		bool Remove(NetworkHandle handle)
+		{
+			Slot *slot = GetSlot(handle);
+			if(!slot)
+				return false;
+			
+			slot->value = T();
+			slot->generation ++;
+			slot->isUsed = false;
+			
+			if(!_isFreeListDirty)
+			{
+				slot->nextFree = _freeList;
+				_freeList = GetIndex(handle);
+			}
+			
+			_count --;
+			return true;
+		}
+		
+		T Get(NetworkHandle handle) const
+		{
+			const Slot *slot = GetSlot(handle);
+			return slot ? slot->value : T();
+		}
+		
+		bool Contains(NetworkHandle handle) const
+		{
+			return (GetSlot(handle) != nullptr);
+		}
+		
+		void Clear()
+		{
+			_slots.clear();
+			_count = 0;
+			_freeList = kInvalidIndex;
+			_isFreeListDirty = false;
+		}
+		
+		size_t GetCount() const { return _count; }
+		
+		template<class F>
+		void Enumerate(F &&function) const
+		{
+			for(size_t i = 0; i < _slots.size(); i ++)
+			{
+				const Slot &slot = _slots[i];
+				
+				if(slot.isUsed)
+					function(MakeHandle(static_cast<uint32>(i), slot.generation), slot.value);
+			}
+		}
+		
+	private:
+		static const uint32 kInvalidIndex = 0xffffffff;
+		
+		struct Slot
+		{
+			Slot() :
+				value(),
+				generation(0),
+				nextFree(kInvalidIndex),
+				isUsed(false),
+				isReserved(false)
+			{}
+			
+			T value;
+			uint32 generation;
+			uint32 nextFree;
+			bool isUsed;
+			bool isReserved;
+		};
+		
+		Slot *GetSlot(NetworkHandle handle)
+		{
+			return const_cast<Slot *>(static_cast<const HandleTable *>(this)->GetSlot(handle));
+		}
+		
+		const Slot *GetSlot(NetworkHandle handle) const
+		{
+			uint32 index = GetIndex(handle);
+			
+			if(index >= _slots.size())
+				return nullptr;
+			
+			const Slot &slot = _slots[index];
+			return (slot.isUsed && slot.generation == GetGeneration(handle)) ? &slot : nullptr;
+		}
+		
+		void RebuildFreeList()
+		{
+			_freeList = kInvalidIndex;
+			
+			for(size_t i = _slots.size(); i > 0; i --)
+			{
+				Slot &slot = _slots[i - 1];
+				
+				if(!slot.isUsed && !slot.isReserved)
+				{
+					slot.nextFree = _freeList;
+					_freeList = static_cast<uint32>(i - 1);
+				}
+			}
+			
+			_isFreeListDirty = false;
+		}
+		
+		std::vector<Slot> _slots;
+		size_t _count;
+		uint32 _freeList;
+		bool _isFreeListDirty;
+	};
+}
+
+#endif /* __DPHANDLETABLE_H__ */
@@ -0,0 +1,240 @@
+//
+//  DPInterestManager.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPInterestManager.h"
+
+namespace DP
+{
+	InterestManager::InterestManager() :
+		_cellSize(kDPInterestDefaultCellSize)
+	{}
+	
+	void InterestManager::SetCellSize(float size)
+	{
+		RN_ASSERT(size > 0.0f, "The cell size must be larger than 0!");
+		
+		// Cells of indexed nodes and subscribed regions are only valid for the size they were computed with
+		_cellSize = size;
+		_nodes.clear();
+		
+		for(auto &pair : _subscriptions)
+			pair.second.hasRegion = false;
+	}
+	
+	InterestManager::Cell InterestManager::GetCell(const RN::Vector3 &position) const
+	{
+		Cell cell;
+		cell.x = static_cast<int32>(std::floor(position.x / _cellSize));
+		cell.z = static_cast<int32>(std::floor(position.z / _cellSize));
+		
+		return cell;
+	}
+	
+	
+	void InterestManager::AddPeer(uint32 peer, uint32 hostID)
+	{
+		Subscription subscription;
+		subscription.hostID = hostID;
+		subscription.hasRegion = false;
+		subscription.isCongested = false;
+		
+		_subscriptions[peer] = std::move(subscription);
+	}
+	
+	void InterestManager::RemovePeer(uint32 peer)
+	{
+		_subscriptions.erase(peer);
+	}
+	
+	uint32 InterestManager::GetHostID(uint32 peer) const
+	{
+		auto iterator = _subscriptions.find(peer);
+		return (iterator != _subscriptions.end()) ? iterator->second.hostID : static_cast<uint32>(-1);
+	}
+	
+	void InterestManager::SetRegion(uint32 peer, const RN::Vector3 &center, float radius)
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator == _subscriptions.end())
+			return;
+		
+		radius = std::max(0.0f, radius);
+		
+		Subscription &subscription = iterator->second;
+		subscription.hasRegion = true;
+		subscription.minimum = GetCell(RN::Vector3(center.x - radius, 0.0f, center.z - radius));
+		subscription.maximum = GetCell(RN::Vector3(center.x + radius, 0.0f, center.z + radius));
+	}
+	
+	void InterestManager::SetSelection(uint32 peer, const std::vector<NetworkHandle> &selection)
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator == _subscriptions.end())
+			return;
+		
+		iterator->second.selection.clear();
+		iterator->second.selection.insert(selection.begin(), selection.end());
+	}
+	
+	
+	void InterestManager::SetCongested(uint32 peer, bool congested)
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator != _subscriptions.end())
+			iterator->second.isCongested = congested;
+	}
+	
+	bool InterestManager::IsCongested(uint32 peer) const
+	{
+		auto iterator = _subscriptions.find(peer);
+		return (iterator != _subscriptions.end() && iterator->second.isCongested);
+	}
+	
+	void InterestManager::UpdateNode(NetworkHandle handle, const RN::Vector3 &position)
+	{
+		_nodes[handle] = GetCell(position);
+	}
+	
+	void InterestManager::RemoveNode(NetworkHandle handle)
+	{
+		_nodes.erase(handle);
+		
+		for(auto &pair : _subscriptions)
+		{
+			pair.second.selection.erase(handle);
+			pair.second.staleTransforms.erase(handle);
+			pair.second.staleProperties.erase(handle);
+		}
+	}
+	
+	
+	bool InterestManager::IsInterested(const Subscription &subscription, NetworkHandle handle, uint32 hostID) const
+	{
+		// A peer always hears back about its own changes, the sequencer on its side depends on that
+		if(subscription.hostID == hostID)
+			return true;
+		
+		if(subscription.isCongested)
+			return false;
+		
+		if(!subscription.hasRegion)
+			return true;
+		
+		if(subscription.selection.count(handle) > 0)
+			return true;
+		
+		// Nodes that aren't indexed yet are sent to everyone rather than risk missing them
+		auto iterator = _nodes.find(handle);
+		if(iterator == _nodes.end())
+			return true;
+		
+		const Cell &cell = iterator->second;
+		
+		return (cell.x >= subscription.minimum.x && cell.x <= subscription.maximum.x &&
+				cell.z >= subscription.minimum.z && cell.z <= subscription.maximum.z);
+	}
+	
+	bool InterestManager::IsInterested(uint32 peer, NetworkHandle handle, uint32 hostID) const
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator == _subscriptions.end())
+			return false;
+		
+		return IsInterested(iterator->second, handle, hostID);
+	}
+	
+	
+	void InterestManager::MarkStale(uint32 peer, NetworkHandle handle)
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator != _subscriptions.end())
+			iterator->second.staleTransforms.insert(handle);
+	}
+	
+	void InterestManager::MarkStale(uint32 peer, NetworkHandle handle, const std::string &property)
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator != _subscriptions.end())
+			iterator->second.staleProperties[handle].insert(property);
+	}
+	
+	void InterestManager::CollectCatchUp(uint32 peer, bool interestingOnly, size_t limit, CatchUp &catchUp)
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator == _subscriptions.end())
+			return;
+		
+		Subscription &subscription = iterator->second;
+		size_t count = 0;
+		
+		// The host ID of the server never matches a peer, so only the region and selection are checked here
+		for(auto stale = subscription.staleTransforms.begin(); stale != subscription.staleTransforms.end() && count < limit;)
+		{
+			if(interestingOnly && !IsInterested(subscription, *stale, 0))
+			{
+				stale ++;
+				continue;
+			}
+			
+			catchUp.transforms.push_back(*stale);
+			stale = subscription.staleTransforms.erase(stale);
+			count ++;
+		}
+		
+		for(auto stale = subscription.staleProperties.begin(); stale != subscription.staleProperties.end() && count < limit;)
+		{
+			if(interestingOnly && !IsInterested(subscription, stale->first, 0))
+			{
+				stale ++;
+				continue;
+			}
+			
+			for(const std::string &property : stale->second)
+				catchUp.properties.emplace_back(stale->first, property);
+			
+			count += stale->second.size();
+			stale = subscription.staleProperties.erase(stale);
+		}
+	}
+	
+	
+	bool InterestManager::HasStaleState(uint32 peer) const
+	{
+		auto iterator = _subscriptions.find(peer);
+		if(iterator == _subscriptions.end())
+			return false;
+		
+		return (!iterator->second.staleTransforms.empty() || !iterator->second.staleProperties.empty());
+	}
+	
+	std::vector<uint32> InterestManager::GetPeers() const
+	{
+		std::vector<uint32> peers;
+		peers.reserve(_subscriptions.size());
+		
+		for(auto &pair : _subscriptions)
+			peers.push_back(pair.first);
+		
+		return peers;
+	}
+	
+	void InterestManager::Reset()
+	{
+		_nodes.clear();
+		_subscriptions.clear();
+	}
+}
@@ -0,0 +1,107 @@
+//
+//  DPInterestManager.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPINTERESTMANAGER_H__
+#define __DPINTERESTMANAGER_H__
+
+#include <Rayne/Rayne.h>
+#include "DPHandleTable.h"
+
+#define kDPInterestDefaultCellSize  64.0f
+#define kDPInterestDefaultRadius    512.0f
+#define kDPInterestCatchUpInterval  1.0f
+#define kDPInterestCatchUpLimit     256
+#define kDPInterestCongestedCatchUpLimit 64
+
+namespace DP
+{
+	// Lives on the server and decides which peer has to hear about which scene node.
+	// Nodes are indexed by the cell of a grid on the XZ plane they are in, every peer subscribes to the rectangle
+	// of cells covered by the region around its editor camera plus everything it has selected. Changes a peer isn't
+	// interested in are remembered as stale and caught up with the current state at a low rate, or right away once
+	// the node comes into the peers region. Peers that haven't published a region yet are interested in everything.
+	// A congested peer is interested in nothing but its own changes, everything else is caught up once it has room.
+	class InterestManager
+	{
+	public:
+		struct CatchUp
+		{
+			std::vector<NetworkHandle> transforms;
+			std::vector<std::pair<NetworkHandle, std::string>> properties;
+		};
+		
+		InterestManager();
+		
+		void SetCellSize(float size);
+		float GetCellSize() const { return _cellSize; }
+		
+		void AddPeer(uint32 peer, uint32 hostID);
+		void RemovePeer(uint32 peer);
+		
+		// The host ID the peer was given on connect, -1 for unknown peers
+		uint32 GetHostID(uint32 peer) const;
+		
+		void SetRegion(uint32 peer, const RN::Vector3 &center, float radius);
+		void SetSelection(uint32 peer, const std::vector<NetworkHandle> &selection);
+		
+		void SetCongested(uint32 peer, bool congested);
+		bool IsCongested(uint32 peer) const;
+		
+		void UpdateNode(NetworkHandle handle, const RN::Vector3 &position);
+		void RemoveNode(NetworkHandle handle);
+		
+		bool IsInterested(uint32 peer, NetworkHandle handle, uint32 hostID) const;
+		
+		void MarkStale(uint32 peer, NetworkHandle handle);
+		void MarkStale(uint32 peer, NetworkHandle handle, const std::string &property);
+		void CollectCatchUp(uint32 peer, bool interestingOnly, size_t limit, CatchUp &catchUp);
+		bool HasStaleState(uint32 peer) const;
+		
+		std::vector<uint32> GetPeers() const;
+		void Reset();
+		
+	private:
+		struct Cell
+		{
+			int32 x;
+			int32 z;
+		};
+		
+		struct Subscription
+		{
+			uint32 hostID;
+			bool hasRegion;
+			bool isCongested;
+			Cell minimum;
+			Cell maximum;
+			
+			std::unordered_set<NetworkHandle> selection;
+			std::unordered_set<NetworkHandle> staleTransforms;
+			std::unordered_map<NetworkHandle, std::unordered_set<std::string>> staleProperties;
+		};
+		
+		Cell GetCell(const RN::Vector3 &position) const;
+		bool IsInterested(const Subscription &subscription, NetworkHandle handle, uint32 hostID) const;
+		
+		float _cellSize;
+		
+		std::unordered_map<NetworkHandle, Cell> _nodes;
+		std::unordered_map<uint32, Subscription> _subscriptions;
+	};
+}
+
+#endif /* __DPINTERESTMANAGER_H__ */
@@ -0,0 +1,187 @@
+//
+//  DPLevelFile.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "DPLevelFile.h"
+#include <cstdio>
+#include <cstring>
+
+#define kDPLevelFileMagic   0x464C5044
+#define kDPLevelFileVersion 1
+
+namespace DP
+{
+	LevelFile::Writer::Writer(float chunkSize, RN::Data *shell) :
+		_chunkSize(chunkSize),
+		_shell(shell->Retain()),
+		_length(sizeof(Header) + shell->GetLength())
+	{}
+	
+	LevelFile::Writer::~Writer()
+	{
+		for(LevelSaver::Piece &piece : _pieces)
+		{
+			if(piece.data)
+				piece.data->Release();
+		}
+		
+		_shell->Release();
+	}
+	
+	void LevelFile::Writer::AddChunk(int32 x, int32 z, RN::Data *data)
+	{
+		_pieces.emplace_back(data->Retain());
+		_chunks.push_back({ x, z, _length, data->GetLength() });
+		
+		_length += data->GetLength();
+	}
+	
+	void LevelFile::Writer::CopyChunk(const Chunk &chunk)
+	{
+		_pieces.emplace_back(chunk.offset, chunk.length);
+		_chunks.push_back({ chunk.x, chunk.z, _length, chunk.length });
+		
+		_length += chunk.length;
+	}
+	
+	std::vector<LevelSaver::Piece> LevelFile::Writer::GetPieces() const
+	{
+		Header header;
+		header.magic = kDPLevelFileMagic;
+		header.version = kDPLevelFileVersion;
+		header.chunkSize = _chunkSize;
+		header.chunkCount = static_cast<uint32>(_chunks.size());
+		header.shellOffset = sizeof(Header);
+		header.shellLength = _shell->GetLength();
+		header.tableOffset = _length;
+		
+		RN::Data *headerData = new RN::Data(&header, sizeof(Header), false, false);
+		RN::Data *tableData = new RN::Data(_chunks.data(), _chunks.size() * sizeof(Chunk), false, false);
+		
+		std::vector<LevelSaver::Piece> pieces;
+		pieces.reserve(_pieces.size() + 3);
+		
+		pieces.emplace_back(headerData->Autorelease());
+		pieces.emplace_back(_shell);
+		pieces.insert(pieces.end(), _pieces.begin(), _pieces.end());
+		pieces.emplace_back(tableData->Autorelease());
+		
+		return pieces;
+	}
+	
+	
+	LevelFile::LevelFile() :
+		_chunkSize(kDPLevelFileDefaultChunkSize),
+		_shellOffset(0),
+		_shellLength(0)
+	{}
+	
+	bool LevelFile::ReadHeader(FILE *file, Header &header)
+	{
+		if(std::fread(&header, sizeof(Header), 1, file) != 1)
+			return false;
+		
+		return (header.magic == kDPLevelFileMagic && header.version == kDPLevelFileVersion);
+	}
+	
+	bool LevelFile::Open(const std::string &path)
+	{
+		Close();
+		
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if(!file)
+			return false;
+		
+		Header header;
+		std::vector<Chunk> chunks;
+		bool result = ReadHeader(file, header);
+		
+		if(result)
+		{
+			chunks.resize(header.chunkCount);
+			result = (LevelSaver::Seek(file, header.tableOffset) && std::fread(chunks.data(), sizeof(Chunk), chunks.size(), file) == chunks.size());
+		}
+		
+		std::fclose(file);
+		
+		if(!result)
+			return false;
+		
+		_path = path;
+		_chunkSize = header.chunkSize;
+		_shellOffset = header.shellOffset;
+		_shellLength = header.shellLength;
+		_chunks = std::move(chunks);
+		
+		for(size_t i = 0; i < _chunks.size(); i ++)
+			_chunkIndices[GetChunkKey(_chunks[i].x, _chunks[i].z)] = i;
+		
+		return true;
+	}
+	
+	void LevelFile::Close()
+	{
+		_path.clear();
+		_chunks.clear();
+		_chunkIndices.clear();
+	}
+	
+	const LevelFile::Chunk *LevelFile::GetChunk(int32 x, int32 z) const
+	{
+		auto iterator = _chunkIndices.find(GetChunkKey(x, z));
+		return (iterator != _chunkIndices.end()) ? &_chunks[iterator->second] : nullptr;
+	}
+	
+	RN::Data *LevelFile::Read(uint64 offset, uint64 length) const
+	{
+		FILE *file = std::fopen(_path.c_str(), "rb");
+		if(!file)
+			return nullptr;
+		
+		std::vector<uint8> bytes(static_cast<size_t>(length));
+		bool result = (LevelSaver::Seek(file, offset) && std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+		
+		std::fclose(file);
+		
+		if(!result)
+			return nullptr;
+		
+		RN::Data *data = new RN::Data(bytes.data(), bytes.size(), false, false);
+		return data->Autorelease();
+	}
+	
+	RN::Data *LevelFile::ReadShell() const
+	{
+		return Read(_shellOffset, _shellLength);
+	}
+	
+	RN::Data *LevelFile::ReadChunk(const Chunk &chunk) const
+	{
+		return Read(chunk.offset, chunk.length);
+	}
+	
+	bool LevelFile::IsLevelFile(const std::string &path)
+	{
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if(!file)
+			return false;
+		
+		Header header;
+		bool result = ReadHeader(file, header);
+		
+		std::fclose(file);
+		return result;
+	}
+}
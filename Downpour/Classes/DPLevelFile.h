@@ -0,0 +1,105 @@
+//
+//  DPLevelFile.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef __DPLEVELFILE_H__
+#define __DPLEVELFILE_H__
+
+#include <Rayne/Rayne.h>
+#include "DPLevelSaver.h"
+
+#define kDPLevelFileDefaultChunkSize 64.0f
+
+namespace DP
+{
+	// A level split into chunks on a grid over the xz plane. The shell holds the world without any of the
+	// chunked scene nodes, every chunk holds the root nodes positioned in its cell, encoded on their own.
+	// The table of chunks sits at the end of the file so that a new version can be written front to back,
+	// with chunks that didn't change copied byte for byte from the previous version.
+	class LevelFile
+	{
+	public:
+		struct Chunk
+		{
+			int32 x;
+			int32 z;
+			uint64 offset;
+			uint64 length;
+		};
+		
+		class Writer
+		{
+		public:
+			Writer(float chunkSize, RN::Data *shell);
+			~Writer();
+			
+			void AddChunk(int32 x, int32 z, RN::Data *data);
+			void CopyChunk(const Chunk &chunk);
+			
+			// The pieces reference the data added to the writer and the ranges of the copied chunks
+			std::vector<LevelSaver::Piece> GetPieces() const;
+			
+		private:
+			float _chunkSize;
+			RN::Data *_shell;
+			std::vector<LevelSaver::Piece> _pieces;
+			std::vector<Chunk> _chunks;
+			uint64 _length;
+		};
+		
+		LevelFile();
+		
+		bool Open(const std::string &path);
+		void Close();
+		
+		bool IsOpen() const { return !_path.empty(); }
+		const std::string &GetPath() const { return _path; }
+		float GetChunkSize() const { return _chunkSize; }
+		
+		const std::vector<Chunk> &GetChunks() const { return _chunks; }
+		const Chunk *GetChunk(int32 x, int32 z) const;
+		
+		RN::Data *ReadShell() const;
+		RN::Data *ReadChunk(const Chunk &chunk) const;
+		
+		static bool IsLevelFile(const std::string &path);
+		static uint64 GetChunkKey(int32 x, int32 z) { return (static_cast<uint64>(static_cast<uint32>(x)) << 32) | static_cast<uint32>(z); }
+		
+	private:
+		struct Header
+		{
+			uint32 magic;
+			uint32 version;
+			float chunkSize;
+			uint32 chunkCount;
+			uint64 shellOffset;
+			uint64 shellLength;
+			uint64 tableOffset;
+		};
+		
+		static bool ReadHeader(FILE *file, Header &header);
+		RN::Data *Read(uint64 offset, uint64 length) const;
+		
+		std::string _path;
+		float _chunkSize;
+		uint64 _shellOffset;
+		uint64 _shellLength;
+		
+		std::vector<Chunk> _chunks;
+		std::unordered_map<uint64, size_t> _chunkIndices;
+	};
+}
+
+#endif /* __DPLEVELFILE_H__ */
@@ -0,0 +1,101 @@
+//
+//  DPLevelLoader.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "DPLevelLoader.h"
+#include <cstdio>
+
+namespace DP
+{
+	LevelLoader::LevelLoader(const std::string &path, const std::vector<LevelFile::Chunk> &chunks) :
+		_path(path),
+		_chunks(chunks),
+		_decoded(0),
+		_queueLength(0),
+		_cancelled(false)
+	{
+		// Reading the chunks front to back keeps the disk access sequential
+		std::sort(_chunks.begin(), _chunks.end(), [](const LevelFile::Chunk &a, const LevelFile::Chunk &b) {
+			return (a.offset < b.offset);
+		});
+		
+		_thread = std::thread(&LevelLoader::Run, this);
+	}
+	
+	LevelLoader::~LevelLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_cancelled.store(true);
+		}
+		
+		_condition.notify_all();
+		
+		if(_thread.joinable())
+			_thread.join();
+	}
+	
+	void LevelLoader::Run()
+	{
+		FILE *file = std::fopen(_path.c_str(), "rb");
+		
+		for(const LevelFile::Chunk &entry : _chunks)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_lock);
+				_condition.wait(lock, [&]{ return (_cancelled.load() || _queue.empty() || _queueLength < kDPLevelLoaderQueueLength); });
+			}
+			
+			if(_cancelled.load())
+				break;
+			
+			Chunk chunk;
+			chunk.chunk = entry;
+			chunk.bytes.resize(static_cast<size_t>(entry.length));
+			chunk.isValid = (file && LevelSaver::Seek(file, entry.offset) && std::fread(chunk.bytes.data(), 1, chunk.bytes.size(), file) == chunk.bytes.size());
+			
+			if(!chunk.isValid)
+				chunk.bytes.clear();
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_queueLength += chunk.bytes.size();
+			_queue.push_back(std::move(chunk));
+		}
+		
+		if(file)
+			std::fclose(file);
+	}
+	
+	bool LevelLoader::PopChunk(Chunk &chunk)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(_queue.empty())
+				return false;
+			
+			chunk = std::move(_queue.front());
+			_queue.pop_front();
+			
+			_queueLength -= chunk.bytes.size();
+		}
+		
+		_condition.notify_one();
+		_decoded ++;
+		
+		return true;
+	}
+}
@@ -0,0 +1,75 @@
+//
+//  DPLevelLoader.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef __DPLEVELLOADER_H__
+#define __DPLEVELLOADER_H__
+
+#include <Rayne/Rayne.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include "DPLevelFile.h"
+
+#define kDPLevelLoaderQueueLength (64 * 1024 * 1024)
+
+// Milliseconds per frame the main thread spends decoding chunks while a level is opened
+#define kDPLevelLoaderDefaultStepTime 8
+
+namespace DP
+{
+	// Reads chunks of a level file on a thread of its own, in the order they are stored in, while the
+	// main thread decodes the ones that already arrived. The reader stops once the chunks waiting to be
+	// decoded add up to the queue length, so a slow decode doesn't pull the whole level into memory.
+	class LevelLoader
+	{
+	public:
+		struct Chunk
+		{
+			LevelFile::Chunk chunk;
+			std::vector<uint8> bytes;
+			bool isValid;
+		};
+		
+		LevelLoader(const std::string &path, const std::vector<LevelFile::Chunk> &chunks);
+		~LevelLoader();
+		
+		const std::string &GetPath() const { return _path; }
+		size_t GetChunkCount() const { return _chunks.size(); }
+		size_t GetDecodedCount() const { return _decoded; }
+		
+		// Hands out the next chunk that was read, chunks that couldn't be read come without their bytes
+		bool PopChunk(Chunk &chunk);
+		bool IsFinished() const { return (_decoded == _chunks.size()); }
+		
+	private:
+		void Run();
+		
+		std::string _path;
+		std::vector<LevelFile::Chunk> _chunks;
+		size_t _decoded;
+		std::thread _thread;
+		
+		std::mutex _lock;
+		std::condition_variable _condition;
+		std::deque<Chunk> _queue;
+		size_t _queueLength;
+		std::atomic<bool> _cancelled;
+	};
+}
+
+#endif /* __DPLEVELLOADER_H__ */
@@ -0,0 +1,1071 @@
+//
+//  DPLevelManager.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPLevelManager.h"
+#include "DPWorldAttachment.h"
+#include "DPWorkspace.h"
+#include "DPInfoPanel.h"
+
+namespace DP
+{
+	static size_t GetSizeSetting(RN::String *key, size_t defaultValue)
+	{
+		RN::Number *number = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(key);
+		return number ? number->GetUint32Value() : defaultValue;
+	}
+	
+	static void CollectSceneNodes(RN::SceneNode *node, std::vector<RN::SceneNode *> &nodes)
+	{
+		nodes.push_back(node);
+		
+		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *child, size_t i, bool &stop) {
+			CollectSceneNodes(child, nodes);
+		});
+	}
+	
+	static float GetLevelChunkSizeSetting()
+	{
+		RN::Number *number = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(RNCSTR("DPLevelChunkSize"));
+		return (number && number->GetFloatValue() > 0.0f) ? number->GetFloatValue() : kDPLevelFileDefaultChunkSize;
+	}
+	
+	static RN::SceneNode *GetRootSceneNode(RN::SceneNode *node)
+	{
+		while(node->GetParent())
+			node = node->GetParent();
+		
+		return node;
+	}
+	
+	static void WriteTransform(WireWriter &writer, RN::SceneNode *node)
+	{
+		RN::Vector3 position = node->GetPosition();
+		RN::Vector3 scale = node->GetScale();
+		RN::Quaternion rotation = node->GetRotation();
+		
+		writer.WriteFloat(position.x);
+		writer.WriteFloat(position.y);
+		writer.WriteFloat(position.z);
+		writer.WriteFloat(scale.x);
+		writer.WriteFloat(scale.y);
+		writer.WriteFloat(scale.z);
+		writer.WriteFloat(rotation.x);
+		writer.WriteFloat(rotation.y);
+		writer.WriteFloat(rotation.z);
+		writer.WriteFloat(rotation.w);
+	}
+	
+	static RN::Vector3 ReadVector(WireReader &reader)
+	{
+		RN::Vector3 vector;
+		vector.x = reader.ReadFloat();
+		vector.y = reader.ReadFloat();
+		vector.z = reader.ReadFloat();
+		
+		return vector;
+	}
+	
+	LevelManager::LevelManager(WorldAttachment *attachment, RN::RecursiveSpinLock &lock) :
+		_attachment(attachment),
+		_lock(lock),
+		_levelSaver(nullptr),
+		_saveProgress(nullptr),
+		_levelChunkSize(kDPLevelFileDefaultChunkSize),
+		_isLevelDirty(false),
+		_isEncodingLevel(false),
+		_levelLoader(nullptr),
+		_loadProgress(nullptr),
+		_levelLoadStepTime(kDPLevelLoaderDefaultStepTime / 1000.0),
+		_isStreamingNodes(false),
+		_isServerPending(false),
+		_streamingRadius(kDPLevelStreamingDefaultRadius),
+		_streamingBudget(kDPLevelStreamingDefaultBudget),
+		_streamingTimer(0.0f),
+		_isLevelStreamed(false),
+		_isStreamingIn(false),
+		_journalCompactLength(kDPEditJournalDefaultCompactLength),
+		_journalSaveOffset(0),
+		_isReplayingJournal(false)
+	{}
+	
+	LevelManager::~LevelManager()
+	{
+		// Waits for a save that is still being written
+		delete _levelSaver;
+		delete _levelLoader;
+	}
+	
+	void LevelManager::Step(float delta)
+	{
+		if(_levelSaver)
+			UpdateLevelSave();
+		
+		if(_levelLoader)
+			UpdateLevelLoad(false);
+		else if(_isLevelStreamed)
+			UpdateLevelStreaming(delta);
+		
+		if(_journal.IsOpen())
+		{
+			FlushJournal();
+			CompactJournal();
+		}
+	}
+	
+	void LevelManager::DidAddSceneNode(RN::SceneNode *node)
+	{
+		// Streamed in nodes were part of the level all along
+		if(IsJournaling() && !_isStreamingNodes && !WorldAttachment::IsEditorSceneNode(node))
+			_journalCreations.insert(node);
+		
+		MarkLevelDirty(node);
+	}
+	
+	void LevelManager::WillRemoveSceneNode(RN::SceneNode *node)
+	{
+		_journalCreations.erase(node);
+		_journalTransforms.erase(node);
+		
+		MarkLevelDirty(node);
+		_levelNodeChunks.erase(node);
+	}
+	
+	void LevelManager::SceneNodeDidUpdate(RN::SceneNode *node, RN::SceneNode::ChangeSet changeSet)
+	{
+		MarkLevelDirty(node);
+		
+		if(!(changeSet & RN::SceneNode::ChangeSet::Position) || WorldAttachment::IsEditorSceneNode(node))
+			return;
+		
+		if(IsJournaling())
+			_journalTransforms.insert(node);
+	}
+	
+	bool LevelManager::PrepareServer()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		if(_isLevelStreamed && !_levelLoader)
+		{
+			std::vector<LevelFile::Chunk> chunks = GetUnloadedLevelChunks();
+			if(!chunks.empty())
+				LoadLevelChunks(chunks, false);
+		}
+		
+		if(_levelLoader)
+		{
+			_isServerPending = true;
+			return false;
+		}
+		
+		return true;
+	}
+	
+	bool LevelManager::SaveLevel(const std::string &path)
+	{
+		// Cells that are being streamed in are finished first, they are just a few around the camera
+		if(_levelLoader && _isStreamingIn)
+			CompleteLevelLoad();
+		
+		// A save before the last chunk arrived would leave out the nodes that are still on their way
+		if(_levelSaver || _levelLoader)
+			return false;
+		
+		// Everything journaled up to here is part of the save, the journal keeps what comes after it
+		if(_journal.IsOpen())
+		{
+			FlushJournal();
+			_journalSaveOffset = _journal.GetLength();
+		}
+		
+		// Serializing only copies the scene into memory, which keeps the scene consistent without holding up
+		// editing for the disk. Exceptions are left to the caller, nothing has been touched on disk yet.
+		RN::Number *chunked = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(RNCSTR("DPChunkedLevels"));
+		
+		if(!chunked || chunked->GetBoolValue())
+		{
+			_levelSaver = EncodeLevel(path);
+		}
+		else
+		{
+			// A plain world file only holds what is in the world, so cells that were streamed out come back first
+			if(_isLevelStreamed)
+				LoadLevelChunksNow(GetUnloadedLevelChunks());
+			
+			RN::FlatSerializer *serializer = new RN::FlatSerializer();
+			
+			try
+			{
+				RN::WorldCoordinator::GetSharedInstance()->SaveWorld(serializer);
+			}
+			catch(RN::Exception &e)
+			{
+				serializer->Release();
+				throw;
+			}
+			
+			_levelSaver = new LevelSaver(serializer->GetSerializedData(), path);
+			serializer->Release();
+			
+			ResetLevelChunks();
+		}
+		
+		if(Workspace::GetSharedInstance())
+		{
+			_saveProgress = new ProgressPanel(RNCSTR("Saving Level"));
+			_saveProgress->Open();
+		}
+		
+		UpdateLevelSave();
+		return true;
+	}
+	
+	void LevelManager::UpdateLevelSave()
+	{
+		if(_saveProgress)
+		{
+			float written = _levelSaver->GetWrittenLength() / (1024.0f * 1024.0f);
+			float total = _levelSaver->GetLength() / (1024.0f * 1024.0f);
+			
+			_saveProgress->SetMessage(RNSTR("%.1f of %.1f MB", written, total));
+			_saveProgress->SetProgress((total > 0.0f) ? written / total : 1.0f);
+		}
+		
+		if(!_levelSaver->IsFinished())
+			return;
+		
+		if(_saveProgress)
+		{
+			_saveProgress->Close();
+			_saveProgress->Release();
+			_saveProgress = nullptr;
+		}
+		
+		if(_levelSaver->Succeeded())
+		{
+			RNInfo("Downpour: Saved world succesfully to %s", _levelSaver->GetPath().c_str());
+			
+			// The chunks of the next save are copied from the file that was just written
+			_levelFile.Open(_levelSaver->GetPath());
+			
+			if(_journal.IsOpen() && !_journal.Compact(_journalSaveOffset, _levelSaver->GetPath(), _levelSaver->GetLength()))
+				RNError("Downpour: Couldn't compact the journal of %s, edits are no longer journaled", _levelSaver->GetPath().c_str());
+		}
+		else
+		{
+			RNError("Downpour: Couldn't write world to %s", _levelSaver->GetPath().c_str());
+			
+			// The chunks encoded for the failed save are no longer dirty, so the next save encodes everything
+			_isLevelDirty = true;
+			
+			if(Workspace::GetSharedInstance())
+				InfoPanel::WithMessage(RNSTR("Couldn't save the level to %s", _levelSaver->GetPath().c_str()));
+		}
+		
+		delete _levelSaver;
+		_levelSaver = nullptr;
+	}
+	
+	LevelSaver *LevelManager::EncodeLevel(const std::string &path)
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		float chunkSize = GetLevelChunkSizeSetting();
+		bool isReusable = (!_isLevelDirty && _levelFile.IsOpen() && _levelFile.GetPath() == path && _levelFile.GetChunkSize() == chunkSize);
+		
+		_levelChunkSize = chunkSize;
+		
+		// Cells that were streamed out are copied as they are, unless nodes were moved into them since or
+		// there is no file to copy them from, then they have to be loaded again to be encoded with the rest
+		if(_isLevelStreamed)
+		{
+			std::vector<LevelFile::Chunk> missing;
+			
+			for(const LevelFile::Chunk &chunk : GetUnloadedLevelChunks())
+			{
+				if(!isReusable || _dirtyLevelChunks.find(LevelFile::GetChunkKey(chunk.x, chunk.z)) != _dirtyLevelChunks.end())
+					missing.push_back(chunk);
+			}
+			
+			LoadLevelChunksNow(missing);
+		}
+		
+		// Cameras stay in the shell along with the editors own nodes, which aren't saved at all
+		std::map<uint64, std::vector<RN::SceneNode *>> chunks;
+		std::vector<RN::SceneNode *> hidden;
+		
+		RN::World::GetActiveWorld()->GetSceneNodes()->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+			
+			if(node->GetParent() || WorldAttachment::IsEditorSceneNode(node))
+				return;
+			
+			chunks[GetLevelChunkKey(node)].push_back(node);
+			
+			std::vector<RN::SceneNode *> subtree;
+			CollectSceneNodes(node, subtree);
+			
+			for(RN::SceneNode *child : subtree)
+			{
+				if(!(child->GetFlags() & RN::SceneNode::Flags::NoSave))
+					hidden.push_back(child);
+			}
+		});
+		
+		// The shell is the world as the world coordinator saves it, minus the nodes that go into the chunks
+		RN::FlatSerializer *shell = new RN::FlatSerializer();
+		_isEncodingLevel = true;
+		
+		for(RN::SceneNode *node : hidden)
+			node->SetFlags(node->GetFlags() | RN::SceneNode::Flags::NoSave);
+		
+		try
+		{
+			RN::WorldCoordinator::GetSharedInstance()->SaveWorld(shell);
+		}
+		catch(RN::Exception &e)
+		{
+			for(RN::SceneNode *node : hidden)
+				node->SetFlags(node->GetFlags() & ~RN::SceneNode::Flags::NoSave);
+			
+			_isEncodingLevel = false;
+			shell->Release();
+			throw;
+		}
+		
+		for(RN::SceneNode *node : hidden)
+			node->SetFlags(node->GetFlags() & ~RN::SceneNode::Flags::NoSave);
+		
+		_isEncodingLevel = false;
+		
+		LevelFile::Writer writer(chunkSize, shell->GetSerializedData());
+		shell->Release();
+		
+		size_t encoded = 0;
+		_levelNodeChunks.clear();
+		
+		// Removing nodes dirties their chunk, so a clean chunk without nodes was streamed out or couldn't be read
+		if(isReusable)
+		{
+			for(const LevelFile::Chunk &chunk : _levelFile.GetChunks())
+			{
+				uint64 key = LevelFile::GetChunkKey(chunk.x, chunk.z);
+				
+				if(chunks.find(key) == chunks.end() && _dirtyLevelChunks.find(key) == _dirtyLevelChunks.end())
+					writer.CopyChunk(chunk);
+			}
+		}
+		
+		_loadedLevelChunks.clear();
+		
+		for(auto &pair : chunks)
+		{
+			int32 x = static_cast<int32>(static_cast<uint32>(pair.first >> 32));
+			int32 z = static_cast<int32>(static_cast<uint32>(pair.first));
+			
+			for(RN::SceneNode *node : pair.second)
+				_levelNodeChunks[node] = pair.first;
+			
+			_loadedLevelChunks.insert(pair.first);
+			
+			const LevelFile::Chunk *chunk = isReusable ? _levelFile.GetChunk(x, z) : nullptr;
+			
+			if(chunk && _dirtyLevelChunks.find(pair.first) == _dirtyLevelChunks.end())
+			{
+				writer.CopyChunk(*chunk);
+				continue;
+			}
+			
+			RN::FlatSerializer *serializer = new RN::FlatSerializer();
+			serializer->EncodeInt32(static_cast<int32>(pair.second.size()));
+			
+			for(RN::SceneNode *node : pair.second)
+				serializer->EncodeObject(node);
+			
+			writer.AddChunk(x, z, serializer->GetSerializedData());
+			serializer->Release();
+			
+			encoded ++;
+		}
+		
+		_dirtyLevelChunks.clear();
+		_isLevelDirty = false;
+		
+		RNInfo("Downpour: Encoded %u of %u chunks of %s", static_cast<uint32>(encoded), static_cast<uint32>(chunks.size()), path.c_str());
+		return new LevelSaver(writer.GetPieces(), path);
+	}
+	
+	void LevelManager::LoadLevel(const std::string &path)
+	{
+		ResetLevelChunks();
+		
+		if(!_levelFile.Open(path))
+		{
+			RN::WorldCoordinator::GetSharedInstance()->LoadWorld(path);
+			return;
+		}
+		
+		RN::Data *shell = _levelFile.ReadShell();
+		if(!shell)
+		{
+			RNError("Downpour: Couldn't read the shell of %s", path.c_str());
+			
+			_levelFile.Close();
+			return;
+		}
+		
+		_levelChunkSize = _levelFile.GetChunkSize();
+		
+		RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(shell);
+		RN::WorldCoordinator::GetSharedInstance()->LoadWorld(deserializer);
+		deserializer->Release();
+	}
+	
+	void LevelManager::FinishLoadingLevel()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		if(!_levelFile.IsOpen() || _levelFile.GetChunks().empty())
+			return;
+		
+		_levelLoadStepTime = GetSizeSetting(RNCSTR("DPLevelLoadStepTime"), kDPLevelLoaderDefaultStepTime) / 1000.0;
+		
+		RN::Number *streamed = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(RNCSTR("DPStreamLevels"));
+		RN::Number *radius = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(RNCSTR("DPStreamingRadius"));
+		
+		// A streamed level starts out with only the cells around the camera, once there is a camera to go by
+		if(streamed && streamed->GetBoolValue())
+		{
+			_isLevelStreamed = true;
+			_streamingRadius = radius ? radius->GetFloatValue() : kDPLevelStreamingDefaultRadius;
+			_streamingBudget = GetSizeSetting(RNCSTR("DPStreamingBudget"), kDPLevelStreamingDefaultBudget);
+			_streamingTimer = kDPLevelStreamingInterval;
+			
+			return;
+		}
+		
+		LoadLevelChunks(_levelFile.GetChunks(), false);
+	}
+	
+	void LevelManager::LoadLevelChunks(const std::vector<LevelFile::Chunk> &chunks, bool isStreaming)
+	{
+		RN_ASSERT(!_levelLoader, "Only one set of chunks can be loaded at a time!");
+		
+		// The chunks are read in the background and decoded a few at a time with every step of the world
+		_levelLoader = new LevelLoader(_levelFile.GetPath(), chunks);
+		_isStreamingIn = isStreaming;
+	}
+	
+	void LevelManager::LoadLevelChunksNow(const std::vector<LevelFile::Chunk> &chunks)
+	{
+		if(chunks.empty())
+			return;
+		
+		LoadLevelChunks(chunks, false);
+		CompleteLevelLoad();
+	}
+	
+	std::vector<LevelFile::Chunk> LevelManager::GetUnloadedLevelChunks() const
+	{
+		std::vector<LevelFile::Chunk> chunks;
+		
+		for(const LevelFile::Chunk &chunk : _levelFile.GetChunks())
+		{
+			if(_loadedLevelChunks.find(LevelFile::GetChunkKey(chunk.x, chunk.z)) == _loadedLevelChunks.end())
+				chunks.push_back(chunk);
+		}
+		
+		return chunks;
+	}
+	
+	void LevelManager::UpdateLevelLoad(bool isBlocking)
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		LevelLoader::Chunk chunk;
+		
+		// Decoded nodes keep their LIDs, so the journal of the level applies to them just like to the shell.
+		// Nodes reach the hierarchy and get their icons as they are added, the same way as any other new node.
+		_isStreamingNodes = true;
+		
+		while(_levelLoader->PopChunk(chunk))
+		{
+			// A chunk that couldn't be read counts as loaded as well, streaming would otherwise retry it over and over
+			_loadedLevelChunks.insert(LevelFile::GetChunkKey(chunk.chunk.x, chunk.chunk.z));
+			
+			if(chunk.isValid)
+			{
+				RN::Data *data = new RN::Data(chunk.bytes.data(), chunk.bytes.size(), true, false);
+				RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(data->Autorelease());
+				
+				uint64 key = LevelFile::GetChunkKey(chunk.chunk.x, chunk.chunk.z);
+				int32 count = deserializer->DecodeInt32();
+				
+				for(int32 i = 0; i < count; i ++)
+				{
+					RN::Object *object = deserializer->DecodeObject();
+					
+					if(object && object->IsKindOfClass(RN::SceneNode::GetMetaClass()))
+						_levelNodeChunks[static_cast<RN::SceneNode *>(object)] = key;
+				}
+				
+				deserializer->Release();
+			}
+			else
+			{
+				// The chunk isn't dirty, so saving copies it over from the file instead of dropping its nodes
+				RNError("Downpour: Couldn't read the chunk at %d, %d of %s", chunk.chunk.x, chunk.chunk.z, _levelLoader->GetPath().c_str());
+			}
+			
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			if(!isBlocking && elapsed.count() >= _levelLoadStepTime)
+				break;
+		}
+		
+		RN::World::GetActiveWorld()->ApplyNodes();
+		_isStreamingNodes = false;
+		
+		if(!_loadProgress && !isBlocking && !_isStreamingIn && Workspace::GetSharedInstance())
+		{
+			_loadProgress = new ProgressPanel(RNCSTR("Opening Level"));
+			_loadProgress->Open();
+		}
+		
+		if(_loadProgress)
+		{
+			size_t decoded = _levelLoader->GetDecodedCount();
+			size_t total = _levelLoader->GetChunkCount();
+			
+			_loadProgress->SetMessage(RNSTR("%u of %u chunks", static_cast<uint32>(decoded), static_cast<uint32>(total)));
+			_loadProgress->SetProgress(static_cast<float>(decoded) / static_cast<float>(total));
+		}
+		
+		if(!_levelLoader->IsFinished())
+			return;
+		
+		if(!_isStreamingIn)
+			RNInfo("Downpour: Loaded %u chunks of %s", static_cast<uint32>(_levelLoader->GetChunkCount()), _levelLoader->GetPath().c_str());
+		
+		// The journal and the server both need the complete level, so they wait for the last chunk
+		std::string journalPath = _pendingJournalPath;
+		bool createServer = _isServerPending;
+		
+		CancelLevelLoad();
+		
+		if(!journalPath.empty())
+			OpenJournal(journalPath);
+		
+		if(createServer)
+			_attachment->CreateServer();
+	}
+	
+	void LevelManager::CompleteLevelLoad()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		while(_levelLoader)
+		{
+			UpdateLevelLoad(true);
+			std::this_thread::yield();
+		}
+	}
+	
+	void LevelManager::RestoreStreamedLevel()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		CompleteLevelLoad();
+		
+		if(_isLevelStreamed)
+			LoadLevelChunksNow(GetUnloadedLevelChunks());
+	}
+	
+	void LevelManager::CancelLevelLoad()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+
+		if(_loadProgress)
+		{
+			_loadProgress->Close();
+			_loadProgress->Release();
+			_loadProgress = nullptr;
+		}
+		
+		delete _levelLoader;
+		_levelLoader = nullptr;
+		_isStreamingIn = false;
+		
+		_pendingJournalPath.clear();
+		_isServerPending = false;
+	}
+	
+	std::string LevelManager::GetLevelPath() const
+	{
+		// A chunked level is loaded from memory, the world coordinator doesn't know its file
+		return _levelFile.IsOpen() ? _levelFile.GetPath() : RN::WorldCoordinator::GetSharedInstance()->GetWorldFile();
+	}
+	
+	void LevelManager::ResetLevelChunks()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		if(_levelLoader)
+			CancelLevelLoad();
+		
+		_levelFile.Close();
+		_levelNodeChunks.clear();
+		_dirtyLevelChunks.clear();
+		_loadedLevelChunks.clear();
+		_isLevelDirty = false;
+		_isLevelStreamed = false;
+	}
+	
+	uint64 LevelManager::GetLevelChunkKey(RN::SceneNode *node) const
+	{
+		RN::Vector3 position = node->GetWorldPosition();
+		
+		int32 x = static_cast<int32>(floorf(position.x / _levelChunkSize));
+		int32 z = static_cast<int32>(floorf(position.z / _levelChunkSize));
+		
+		return LevelFile::GetChunkKey(x, z);
+	}
+	
+	void LevelManager::UpdateLevelStreaming(float delta)
+	{
+		_streamingTimer += delta;
+		
+		// Sessions need every node in the world, so are saves that copy chunks from the file being replaced
+		RN::Camera *camera = _attachment->GetCamera();
+		if(_streamingTimer < kDPLevelStreamingInterval || !camera || _attachment->HasNetwork() || _levelSaver)
+			return;
+		
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		_streamingTimer = 0.0f;
+		
+		// Cells with the selection or with unsaved changes stay loaded no matter where the camera is
+		std::unordered_set<uint64> pinned = _dirtyLevelChunks;
+		
+		RN::Array *selection = _attachment->GetSelection();
+		if(selection)
+		{
+			selection->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
+				
+				auto iterator = _levelNodeChunks.find(GetRootSceneNode(node));
+				if(iterator != _levelNodeChunks.end())
+					pinned.insert(iterator->second);
+			});
+		}
+		
+		RN::Vector3 position = camera->GetWorldPosition();
+		float chunkSize = _levelFile.GetChunkSize();
+		
+		std::vector<std::pair<float, const LevelFile::Chunk *>> candidates;
+		
+		for(const LevelFile::Chunk &chunk : _levelFile.GetChunks())
+		{
+			float x = (chunk.x + 0.5f) * chunkSize - position.x;
+			float z = (chunk.z + 0.5f) * chunkSize - position.z;
+			float distance = sqrtf(x * x + z * z);
+			
+			if(pinned.find(LevelFile::GetChunkKey(chunk.x, chunk.z)) != pinned.end())
+				distance = -1.0f;
+			else if(distance > _streamingRadius)
+				continue;
+			
+			candidates.emplace_back(distance, &chunk);
+		}
+		
+		std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, const LevelFile::Chunk *> &a, const std::pair<float, const LevelFile::Chunk *> &b) {
+			return (a.first < b.first);
+		});
+		
+		// The encoded length stands in for the memory a cell takes up, the closest cells get the budget first
+		std::unordered_set<uint64> wanted;
+		std::vector<LevelFile::Chunk> load;
+		size_t length = 0;
+		
+		for(auto &candidate : candidates)
+		{
+			const LevelFile::Chunk *chunk = candidate.second;
+			
+			if(candidate.first >= 0.0f && length + chunk->length > _streamingBudget)
+				break;
+			
+			uint64 key = LevelFile::GetChunkKey(chunk->x, chunk->z);
+			
+			wanted.insert(key);
+			length += static_cast<size_t>(chunk->length);
+			
+			if(_loadedLevelChunks.find(key) == _loadedLevelChunks.end())
+				load.push_back(*chunk);
+		}
+		
+		std::unordered_set<uint64> unload;
+		
+		for(uint64 key : _loadedLevelChunks)
+		{
+			if(wanted.find(key) == wanted.end())
+				unload.insert(key);
+		}
+		
+		if(!unload.empty())
+			UnloadLevelChunks(unload);
+		
+		if(!load.empty())
+			LoadLevelChunks(load, true);
+	}
+	
+	void LevelManager::UnloadLevelChunks(const std::unordered_set<uint64> &keys)
+	{
+		std::vector<RN::SceneNode *> nodes;
+		
+		for(auto &pair : _levelNodeChunks)
+		{
+			if(!pair.first->GetParent() && keys.find(pair.second) != keys.end())
+				nodes.push_back(pair.first);
+		}
+		
+		// None of the cells is dirty, so their nodes are exactly what the file holds and can be dropped as they are
+		_isStreamingNodes = true;
+		
+		for(RN::SceneNode *node : nodes)
+			node->RemoveFromWorld();
+		
+		RN::World::GetActiveWorld()->ApplyNodes();
+		_isStreamingNodes = false;
+		
+		for(uint64 key : keys)
+			_loadedLevelChunks.erase(key);
+	}
+	
+	void LevelManager::MarkLevelDirty(RN::SceneNode *node)
+	{
+		if(_isEncodingLevel || _isStreamingNodes || (node->GetFlags() & RN::SceneNode::Flags::NoSave))
+			return;
+		
+		RN::SceneNode *root = GetRootSceneNode(node);
+		if(WorldAttachment::IsEditorSceneNode(root))
+			return;
+		
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		// A node that moved, or was moved under another parent, also dirties the chunk it was saved in
+		auto iterator = _levelNodeChunks.find(node);
+		if(iterator != _levelNodeChunks.end())
+			_dirtyLevelChunks.insert(iterator->second);
+		
+		iterator = _levelNodeChunks.find(root);
+		if(iterator != _levelNodeChunks.end())
+			_dirtyLevelChunks.insert(iterator->second);
+		
+		_dirtyLevelChunks.insert(GetLevelChunkKey(root));
+	}
+	
+	bool LevelManager::IsJournaling() const
+	{
+		// Clients leave the level to the server, the server journals the edits of everyone
+		return (_journal.IsOpen() && !_isReplayingJournal && (!_attachment->HasNetwork() || _attachment->IsServer()));
+	}
+	
+	void LevelManager::OpenJournal(const std::string &levelPath)
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		// Toggling the editor keeps the journal open, its entries are already part of the world
+		if(_journal.IsOpen() && _journal.GetLevelPath() == levelPath)
+			return;
+		
+		// The entries can only be replayed once all of the nodes they refer to are there
+		if(_isLevelStreamed && !_levelLoader && EditJournal::HasEntries(levelPath))
+		{
+			std::vector<LevelFile::Chunk> chunks = GetUnloadedLevelChunks();
+			if(!chunks.empty())
+				LoadLevelChunks(chunks, false);
+		}
+		
+		if(_levelLoader)
+		{
+			_pendingJournalPath = levelPath;
+			return;
+		}
+		
+		CloseJournal();
+		
+		if(levelPath.empty() || (_attachment->HasNetwork() && !_attachment->IsServer()))
+			return;
+		
+		_journalCompactLength = GetSizeSetting(RNCSTR("DPEditJournalCompactLength"), kDPEditJournalDefaultCompactLength);
+		
+		std::unordered_map<uint64, RN::SceneNode *> nodes;
+		RN::World::GetActiveWorld()->GetSceneNodes()->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+			nodes[node->GetLID()] = node;
+		});
+		
+		size_t replayed = 0;
+		_isReplayingJournal = true;
+		
+		bool opened = _journal.Open(levelPath, [&](EditJournal::Entry entry, WireReader &reader) {
+			ReplayJournalEntry(entry, reader, nodes);
+			replayed ++;
+		});
+		
+		RN::World::GetActiveWorld()->ApplyNodes();
+		_isReplayingJournal = false;
+		
+		if(!opened)
+		{
+			RNError("Downpour: Couldn't open the journal of %s, edits won't be journaled", levelPath.c_str());
+			return;
+		}
+		
+		if(replayed > 0)
+		{
+			RNInfo("Downpour: Replayed %u edits from the journal of %s", static_cast<uint32>(replayed), levelPath.c_str());
+			
+			// The replayed edits go into the level right away, the journal only has to cover what happens from now on
+			try
+			{
+				SaveLevel(levelPath);
+			}
+			catch(RN::Exception &e)
+			{
+				RNError("Downpour: Couldn't save %s with the replayed edits, they stay in its journal", levelPath.c_str());
+			}
+		}
+	}
+	
+	void LevelManager::CloseJournal()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		FlushJournal();
+		_journal.Close();
+	}
+	
+	void LevelManager::RecordSculptStroke(RN::Sculptable *target, SculptTool::Shape shape, SculptTool::Mode mode, const RN::Vector3 &position, const RN::Vector3 &size)
+	{
+		MarkLevelDirty(target);
+		
+		if(!IsJournaling())
+			return;
+		
+		WireWriter writer;
+		writer.WriteVarUInt(target->GetLID());
+		writer.WriteUInt8(static_cast<uint8>(shape));
+		writer.WriteUInt8(static_cast<uint8>(mode));
+		writer.WriteFloat(position.x);
+		writer.WriteFloat(position.y);
+		writer.WriteFloat(position.z);
+		writer.WriteFloat(size.x);
+		writer.WriteFloat(size.y);
+		writer.WriteFloat(size.z);
+		
+		_journal.Append(EditJournal::Entry::Sculpt, writer);
+	}
+	
+	void LevelManager::JournalSceneNodeDeletion(RN::SceneNode *node)
+	{
+		if(!IsJournaling() || WorldAttachment::IsEditorSceneNode(node))
+			return;
+		
+		WireWriter writer;
+		writer.WriteVarUInt(node->GetLID());
+		
+		_journal.Append(EditJournal::Entry::Delete, writer);
+	}
+	
+	void LevelManager::JournalSceneNodeProperty(RN::SceneNode *node, const std::string &name, RN::Object *object)
+	{
+		MarkLevelDirty(node);
+		
+		if(!IsJournaling())
+			return;
+		
+		WireWriter writer;
+		writer.WriteVarUInt(node->GetLID());
+		writer.WriteString(name);
+		writer.WriteObject(object);
+		
+		_journal.Append(EditJournal::Entry::Property, writer);
+	}
+	
+	void LevelManager::FlushJournal()
+	{
+		RN::LockGuard<RN::RecursiveSpinLock> lock(_lock);
+		
+		if(!_journal.IsOpen())
+			return;
+		
+		// Children added along with their parent are part of the parents entry
+		for(RN::SceneNode *node : _journalCreations)
+		{
+			bool isCovered = false;
+			
+			for(RN::SceneNode *parent = node->GetParent(); parent && !isCovered; parent = parent->GetParent())
+				isCovered = (_journalCreations.find(parent) != _journalCreations.end());
+			
+			if(isCovered)
+				continue;
+			
+			WireWriter writer;
+			writer.WriteVarUInt(node->GetParent() ? node->GetParent()->GetLID() : 0);
+			writer.WriteObject(node);
+			
+			_journal.Append(EditJournal::Entry::Create, writer);
+		}
+		
+		_journalCreations.clear();
+		
+		// A continuous edit is only journaled once it is committed
+		if(_attachment->IsContinuousEdit())
+			return;
+		
+		for(RN::SceneNode *node : _journalTransforms)
+		{
+			WireWriter writer;
+			writer.WriteVarUInt(node->GetLID());
+			WriteTransform(writer, node);
+			
+			_journal.Append(EditJournal::Entry::Transform, writer);
+		}
+		
+		_journalTransforms.clear();
+	}
+	
+	void LevelManager::CompactJournal()
+	{
+		if(!IsJournaling() || _levelSaver || _journal.GetLength() <= _journalCompactLength)
+			return;
+		
+		try
+		{
+			SaveLevel(_journal.GetLevelPath());
+		}
+		catch(RN::Exception &e)
+		{
+			// Trying again every frame won't help, it is tried again once the journal grew as much again
+			RNError("Downpour: Couldn't save %s to compact its journal", _journal.GetLevelPath().c_str());
+			_journalCompactLength += std::max<size_t>(_journalCompactLength, 1024);
+		}
+	}
+	
+	void LevelManager::ReplayJournalEntry(EditJournal::Entry entry, WireReader &reader, std::unordered_map<uint64, RN::SceneNode *> &nodes)
+	{
+		// Decoded nodes keep their LIDs, the same way the world snapshots of a session rely on them
+		switch(entry)
+		{
+			case EditJournal::Entry::Create:
+			{
+				uint64 parentLID = reader.ReadVarUInt();
+				RN::Object *object = reader.ReadObject();
+				
+				if(!reader.IsValid() || !object || !object->IsKindOfClass(RN::SceneNode::GetMetaClass()))
+					break;
+				
+				RN::SceneNode *node = static_cast<RN::SceneNode *>(object);
+				
+				auto parent = nodes.find(parentLID);
+				if(parentLID != 0 && parent != nodes.end())
+					parent->second->AddChild(node);
+				
+				std::vector<RN::SceneNode *> subtree;
+				CollectSceneNodes(node, subtree);
+				
+				for(RN::SceneNode *child : subtree)
+					nodes[child->GetLID()] = child;
+				
+				break;
+			}
+				
+			case EditJournal::Entry::Delete:
+			{
+				auto iterator = nodes.find(reader.ReadVarUInt());
+				if(!reader.IsValid() || iterator == nodes.end())
+					break;
+				
+				RN::SceneNode *node = iterator->second;
+				
+				std::vector<RN::SceneNode *> subtree;
+				CollectSceneNodes(node, subtree);
+				
+				for(RN::SceneNode *child : subtree)
+					nodes.erase(child->GetLID());
+				
+				if(node->GetParent())
+					node->RemoveFromParent();
+				
+				node->RemoveFromWorld();
+				break;
+			}
+				
+			case EditJournal::Entry::Transform:
+			{
+				auto iterator = nodes.find(reader.ReadVarUInt());
+				
+				RN::Vector3 position = ReadVector(reader);
+				RN::Vector3 scale = ReadVector(reader);
+				
+				RN::Quaternion rotation;
+				rotation.x = reader.ReadFloat();
+				rotation.y = reader.ReadFloat();
+				rotation.z = reader.ReadFloat();
+				rotation.w = reader.ReadFloat();
+				
+				if(!reader.IsValid() || iterator == nodes.end())
+					break;
+				
+				iterator->second->SetPosition(position);
+				iterator->second->SetScale(scale);
+				iterator->second->SetRotation(rotation);
+				break;
+			}
+				
+			case EditJournal::Entry::Property:
+			{
+				auto iterator = nodes.find(reader.ReadVarUInt());
+				std::string name = reader.ReadString();
+				RN::Object *object = reader.ReadObject();
+				
+				if(reader.IsValid() && iterator != nodes.end())
+				{
+					iterator->second->SetValueForKey(object, name);
+					MarkLevelDirty(iterator->second);
+				}
+				
+				break;
+			}
+				
+			case EditJournal::Entry::Sculpt:
+			{
+				auto iterator = nodes.find(reader.ReadVarUInt());
+				SculptTool::Shape shape = static_cast<SculptTool::Shape>(reader.ReadUInt8());
+				SculptTool::Mode mode = static_cast<SculptTool::Mode>(reader.ReadUInt8());
+				RN::Vector3 position = ReadVector(reader);
+				RN::Vector3 size = ReadVector(reader);
+				
+				if(reader.IsValid() && iterator != nodes.end() && iterator->second->IsKindOfClass(RN::Sculptable::GetMetaClass()))
+				{
+					SculptTool::ApplyStroke(static_cast<RN::Sculptable *>(iterator->second), shape, mode, position, size);
+					MarkLevelDirty(iterator->second);
+				}
+				
+				break;
+			}
+		}
+	}
+}
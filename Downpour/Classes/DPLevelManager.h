@@ -0,0 +1,145 @@
+//
+//  DPLevelManager.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPLEVELMANAGER_H__
+#define __DPLEVELMANAGER_H__
+
+#include <Rayne/Rayne.h>
+#include "DPLevelSaver.h"
+#include "DPLevelFile.h"
+#include "DPLevelLoader.h"
+#include "DPEditJournal.h"
+#include "DPSculptTool.h"
+#include "DPProgressPanel.h"
+
+// Streamed levels keep the cells within the radius of the editor camera loaded, as long as they fit the budget
+#define kDPLevelStreamingDefaultRadius 256.0f
+#define kDPLevelStreamingDefaultBudget (256 * 1024 * 1024)
+#define kDPLevelStreamingInterval      0.25f
+
+namespace DP
+{
+	class WorldAttachment;
+	
+	// Saving, loading and streaming of the level file, and the journal of the edits made to it since.
+	// It lives inside the world attachment and shares its lock, which steps it and forwards the scene node changes.
+	class LevelManager
+	{
+	public:
+		LevelManager(WorldAttachment *attachment, RN::RecursiveSpinLock &lock);
+		~LevelManager();
+		
+		void Step(float delta);
+		
+		void DidAddSceneNode(RN::SceneNode *node);
+		void WillRemoveSceneNode(RN::SceneNode *node);
+		void SceneNodeDidUpdate(RN::SceneNode *node, RN::SceneNode::ChangeSet changeSet);
+		
+		// Serializes the level right away and writes it in the background, fails while another save is running.
+		// Chunked levels only encode the chunks that changed since they were loaded or saved, the rest is copied.
+		bool SaveLevel(const std::string &path);
+		bool IsSavingLevel() const { return (_levelSaver != nullptr); }
+		
+		// Loads both chunked and plain levels. Once the world coordinator finished loading the shell, the chunks
+		// are streamed in over the following steps of the world, saving and hosting wait until all of them arrived.
+		void LoadLevel(const std::string &path);
+		void FinishLoadingLevel();
+		bool IsLoadingLevel() const { return (_levelLoader != nullptr); }
+		
+		std::string GetLevelPath() const;
+		
+		// Decodes the chunks that are still on their way right away instead of over the next steps
+		void CompleteLevelLoad();
+		
+		// Nothing steps the attachment once the workspace is gone, so the game gets every cell of a streamed level back
+		void RestoreStreamedLevel();
+		
+		// Forgets the chunks of the open level, along with whatever of it is still loading or streamed out
+		void ResetLevelChunks();
+		
+		// Joiners get a snapshot of the world, which has to wait until the level is opened completely. Loads whatever
+		// is still missing and returns false in that case, the server is created once the last chunk arrived.
+		bool PrepareServer();
+		
+		// Journals the edits of the level next to it, whatever an earlier session left in there is replayed first
+		void OpenJournal(const std::string &levelPath);
+		void CloseJournal();
+		void RecordSculptStroke(RN::Sculptable *target, SculptTool::Shape shape, SculptTool::Mode mode, const RN::Vector3 &position, const RN::Vector3 &size);
+		void JournalSceneNodeDeletion(RN::SceneNode *node);
+		void JournalSceneNodeProperty(RN::SceneNode *node, const std::string &name, RN::Object *object);
+		
+	private:
+		void UpdateLevelSave();
+		
+		void UpdateLevelLoad(bool isBlocking);
+		void CancelLevelLoad();
+		void LoadLevelChunks(const std::vector<LevelFile::Chunk> &chunks, bool isStreaming);
+		void LoadLevelChunksNow(const std::vector<LevelFile::Chunk> &chunks);
+		std::vector<LevelFile::Chunk> GetUnloadedLevelChunks() const;
+		
+		void UpdateLevelStreaming(float delta);
+		void UnloadLevelChunks(const std::unordered_set<uint64> &keys);
+		
+		LevelSaver *EncodeLevel(const std::string &path);
+		void MarkLevelDirty(RN::SceneNode *node);
+		uint64 GetLevelChunkKey(RN::SceneNode *node) const;
+		
+		bool IsJournaling() const;
+		void FlushJournal();
+		void CompactJournal();
+		void ReplayJournalEntry(EditJournal::Entry entry, WireReader &reader, std::unordered_map<uint64, RN::SceneNode *> &nodes);
+		
+		WorldAttachment *_attachment;
+		RN::RecursiveSpinLock &_lock;
+		
+		LevelSaver *_levelSaver;
+		ProgressPanel *_saveProgress;
+		
+		// The chunk of every root node as of the last load or save, a node that moved dirties its old chunk as well
+		LevelFile _levelFile;
+		std::unordered_map<RN::SceneNode *, uint64> _levelNodeChunks;
+		std::unordered_set<uint64> _dirtyLevelChunks;
+		float _levelChunkSize;
+		bool _isLevelDirty;
+		bool _isEncodingLevel;
+		
+		LevelLoader *_levelLoader;
+		ProgressPanel *_loadProgress;
+		std::string _pendingJournalPath;
+		double _levelLoadStepTime;
+		bool _isStreamingNodes;
+		bool _isServerPending;
+		
+		// Cells of a streamed level that aren't loaded are copied from the file when saving, like clean chunks
+		std::unordered_set<uint64> _loadedLevelChunks;
+		float _streamingRadius;
+		size_t _streamingBudget;
+		float _streamingTimer;
+		bool _isLevelStreamed;
+		bool _isStreamingIn;
+		
+		// Nodes are only written to the journal at the end of the frame, once they are set up completely
+		EditJournal _journal;
+		std::unordered_set<RN::SceneNode *> _journalCreations;
+		std::unordered_set<RN::SceneNode *> _journalTransforms;
+		size_t _journalCompactLength;
+		size_t _journalSaveOffset;
+		bool _isReplayingJournal;
+	};
+}
+
+#endif /* __DPLEVELMANAGER_H__ */
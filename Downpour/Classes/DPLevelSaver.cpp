@@ -0,0 +1,185 @@
+//
+//  DPLevelSaver.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPLevelSaver.h"
+#include <cstdio>
+
+#if RN_PLATFORM_WINDOWS
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+namespace DP
+{
+	LevelSaver::Piece::Piece(RN::Data *data) :
+		data(data),
+		offset(0),
+		length(data->GetLength())
+	{}
+	
+	LevelSaver::Piece::Piece(uint64 offset, uint64 length) :
+		data(nullptr),
+		offset(offset),
+		length(length)
+	{}
+	
+	LevelSaver::LevelSaver(RN::Data *data, const std::string &path) :
+		LevelSaver(std::vector<Piece>({ Piece(data) }), path)
+	{}
+	
+	LevelSaver::LevelSaver(const std::vector<Piece> &pieces, const std::string &path) :
+		_pieces(pieces),
+		_length(0),
+		_path(path),
+		_written(0),
+		_finished(false),
+		_succeeded(false)
+	{
+		for(Piece &piece : _pieces)
+		{
+			if(piece.data)
+				piece.data->Retain();
+			
+			_length += static_cast<size_t>(piece.length);
+		}
+		
+		_thread = std::thread(&LevelSaver::Run, this);
+	}
+	
+	LevelSaver::~LevelSaver()
+	{
+		if(_thread.joinable())
+			_thread.join();
+		
+		for(Piece &piece : _pieces)
+		{
+			if(piece.data)
+				piece.data->Release();
+		}
+	}
+	
+	void LevelSaver::Run()
+	{
+		std::string temporary = _path + ".saving";
+		
+		_succeeded = (Write(temporary) && ReplaceFile(temporary, _path));
+		
+		if(!_succeeded)
+			std::remove(temporary.c_str());
+		
+		_finished.store(true);
+	}
+	
+	bool LevelSaver::Write(const std::string &path)
+	{
+		FILE *file = std::fopen(path.c_str(), "wb");
+		if(!file)
+			return false;
+		
+		// Ranges are copied out of the level that is about to be replaced, which stays untouched until the rename
+		FILE *source = nullptr;
+		bool result = true;
+		
+		for(const Piece &piece : _pieces)
+		{
+			if(piece.data)
+			{
+				result = WriteBytes(file, static_cast<const uint8 *>(piece.data->GetBytes()), piece.data->GetLength());
+			}
+			else
+			{
+				if(!source)
+					source = std::fopen(_path.c_str(), "rb");
+				
+				result = (source && CopyBytes(file, source, piece));
+			}
+			
+			if(!result)
+				break;
+		}
+		
+		if(source)
+			std::fclose(source);
+		
+		// The rename is only atomic if the data is on the disk before it
+		result = result && (std::fflush(file) == 0);
+		
+#if !RN_PLATFORM_WINDOWS
+		result = result && (fsync(fileno(file)) == 0);
+#endif
+		
+		return (std::fclose(file) == 0 && result);
+	}
+	
+	bool LevelSaver::WriteBytes(FILE *file, const uint8 *bytes, size_t length)
+	{
+		size_t offset = 0;
+		
+		while(offset < length)
+		{
+			size_t size = std::min<size_t>(length - offset, kDPLevelSaverChunkSize);
+			
+			if(std::fwrite(bytes + offset, 1, size, file) != size)
+				return false;
+			
+			offset += size;
+			_written.fetch_add(size);
+		}
+		
+		return true;
+	}
+	
+	bool LevelSaver::CopyBytes(FILE *file, FILE *source, const Piece &piece)
+	{
+		if(!Seek(source, piece.offset))
+			return false;
+		
+		std::vector<uint8> buffer(static_cast<size_t>(std::min<uint64>(piece.length, kDPLevelSaverChunkSize)));
+		uint64 remaining = piece.length;
+		
+		while(remaining > 0)
+		{
+			size_t size = static_cast<size_t>(std::min<uint64>(remaining, buffer.size()));
+			
+			if(std::fread(buffer.data(), 1, size, source) != size || !WriteBytes(file, buffer.data(), size))
+				return false;
+			
+			remaining -= size;
+		}
+		
+		return true;
+	}
+	
+	bool LevelSaver::ReplaceFile(const std::string &source, const std::string &destination)
+	{
+#if RN_PLATFORM_WINDOWS
+		return (MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0);
+#else
+		return (std::rename(source.c_str(), destination.c_str()) == 0);
+#endif
+	}
+	
+	bool LevelSaver::Seek(FILE *file, uint64 offset)
+	{
+#if RN_PLATFORM_WINDOWS
+		return (_fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0);
+#else
+		return (fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0);
+#endif
+	}
+}
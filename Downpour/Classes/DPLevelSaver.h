@@ -0,0 +1,81 @@
+//
+//  DPLevelSaver.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPLEVELSAVER_H__
+#define __DPLEVELSAVER_H__
+
+#include <Rayne/Rayne.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdio>
+
+#define kDPLevelSaverChunkSize (1024 * 1024)
+
+namespace DP
+{
+	// Writes an already serialized level to disk on a thread of its own. The data goes into a temporary file
+	// next to the level first, which then replaces the level in one rename, so a failed or interrupted save
+	// never leaves a partially written level behind. The data is only read by the thread, never retained by it.
+	// A level can also be written from pieces, each either fresh data or a byte range of the level being
+	// replaced, which is how unchanged parts of a chunked level are carried over without encoding them again.
+	class LevelSaver
+	{
+	public:
+		struct Piece
+		{
+			Piece(RN::Data *data);
+			Piece(uint64 offset, uint64 length);
+			
+			RN::Data *data;
+			uint64 offset;
+			uint64 length;
+		};
+		
+		LevelSaver(RN::Data *data, const std::string &path);
+		LevelSaver(const std::vector<Piece> &pieces, const std::string &path);
+		~LevelSaver();
+		
+		const std::string &GetPath() const { return _path; }
+		size_t GetLength() const { return _length; }
+		size_t GetWrittenLength() const { return _written.load(); }
+		
+		bool IsFinished() const { return _finished.load(); }
+		bool Succeeded() const { return _succeeded; }
+		
+		// Renames the source over the destination in one step, replacing the destination if it exists
+		static bool ReplaceFile(const std::string &source, const std::string &destination);
+		static bool Seek(FILE *file, uint64 offset);
+		
+	private:
+		void Run();
+		bool Write(const std::string &path);
+		bool WriteBytes(FILE *file, const uint8 *bytes, size_t length);
+		bool CopyBytes(FILE *file, FILE *source, const Piece &piece);
+		
+		std::vector<Piece> _pieces;
+		size_t _length;
+		std::string _path;
+		std::thread _thread;
+		
+		std::atomic<size_t> _written;
+		std::atomic<bool> _finished;
+		bool _succeeded;
+	};
+}
+
+#endif /* __DPLEVELSAVER_H__ */
@@ -0,0 +1,454 @@
+//
+//  DPLoadGenerator.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPLoadGenerator.h"
+#include "DPNetworkHost.h"
+#include "DPWorldAttachment.h"
+
+namespace DP
+{
+	static const char *__RequestNames[4] = { "transform", "property", "create", "duplicate" };
+	
+	static double GetPercentile(std::vector<double> values, double percentile)
+	{
+		if(values.empty())
+			return 0.0;
+		
+		std::sort(values.begin(), values.end());
+		
+		size_t index = static_cast<size_t>(std::ceil(percentile * values.size()));
+		index = std::min(values.size() - 1, std::max<size_t>(index, 1) - 1);
+		
+		return values[index];
+	}
+	
+	static RN::String *DescribeTimes(const char *name, const std::vector<double> &values, double scale, const char *unit)
+	{
+		return RNSTR("%s: p50 %.2f %s, p90 %.2f %s, p99 %.2f %s, max %.2f %s\n", name,
+					 GetPercentile(values, 0.5) * scale, unit,
+					 GetPercentile(values, 0.9) * scale, unit,
+					 GetPercentile(values, 0.99) * scale, unit,
+					 GetPercentile(values, 1.0) * scale, unit);
+	}
+	
+	LoadGenerator::Configuration::Configuration() :
+		address("127.0.0.1"),
+		port(2003),
+		clients(16),
+		duration(30.0f),
+		transformRate(30.0f),
+		propertyRate(1.0f),
+		createRate(0.1f),
+		duplicateRate(0.1f),
+		interestRadius(0.0f),
+		property("tag"),
+		createClass("RN::SceneNode")
+	{}
+	
+	LoadGenerator::Configuration LoadGenerator::GetConfigurationFromSettings()
+	{
+		RN::Settings *settings = RN::Settings::GetSharedInstance();
+		Configuration configuration;
+		
+		configuration.clients  = static_cast<size_t>(std::max(1.0f, settings->GetFloatForKey(RNCSTR("DPLoadTestClients"), configuration.clients)));
+		configuration.duration = settings->GetFloatForKey(RNCSTR("DPLoadTestDuration"), configuration.duration);
+		
+		configuration.transformRate  = settings->GetFloatForKey(RNCSTR("DPLoadTestTransformRate"), configuration.transformRate);
+		configuration.propertyRate   = settings->GetFloatForKey(RNCSTR("DPLoadTestPropertyRate"), configuration.propertyRate);
+		configuration.createRate     = settings->GetFloatForKey(RNCSTR("DPLoadTestCreateRate"), configuration.createRate);
+		configuration.duplicateRate  = settings->GetFloatForKey(RNCSTR("DPLoadTestDuplicateRate"), configuration.duplicateRate);
+		configuration.interestRadius = settings->GetFloatForKey(RNCSTR("DPLoadTestInterestRadius"), configuration.interestRadius);
+		
+		RN::String *property = settings->GetObjectForKey<RN::String>(RNCSTR("DPLoadTestProperty"));
+		if(property)
+			configuration.property = property->GetUTF8String();
+		
+		RN::String *createClass = settings->GetObjectForKey<RN::String>(RNCSTR("DPLoadTestCreateClass"));
+		if(createClass)
+			configuration.createClass = createClass->GetUTF8String();
+		
+		return configuration;
+	}
+	
+	
+	LoadGenerator::LoadGenerator(const Configuration &configuration, const std::vector<NetworkHandle> &nodes) :
+		_configuration(configuration),
+		_nodes(nodes),
+		_start(std::chrono::steady_clock::now()),
+		_running(true)
+	{
+		// Rayne objects are encoded up front, the client thread only ever copies bytes
+		WireWriter writer;
+		writer.WriteObject(RN::Number::WithInt32(1));
+		
+		_propertyValue.assign(writer.GetBytes(), writer.GetBytes() + writer.GetLength());
+		
+		ENetAddress address;
+		enet_address_set_host(&address, _configuration.address.c_str());
+		address.port = _configuration.port;
+		
+		RN_ASSERT((_host = enet_host_create(NULL, _configuration.clients, kDPNetworkChannelCount, 0, 0)), "Enet couldn't create the load generator!");
+		
+		_clients.resize(_configuration.clients);
+		
+		for(size_t i = 0; i < _clients.size(); i ++)
+		{
+			Client &client = _clients[i];
+			client.connected = false;
+			client.hostID = 0;
+			client.edit = 0;
+			client.sequence = 0;
+			client.random.seed(static_cast<uint32>(i + 1));
+			
+			client.peer = enet_host_connect(_host, &address, kDPNetworkChannelCount, 0);
+			client.peer->data = &client;
+		}
+		
+		std::fill(std::begin(_result.sentRequests), std::end(_result.sentRequests), 0);
+		_result.connectedClients = 0;
+		_result.receivedPackets = 0;
+		
+		_thread = std::thread(&LoadGenerator::Run, this);
+	}
+	
+	LoadGenerator::~LoadGenerator()
+	{
+		Stop();
+	}
+	
+	double LoadGenerator::GetTime() const
+	{
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - _start;
+		return duration.count();
+	}
+	
+	bool LoadGenerator::IsFinished() const
+	{
+		return (GetTime() >= _configuration.duration);
+	}
+	
+	void LoadGenerator::RecordServerStep(double stepTime, double fanOutTime, uint64 messages)
+	{
+		_result.stepTimes.push_back(stepTime);
+		_result.fanOutTimes.push_back(fanOutTime);
+		_result.fanOutMessages.push_back(static_cast<double>(messages));
+	}
+	
+	void LoadGenerator::Stop()
+	{
+		if(!_running.exchange(false))
+			return;
+		
+		_thread.join();
+	}
+	
+	// MARK: -
+	// MARK: Client thread
+	
+	void LoadGenerator::Run()
+	{
+		while(_running)
+		{
+			ENetEvent event;
+			
+			if(enet_host_service(_host, &event, 1) > 0)
+			{
+				do {
+					
+					Client &client = *static_cast<Client *>(event.peer->data);
+					
+					switch(event.type)
+					{
+						case ENET_EVENT_TYPE_CONNECT:
+							client.connected = true;
+							break;
+							
+						case ENET_EVENT_TYPE_DISCONNECT:
+							client.connected = false;
+							break;
+							
+						case ENET_EVENT_TYPE_RECEIVE:
+						{
+							if(!Packet::IsValidENetPacket(event.packet))
+							{
+								enet_packet_destroy(event.packet);
+								break;
+							}
+							
+							Packet *packet = new Packet(event.packet);
+							HandlePacket(client, packet, GetTime());
+							packet->Release();
+							break;
+						}
+							
+						default:
+							break;
+					}
+					
+				} while(enet_host_check_events(_host, &event) > 0);
+			}
+			
+			double now = GetTime();
+			const float rates[4] = { _configuration.transformRate, _configuration.propertyRate, _configuration.createRate, _configuration.duplicateRate };
+			
+			for(Client &client : _clients)
+			{
+				// Clients start sending once the server told them who they are
+				if(!client.connected || client.hostID == 0)
+					continue;
+				
+				for(int i = 0; i < 4; i ++)
+				{
+					if(rates[i] <= 0.0f)
+						continue;
+					
+					while(client.next[i] <= now)
+					{
+						SendRequest(client, static_cast<Request>(i), now);
+						client.next[i] += 1.0 / rates[i];
+					}
+				}
+			}
+		}
+		
+		for(Client &client : _clients)
+		{
+			if(client.connected)
+				_result.connectedClients ++;
+			
+			_result.lags.insert(_result.lags.end(), client.lags.begin(), client.lags.end());
+			_result.clientLags.push_back(GetPercentile(client.lags, 0.99));
+			
+			enet_peer_disconnect(client.peer, 0);
+		}
+		
+		ENetEvent event;
+		while(enet_host_service(_host, &event, 100) > 0)
+		{
+			if(event.type == ENET_EVENT_TYPE_RECEIVE)
+				enet_packet_destroy(event.packet);
+		}
+		
+		enet_host_destroy(_host);
+		_host = nullptr;
+	}
+	
+	void LoadGenerator::HandlePacket(Client &client, Packet *packet, double now)
+	{
+		_result.receivedPackets ++;
+		
+		WireReader reader(packet->GetBytes(), packet->GetLength());
+		
+		switch(packet->GetType())
+		{
+			case Packet::Type::AnswerHostID:
+			{
+				if(packet->GetLength() != sizeof(WorldAttachment::SessionInfo))
+					break;
+				
+				WorldAttachment::SessionInfo info;
+				packet->GetData(&info);
+				
+				client.hostID = info.hostID;
+				client.codec.SetPositionGrid(info.positionGrid);
+				client.codec.SetScaleGrid(info.scaleGrid);
+				
+				// Spread the first requests so that the clients don't all fire in the same step
+				std::uniform_real_distribution<double> offset(0.0, 1.0);
+				
+				client.next[Transform] = now + offset(client.random) / std::max(0.001f, _configuration.transformRate);
+				client.next[Property]  = now + offset(client.random) / std::max(0.001f, _configuration.propertyRate);
+				client.next[Create]    = now + offset(client.random) / std::max(0.001f, _configuration.createRate);
+				client.next[Duplicate] = now + offset(client.random) / std::max(0.001f, _configuration.duplicateRate);
+				
+				if(_configuration.interestRadius > 0.0f)
+				{
+					std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+					
+					WireWriter writer;
+					writer.WriteFloat(position(client.random));
+					writer.WriteFloat(0.0f);
+					writer.WriteFloat(position(client.random));
+					writer.WriteFloat(_configuration.interestRadius);
+					writer.WriteVarUInt(0);
+					
+					Send(client, Packet::Type::RequestInterest, writer);
+				}
+				
+				break;
+			}
+				
+			case Packet::Type::AnswerTransform:
+			{
+				uint64 sequence = reader.ReadVarUInt();
+				reader.ReadUInt8();
+				
+				std::vector<TransformRequest> requests;
+				if(!client.codec.Decode(reader, requests))
+					break;
+				
+				client.sequence = std::max(client.sequence, sequence);
+				
+				for(const TransformRequest &request : requests)
+					ReceiveAnswer(client, request.hostID, request.edit, now);
+				
+				break;
+			}
+				
+			case Packet::Type::AnswerSceneNodeProperty:
+			{
+				uint64 sequence = reader.ReadVarUInt();
+				reader.ReadUInt8();
+				uint32 hostID = static_cast<uint32>(reader.ReadVarUInt());
+				uint32 edit = static_cast<uint32>(reader.ReadVarUInt());
+				
+				if(!reader.IsValid())
+					break;
+				
+				client.sequence = std::max(client.sequence, sequence);
+				ReceiveAnswer(client, hostID, edit, now);
+				break;
+			}
+				
+			default:
+				break;
+		}
+	}
+	
+	void LoadGenerator::ReceiveAnswer(Client &client, uint32 hostID, uint32 edit, double now)
+	{
+		if(hostID != client.hostID)
+			return;
+		
+		// The server merges transforms, an answer covers all of our earlier edits that are still pending
+		auto end = client.pending.upper_bound(edit);
+		
+		for(auto iterator = client.pending.begin(); iterator != end; iterator ++)
+			client.lags.push_back(now - iterator->second);
+		
+		client.pending.erase(client.pending.begin(), end);
+	}
+	
+	void LoadGenerator::SendRequest(Client &client, Request request, double now)
+	{
+		if(_nodes.empty() && request != Create)
+			return;
+		
+		std::uniform_int_distribution<size_t> node(0, _nodes.empty() ? 0 : _nodes.size() - 1);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		
+		WireWriter writer;
+		
+		switch(request)
+		{
+			case Transform:
+			{
+				TransformRequest transform;
+				transform.hostID   = client.hostID;
+				transform.edit     = ++ client.edit;
+				transform.handle   = _nodes[node(client.random)];
+				transform.changes  = TransformRequest::Changes::All;
+				transform.position = RN::Vector3(position(client.random), position(client.random), position(client.random));
+				transform.scale    = RN::Vector3(1.0f, 1.0f, 1.0f);
+				
+				writer.WriteVarUInt(client.sequence);
+				client.codec.Encode(writer, std::vector<TransformRequest>(1, transform));
+				
+				client.pending[transform.edit] = now;
+				Send(client, Packet::Type::RequestTransform, writer);
+				break;
+			}
+				
+			case Property:
+			{
+				uint32 edit = ++ client.edit;
+				
+				writer.WriteVarUInt(client.sequence);
+				writer.WriteVarUInt(client.hostID);
+				writer.WriteVarUInt(edit);
+				writer.WriteVarUInt(_nodes[node(client.random)]);
+				writer.WriteVarUInt(0);
+				writer.WriteString(_configuration.property);
+				writer.WriteBytes(_propertyValue.data(), _propertyValue.size());
+				
+				client.pending[edit] = now;
+				Send(client, Packet::Type::RequestSceneNodeProperty, writer);
+				break;
+			}
+				
+			case Create:
+			{
+				writer.WriteVarUInt(client.hostID);
+				writer.WriteUInt8(1);
+				writer.WriteVarUInt(0);
+				writer.WriteString(_configuration.createClass);
+				writer.WriteFloat(position(client.random));
+				writer.WriteFloat(0.0f);
+				writer.WriteFloat(position(client.random));
+				writer.WriteVarUInt(0);
+				
+				Send(client, Packet::Type::RequestSceneNode, writer);
+				break;
+			}
+				
+			case Duplicate:
+			{
+				uint64 ids[3] = { _nodes[node(client.random)], 0, client.hostID };
+				writer.WriteBytes(ids, sizeof(ids));
+				
+				Send(client, Packet::Type::RequestDuplicateSceneNode, writer);
+				break;
+			}
+		}
+		
+		_result.sentRequests[request] ++;
+	}
+	
+	void LoadGenerator::Send(Client &client, Packet::Type type, const WireWriter &writer)
+	{
+		Packet *packet = new Packet(type, writer.GetBytes(), writer.GetLength(), Packet::Flags::Reliable);
+		
+		ENetPacket *enetPacket = packet->CreateENetPacket();
+		if(enet_peer_send(client.peer, kDPNetworkReliableChannel, enetPacket) < 0)
+			enet_packet_destroy(enetPacket);
+		
+		packet->Release();
+	}
+	
+	// MARK: -
+	// MARK: Report
+	
+	RN::String *LoadGenerator::CreateReport()
+	{
+		Stop();
+		
+		RN::String *report = RNSTR("Load test: %u of %u clients connected, %.1f seconds\n", static_cast<uint32>(_result.connectedClients), static_cast<uint32>(_configuration.clients), _configuration.duration);
+		
+		for(int i = 0; i < 4; i ++)
+			report->Append("Sent %u %s requests\n", static_cast<uint32>(_result.sentRequests[i]), __RequestNames[i]);
+		
+		report->Append("Received %u packets\n\n", static_cast<uint32>(_result.receivedPackets));
+		
+		report->Append(DescribeTimes("Server step", _result.stepTimes, 1000.0, "ms"));
+		report->Append(DescribeTimes("Fan-out", _result.fanOutTimes, 1000.0, "ms"));
+		report->Append(DescribeTimes("Messages per step", _result.fanOutMessages, 1.0, ""));
+		report->Append(DescribeTimes("Client lag", _result.lags, 1000.0, "ms"));
+		report->Append(DescribeTimes("Client p99 lag", _result.clientLags, 1000.0, "ms"));
+		
+		return report;
+	}
+}
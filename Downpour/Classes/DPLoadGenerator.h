@@ -0,0 +1,136 @@
+//
+//  DPLoadGenerator.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPLOADGENERATOR_H__
+#define __DPLOADGENERATOR_H__
+
+#include <Rayne/Rayne.h>
+#include <enet/enet.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <map>
+#include "DPPacket.h"
+#include "DPTransformCodec.h"
+#include "DPWireBuffer.h"
+
+namespace DP
+{
+	// Simulates a number of editors against a session server over loopback. All clients share one ENet host
+	// on a thread of their own and send a configurable mix of requests at fixed rates per client. Every client
+	// measures the lag until the server answered its own edits, the server feeds its step times in from the main
+	// thread. Nothing but the result is shared between the threads, and only once the clients are shut down.
+	class LoadGenerator
+	{
+	public:
+		struct Configuration
+		{
+			Configuration();
+			
+			std::string address;
+			uint16 port;
+			
+			size_t clients;
+			float duration;
+			
+			// Requests per second per client
+			float transformRate;
+			float propertyRate;
+			float createRate;
+			float duplicateRate;
+			
+			// Clients publish a region of this radius around a random point, 0 makes them interested in everything
+			float interestRadius;
+			
+			std::string property;
+			std::string createClass;
+		};
+		
+		struct Result
+		{
+			size_t connectedClients;
+			size_t sentRequests[4];
+			size_t receivedPackets;
+			
+			std::vector<double> stepTimes;
+			std::vector<double> fanOutTimes;
+			std::vector<double> fanOutMessages;
+			std::vector<double> lags;
+			std::vector<double> clientLags;
+		};
+		
+		LoadGenerator(const Configuration &configuration, const std::vector<NetworkHandle> &nodes);
+		~LoadGenerator();
+		
+		static Configuration GetConfigurationFromSettings();
+		
+		// Main thread only
+		void RecordServerStep(double stepTime, double fanOutTime, uint64 messages);
+		bool IsFinished() const;
+		
+		void Stop();
+		RN::String *CreateReport();
+		
+	private:
+		enum Request
+		{
+			Transform,
+			Property,
+			Create,
+			Duplicate
+		};
+		
+		struct Client
+		{
+			ENetPeer *peer;
+			bool connected;
+			uint32 hostID;
+			uint32 edit;
+			uint64 sequence;
+			
+			TransformCodec codec;
+			std::mt19937 random;
+			
+			double next[4];
+			std::map<uint32, double> pending;
+			std::vector<double> lags;
+		};
+		
+		void Run();
+		void HandlePacket(Client &client, Packet *packet, double now);
+		void SendRequest(Client &client, Request request, double now);
+		void Send(Client &client, Packet::Type type, const WireWriter &writer);
+		void ReceiveAnswer(Client &client, uint32 hostID, uint32 edit, double now);
+		double GetTime() const;
+		
+		Configuration _configuration;
+		std::vector<NetworkHandle> _nodes;
+		std::vector<uint8> _propertyValue;
+		
+		ENetHost *_host;
+		std::vector<Client> _clients;
+		
+		std::chrono::steady_clock::time_point _start;
+		std::atomic<bool> _running;
+		std::thread _thread;
+		
+		Result _result;
+	};
+}
+
+#endif /* __DPLOADGENERATOR_H__ */
@@ -17,6 +17,10 @@
 
 #include <Rayne/Rayne.h>
 #include "DPWorkspace.h"
+#include "DPWorldAttachment.h"
+#include <chrono>
+#include <random>
+#include <cstdio>
 
 namespace DP
 {
@@ -24,6 +28,8 @@ namespace DP
 	static Workspace *__workspace = nullptr;
 	static RN::Module *__module   = nullptr;
 	
+	static const char *__DPHeadlessCookie = "__DPHeadlessCookie";
+	
 	void ActivateDownpour()
 	{
 		__workspace = new Workspace(__module);
@@ -41,6 +47,367 @@ namespace DP
 	
 	
 	
+	void ReplayCapture(const std::string &path)
+	{
+		// Runs without ever creating the workspace, so replays work on machines without a display
+		WorldAttachment *attachment = WorldAttachment::GetSharedInstance();
+		
+		if(!attachment->ReplayCapture(path))
+		{
+			RNError("Downpour: Couldn't replay capture %s", path.c_str());
+			return;
+		}
+		
+		RN::String *output = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::String>(RNCSTR("DPReplayStatisticsFile"));
+		if(output)
+		{
+			std::string file = output->GetUTF8String();
+			bool csv = (file.size() >= 4 && file.compare(file.size() - 4, 4, ".csv") == 0);
+			
+			if(!(csv ? attachment->GetStatistics().WriteCSV(file) : attachment->GetStatistics().WriteJSON(file)))
+				RNError("Downpour: Couldn't write replay statistics to %s", file.c_str());
+		}
+	}
+	
+	void PrintSessionStatistics()
+	{
+		const NetworkStatistics::Sample &sample = WorldAttachment::GetSharedInstance()->GetStatistics().GetSamples().back();
+		
+		uint32 roundTripTime = 0;
+		for(const NetworkHost::PeerStatistics &peer : sample.peers)
+			roundTripTime = std::max(roundTripTime, peer.roundTripTime);
+		
+		std::printf("%.0fs: %u peers, sent %.1f KB, received %.1f KB, step %.2fms, worst rtt %ums, queued %u/%u\n", sample.time,
+					static_cast<uint32>(sample.peers.size()), sample.wireSentBytes / 1024.0, sample.wireReceivedBytes / 1024.0,
+					sample.stepTime * 1000.0, roundTripTime, static_cast<uint32>(sample.queuedCommands), static_cast<uint32>(sample.queuedEvents));
+		std::fflush(stdout);
+	}
+	
+	void RunHeadlessServer(const std::string &path)
+	{
+		// Hosts the level without ever creating the workspace, the world attachment is all the server needs.
+		// Only the level loaded here is hosted, so the observer goes away once it fired.
+		RN::MessageCenter::GetSharedInstance()->AddObserver(kRNWorldCoordinatorDidFinishLoadingMessage, [](RN::Message *message) {
+			
+			WorldAttachment *attachment = WorldAttachment::GetSharedInstance();
+			attachment->GetLevelManager().FinishLoadingLevel();
+			
+			RN::WorldCoordinator::GetSharedInstance()->GetWorld()->AddAttachment(attachment);
+			attachment->CreateServer();
+			
+			RNInfo("Downpour: Hosting %s headless", attachment->GetLevelManager().GetLevelPath().c_str());
+			RN::MessageCenter::GetSharedInstance()->RemoveObserver(const_cast<char *>(__DPHeadlessCookie));
+			
+		}, const_cast<char *>(__DPHeadlessCookie));
+		
+		RN::MessageCenter::GetSharedInstance()->AddObserver(kDPNetworkStatisticsDidSampleMessage, std::bind(&PrintSessionStatistics), __module);
+		WorldAttachment::GetSharedInstance()->GetLevelManager().LoadLevel(path);
+	}
+	
+	void BenchmarkHandleTable(size_t count)
+	{
+		// Compares the handle table against the LID keyed map it replaced, using shuffled lookups to defeat the cache.
+		// Handles aren't stored in the nodes, so the table side pays for the reverse map from node to handle as well,
+		// exactly like register, unregister, SceneNodeDidUpdate and GetNetworkHandle do. The LID comes with the node for free.
+		typedef std::chrono::high_resolution_clock Clock;
+		
+		auto milliseconds = [](Clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		};
+		
+		std::vector<size_t> order(count);
+		for(size_t i = 0; i < count; i ++)
+			order[i] = i;
+		
+		std::shuffle(order.begin(), order.end(), std::mt19937(42));
+		
+		// Stand ins for the scene nodes, only their addresses are used
+		std::vector<uint8> nodes(count);
+		size_t found = 0;
+		
+		{
+			HandleTable<void *> table;
+			std::unordered_map<void *, NetworkHandle> handles;
+			
+			Clock::time_point start = Clock::now();
+			for(size_t i = 0; i < count; i ++)
+			{
+				void *node = &nodes[i];
+				handles[node] = table.Insert(node);
+			}
+			double insert = milliseconds(start);
+			
+			// A node update looks up the handle of the node, a received packet the node of the handle
+			start = Clock::now();
+			for(size_t i : order)
+			{
+				auto iterator = handles.find(&nodes[i]);
+				if(iterator != handles.end())
+					found += (table.Get(iterator->second) == &nodes[i]);
+			}
+			double lookup = milliseconds(start);
+			
+			start = Clock::now();
+			for(size_t i : order)
+			{
+				auto iterator = handles.find(&nodes[i]);
+				
+				table.Remove(iterator->second);
+				handles.erase(iterator);
+			}
+			double remove = milliseconds(start);
+			
+			RNInfo("Downpour: HandleTable and reverse map, %u nodes: register %.2fms, lookup %.2fms, unregister %.2fms", static_cast<uint32>(count), insert, lookup, remove);
+		}
+		
+		{
+			std::unordered_map<uint64, void *> table;
+			
+			Clock::time_point start = Clock::now();
+			for(size_t i = 0; i < count; i ++)
+				table[i + 1] = &nodes[i];
+			double insert = milliseconds(start);
+			
+			start = Clock::now();
+			for(size_t i : order)
+			{
+				auto iterator = table.find(i + 1);
+				found += (iterator != table.end() && iterator->second == &nodes[i]);
+			}
+			double lookup = milliseconds(start);
+			
+			start = Clock::now();
+			for(size_t i : order)
+				table.erase(i + 1);
+			double remove = milliseconds(start);
+			
+			RNInfo("Downpour: unordered_map, %u nodes: register %.2fms, lookup %.2fms, unregister %.2fms", static_cast<uint32>(count), insert, lookup, remove);
+		}
+		
+		RN_ASSERT(found == count * 2, "Benchmark lookups must find every node");
+	}
+	
+	void BenchmarkTransformCodec(size_t count)
+	{
+		// Checks the round trip error of the codec and measures the bytes per node it sends compared to the raw
+		// struct that went over the wire before, for a full update, a position only update and no change
+		struct LegacyTransform
+		{
+			uint32 hostID;
+			uint64 lid;
+			RN::Vector3 position;
+			RN::Vector3 scale;
+			RN::Quaternion rotation;
+		};
+		
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> positions(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> scales(0.1f, 10.0f);
+		std::normal_distribution<float> rotations(0.0f, 1.0f);
+		
+		std::vector<TransformRequest> requests(count);
+		
+		for(size_t i = 0; i < count; i ++)
+		{
+			TransformRequest &request = requests[i];
+			request.hostID = 1;
+			request.edit = 1;
+			request.handle = i + 1;
+			request.changes = TransformRequest::Changes::All;
+			request.position = RN::Vector3(positions(random), positions(random), positions(random));
+			request.scale = RN::Vector3(scales(random), scales(random), scales(random));
+			request.rotation = RN::Quaternion(rotations(random), rotations(random), rotations(random), rotations(random));
+			request.rotation.Normalize();
+		}
+		
+		TransformCodec codec;
+		
+		// Rounding to the grid is off by half a step at most, plus what a float loses at that magnitude
+		auto isOnGrid = [](float decoded, float original, float grid) {
+			return (std::fabs(decoded - original) <= grid * 0.5f + std::fabs(original) * std::numeric_limits<float>::epsilon() * 4.0f);
+		};
+		
+		auto send = [&](const char *name) {
+			
+			WireWriter writer;
+			codec.Encode(writer, requests);
+			
+			std::vector<TransformRequest> decoded;
+			WireReader reader(writer.GetBytes(), writer.GetLength());
+			
+			bool valid = codec.Decode(reader, decoded);
+			RN_ASSERT(valid && decoded.size() == count, "Benchmark batches must decode completely");
+			
+			float positionError = 0.0f;
+			float scaleError = 0.0f;
+			float rotationError = 0.0f;
+			
+			for(size_t i = 0; i < count; i ++)
+			{
+				const TransformRequest &request = requests[i];
+				const TransformRequest &result = decoded[i];
+				
+				if(result.changes & TransformRequest::Changes::Position)
+				{
+					float grid = codec.GetPositionGrid();
+					RN_ASSERT(isOnGrid(result.position.x, request.position.x, grid) && isOnGrid(result.position.y, request.position.y, grid) && isOnGrid(result.position.z, request.position.z, grid), "Decoded positions must be within half a grid step");
+					
+					positionError = std::max(positionError, std::fabs(result.position.x - request.position.x));
+					positionError = std::max(positionError, std::fabs(result.position.y - request.position.y));
+					positionError = std::max(positionError, std::fabs(result.position.z - request.position.z));
+				}
+				
+				if(result.changes & TransformRequest::Changes::Scale)
+				{
+					float grid = codec.GetScaleGrid();
+					RN_ASSERT(isOnGrid(result.scale.x, request.scale.x, grid) && isOnGrid(result.scale.y, request.scale.y, grid) && isOnGrid(result.scale.z, request.scale.z, grid), "Decoded scales must be within half a grid step");
+					
+					scaleError = std::max(scaleError, std::fabs(result.scale.x - request.scale.x));
+					scaleError = std::max(scaleError, std::fabs(result.scale.y - request.scale.y));
+					scaleError = std::max(scaleError, std::fabs(result.scale.z - request.scale.z));
+				}
+				
+				// q and -q are the same rotation, the angle follows from the distance to the closer one of both.
+				// Going through the distance instead of the dot product keeps small angles precise in floats.
+				if(result.changes & TransformRequest::Changes::Rotation)
+				{
+					const RN::Quaternion &a = request.rotation;
+					const RN::Quaternion &b = result.rotation;
+					
+					float difference = std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z) + (a.w - b.w) * (a.w - b.w));
+					float sum = std::sqrt((a.x + b.x) * (a.x + b.x) + (a.y + b.y) * (a.y + b.y) + (a.z + b.z) * (a.z + b.z) + (a.w + b.w) * (a.w + b.w));
+					float angle = 4.0f * std::asin(std::min(1.0f, std::min(difference, sum) * 0.5f));
+					
+					RN_ASSERT(angle <= TransformCodec::GetRotationErrorBound() + 1e-5f, "Decoded rotations must be within the bound of the smallest three packing");
+					rotationError = std::max(rotationError, angle * (180.0f / 3.14159265f));
+				}
+			}
+			
+			RNInfo("Downpour: TransformCodec, %s, %u nodes: %.2f bytes per node instead of %u, max error position %f, scale %f, rotation %f degrees", name, static_cast<uint32>(count), static_cast<double>(writer.GetLength()) / count, static_cast<uint32>(sizeof(LegacyTransform)), positionError, scaleError, rotationError);
+		};
+		
+		send("full update");
+		
+		for(TransformRequest &request : requests)
+			request.position += RN::Vector3(0.1f, 0.0f, -0.1f);
+		
+		send("position update");
+		send("no change");
+	}
+	
+	void BenchmarkJoinTime(size_t maxCount)
+	{
+		// Runs what a join costs besides the network on synthetic levels of growing size: serializing the world with
+		// its handles, compressing it chunk by chunk, reassembling it on the receiving side and decoding the nodes.
+		// The compressed size is what goes over the wire, the transfer time follows from the bandwidth at hand.
+		typedef std::chrono::high_resolution_clock Clock;
+		
+		auto milliseconds = [](Clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		};
+		
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> positions(-1000.0f, 1000.0f);
+		
+		for(size_t count = 1000; count <= maxCount; count *= 10)
+		{
+			RN::AutoreleasePool pool;
+			
+			RN::Array *nodes = new RN::Array();
+			for(size_t i = 0; i < count; i ++)
+			{
+				RN::SceneNode *node = new RN::SceneNode();
+				node->SetPosition(RN::Vector3(positions(random), positions(random), positions(random)));
+				
+				nodes->AddObject(node->Autorelease());
+			}
+			
+			Clock::time_point start = Clock::now();
+			
+			RN::FlatSerializer *serializer = new RN::FlatSerializer();
+			serializer->EncodeInt32(static_cast<int32>(count));
+			
+			nodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+				serializer->EncodeInt64(node->GetLID());
+				serializer->EncodeInt64(i + 1);
+			});
+			
+			serializer->EncodeObject(nodes);
+			
+			Snapshot *snapshot = new Snapshot(1, 0, serializer->GetSerializedData(), kDPSnapshotDefaultChunkSize);
+			serializer->Release();
+			
+			double serialize = milliseconds(start);
+			
+			start = Clock::now();
+			
+			std::vector<Packet *> packets;
+			packets.reserve(snapshot->GetChunkCount());
+			
+			size_t compressedLength = 0;
+			
+			for(size_t i = 0; i < snapshot->GetChunkCount(); i ++)
+			{
+				Packet *packet = snapshot->CreateChunkPacket(i);
+				compressedLength += packet->GetLength();
+				
+				packets.push_back(packet);
+			}
+			
+			double compress = milliseconds(start);
+			
+			start = Clock::now();
+			
+			Packet *info = snapshot->CreateInfoPacket(0);
+			WireReader infoReader(info->GetBytes(), info->GetLength());
+			
+			SnapshotReceiver receiver;
+			bool valid = receiver.Begin(infoReader);
+			
+			for(Packet *packet : packets)
+			{
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				valid = valid && receiver.ReceiveChunk(reader);
+			}
+			
+			double reassemble = milliseconds(start);
+			
+			RN_ASSERT(valid && receiver.IsComplete(), "Benchmark snapshots must reassemble completely");
+			
+			start = Clock::now();
+			
+			RN::Deserializer *deserializer = receiver.GetDeserializer();
+			
+			int32 handleCount = deserializer->DecodeInt32();
+			std::unordered_map<uint64, NetworkHandle> handles;
+			handles.reserve(handleCount);
+			
+			for(int32 i = 0; i < handleCount; i ++)
+			{
+				uint64 lid = deserializer->DecodeInt64();
+				handles[lid] = deserializer->DecodeInt64();
+			}
+			
+			RN::Array *loaded = static_cast<RN::Array *>(deserializer->DecodeObject());
+			
+			double load = milliseconds(start);
+			
+			RNInfo("Downpour: Join, %u nodes, %.1f KB (%.1f KB compressed): serialize %.2fms, compress %.2fms, reassemble %.2fms, load %.2fms, total %.2fms", static_cast<uint32>(count), snapshot->GetLength() / 1024.0, compressedLength / 1024.0, serialize, compress, reassemble, load, serialize + compress + reassemble + load);
+			
+			// Neither the synthetic nodes nor their loaded copies belong to the level
+			nodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+				node->RemoveFromWorld();
+			});
+			
+			loaded->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+				node->RemoveFromWorld();
+			});
+			
+			nodes->Release();
+			snapshot->Release();
+		}
+	}
+	
 	void ToggleDownpour()
 	{
 		// Activating/Deactivating downpour requires UI changes which must be done on the main thread
@@ -64,6 +431,34 @@ extern "C" RNMODULEAPI bool RNModuleConstructor(RN::ModuleExports *exports)
 	
 	if(RN::GetABIVersion() == kRNABIVersion)
 	{
+		DP::__module = exports->module;
+		
+		// A headless server never opens the editor, so it doesn't register the toggles or load the UI style
+		RN::String *headless = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::String>(RNCSTR("DPHeadlessServerLevel"));
+		if(headless)
+		{
+			std::string path = headless->GetUTF8String();
+			
+			RN::Kernel::GetSharedInstance()->ScheduleFunction([path] {
+				DP::RunHeadlessServer(path);
+			});
+			
+			return true;
+		}
+		
+		// Replaying a capture doesn't need the editor either, it starts once the engine is up
+		RN::String *capture = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::String>(RNCSTR("DPReplayCapture"));
+		if(capture)
+		{
+			std::string path = capture->GetUTF8String();
+			
+			RN::Kernel::GetSharedInstance()->ScheduleFunction([path] {
+				DP::ReplayCapture(path);
+			});
+			
+			return true;
+		}
+		
 		// Register some callbacks to allow toggling downpour on or off and use the Module as cookie
 		RN::MessageCenter::GetSharedInstance()->AddObserver(RNCSTR("DPToggle"), std::bind(&DP::ToggleDownpour), exports->module);
 		RN::MessageCenter::GetSharedInstance()->AddObserver(kRNInputEventMessage, [](RN::Message *message) {
@@ -81,7 +476,35 @@ extern "C" RNMODULEAPI bool RNModuleConstructor(RN::ModuleExports *exports)
 		std::string path = RN::PathManager::Join(exports->module->GetPath(), "Resources/uistyle.json");
 		RN::UI::Style::GetSharedInstance()->LoadStyle(path, RNCSTR("downpour"));
 		
-		DP::__module = exports->module;
+		RN::Number *benchmark = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(RNCSTR("DPBenchmarkHandleTable"));
+		if(benchmark)
+		{
+			int32 count = benchmark->GetInt32Value();
+			
+			RN::Kernel::GetSharedInstance()->ScheduleFunction([count] {
+				DP::BenchmarkHandleTable((count > 0) ? static_cast<size_t>(count) : 1000000);
+			});
+		}
+		
+		benchmark = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(RNCSTR("DPBenchmarkTransformCodec"));
+		if(benchmark)
+		{
+			int32 count = benchmark->GetInt32Value();
+			
+			RN::Kernel::GetSharedInstance()->ScheduleFunction([count] {
+				DP::BenchmarkTransformCodec((count > 0) ? static_cast<size_t>(count) : 100000);
+			});
+		}
+		
+		benchmark = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(RNCSTR("DPBenchmarkJoinTime"));
+		if(benchmark)
+		{
+			int32 count = benchmark->GetInt32Value();
+			
+			RN::Kernel::GetSharedInstance()->ScheduleFunction([count] {
+				DP::BenchmarkJoinTime((count > 0) ? static_cast<size_t>(count) : 100000);
+			});
+		}
 	}
 	
 	return true;
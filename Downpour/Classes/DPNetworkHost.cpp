@@ -0,0 +1,408 @@
+//
+//  DPNetworkHost.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPNetworkHost.h"
+
+namespace DP
+{
+	NetworkHost::NetworkHost(ENetHost *host) :
+		_host(host),
+		_statisticsTime(0),
+		_backlogTime(0),
+		_peerCounter(0),
+		_running(true)
+	{
+		RN_ASSERT(_host, "NetworkHost needs a valid ENetHost!");
+		
+		_statistics.sentBytes = 0;
+		_statistics.receivedBytes = 0;
+		_statistics.queuedCommands = 0;
+		_statistics.queuedEvents = 0;
+		
+		_thread = std::thread(&NetworkHost::Run, this);
+	}
+	
+	NetworkHost::~NetworkHost()
+	{
+		_running = false;
+		_thread.join();
+		
+		Event event;
+		while(_events.Pop(event))
+		{
+			if(event.packet)
+				event.packet->Release();
+		}
+	}
+	
+	// MARK: -
+	// MARK: Main thread
+	
+	uint32 NetworkHost::Connect(const ENetAddress &address)
+	{
+		Command command;
+		command.type = Command::Type::Connect;
+		command.peer = ++ _peerCounter;
+		command.packet = nullptr;
+		command.address = address;
+		
+		_commands.Push(command);
+		return command.peer;
+	}
+	
+	void NetworkHost::Send(uint32 peer, Packet *packet)
+	{
+		Command command;
+		command.type = Command::Type::Send;
+		command.peer = peer;
+		command.packet = packet->Retain();
+		
+		_commands.Push(command);
+	}
+	
+	void NetworkHost::Send(const std::vector<uint32> &peers, Packet *packet)
+	{
+		if(peers.empty())
+			return;
+		
+		Command command;
+		command.type = Command::Type::Multicast;
+		command.peer = 0;
+		command.packet = packet->Retain();
+		command.peers = peers;
+		
+		_commands.Push(command);
+	}
+	
+	void NetworkHost::Broadcast(Packet *packet)
+	{
+		Command command;
+		command.type = Command::Type::Broadcast;
+		command.peer = 0;
+		command.packet = packet->Retain();
+		
+		_commands.Push(command);
+	}
+	
+	bool NetworkHost::PollEvent(Event &event)
+	{
+		return _events.Pop(event);
+	}
+	
+	void NetworkHost::GetStatistics(Statistics &statistics)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_statisticsLock);
+			statistics = _statistics;
+		}
+		
+		statistics.queuedCommands = _commands.GetCount();
+		statistics.queuedEvents = _events.GetCount();
+	}
+	
+	void NetworkHost::GetBacklog(std::unordered_map<uint32, size_t> &backlog)
+	{
+		std::lock_guard<std::mutex> lock(_statisticsLock);
+		backlog = _backlog;
+	}
+	
+	// MARK: -
+	// MARK: I/O thread
+	
+	void NetworkHost::Run()
+	{
+		while(_running)
+		{
+			ProcessCommands();
+			
+			ENetEvent event;
+			if(enet_host_service(_host, &event, 1) > 0)
+			{
+				do {
+					HandleEvent(event);
+				} while(enet_host_check_events(_host, &event) > 0);
+			}
+			
+			if(ENET_TIME_DIFFERENCE(enet_time_get(), _statisticsTime) >= kDPNetworkStatisticsInterval)
+				PublishStatistics();
+			
+			if(ENET_TIME_DIFFERENCE(enet_time_get(), _backlogTime) >= kDPNetworkBacklogInterval)
+				PublishBacklog();
+		}
+		
+		Shutdown();
+	}
+	
+	void NetworkHost::ProcessCommands()
+	{
+		Command command;
+		while(_commands.Pop(command))
+		{
+			switch(command.type)
+			{
+				case Command::Type::Connect:
+				{
+					ENetPeer *peer = enet_host_connect(_host, &command.address, kDPNetworkChannelCount, 0);
+					if(!peer)
+					{
+						Event event;
+						event.type = Event::Type::Disconnect;
+						event.peer = command.peer;
+						event.packet = nullptr;
+						
+						_events.Push(event);
+						break;
+					}
+					
+					peer->data = reinterpret_cast<void *>(static_cast<uintptr_t>(command.peer));
+					_peers[command.peer] = peer;
+					break;
+				}
+					
+				case Command::Type::Send:
+				{
+					auto iterator = _peers.find(command.peer);
+					if(iterator != _peers.end())
+						SendToPeer(iterator->first, iterator->second, command.packet);
+					
+					command.packet->Release();
+					break;
+				}
+					
+				case Command::Type::Multicast:
+				{
+					for(uint32 peer : command.peers)
+					{
+						auto iterator = _peers.find(peer);
+						if(iterator != _peers.end())
+							SendToPeer(iterator->first, iterator->second, command.packet);
+					}
+					
+					command.packet->Release();
+					break;
+				}
+					
+				case Command::Type::Broadcast:
+				{
+					// Like enet_host_broadcast(), but with an ENet packet per peer to account for its backlog
+					for(auto &pair : _peers)
+					{
+						if(pair.second->state == ENET_PEER_STATE_CONNECTED)
+							SendToPeer(pair.first, pair.second, command.packet);
+					}
+					
+					command.packet->Release();
+					break;
+				}
+			}
+		}
+	}
+	
+	void NetworkHost::SendToPeer(uint32 peer, ENetPeer *enetPeer, Packet *packet)
+	{
+		// The ENet packets of all recipients reference the same buffer, so one per peer only costs the ENet struct.
+		// ENet frees a packet once it was sent, or acknowledged if it is reliable, which ends its share of the backlog.
+		ENetPacket *enetPacket = packet->CreateENetPacket();
+		
+		Delivery *delivery = new Delivery();
+		delivery->host = this;
+		delivery->peer = peer;
+		delivery->length = enetPacket->dataLength;
+		delivery->userData = enetPacket->userData;
+		delivery->freeCallback = enetPacket->freeCallback;
+		
+		enetPacket->userData = delivery;
+		enetPacket->freeCallback = &NetworkHost::ENetPacketFreed;
+		
+		_queuedBytes[peer] += delivery->length;
+		
+		if(enet_peer_send(enetPeer, GetChannelForPacket(packet), enetPacket) < 0)
+			enet_packet_destroy(enetPacket);
+	}
+	
+	void NetworkHost::ENetPacketFreed(ENetPacket *packet)
+	{
+		Delivery *delivery = static_cast<Delivery *>(packet->userData);
+		
+		auto iterator = delivery->host->_queuedBytes.find(delivery->peer);
+		if(iterator != delivery->host->_queuedBytes.end())
+			iterator->second -= std::min(iterator->second, delivery->length);
+		
+		// Hands the packet back to the callback of its creator
+		packet->userData = delivery->userData;
+		packet->freeCallback = delivery->freeCallback;
+		
+		if(packet->freeCallback)
+			packet->freeCallback(packet);
+		
+		delete delivery;
+	}
+	
+	void NetworkHost::HandleEvent(ENetEvent &event)
+	{
+		switch(event.type)
+		{
+			case ENET_EVENT_TYPE_CONNECT:
+			{
+				// Outgoing connections already got their ID when they were requested
+				if(!event.peer->data)
+					event.peer->data = reinterpret_cast<void *>(static_cast<uintptr_t>(++ _peerCounter));
+				
+				uint32 peer = GetPeerID(event.peer);
+				_peers[peer] = event.peer;
+				
+				Event result;
+				result.type = Event::Type::Connect;
+				result.peer = peer;
+				result.packet = nullptr;
+				
+				_events.Push(result);
+				break;
+			}
+				
+			case ENET_EVENT_TYPE_DISCONNECT:
+			{
+				uint32 peer = GetPeerID(event.peer);
+				
+				_peers.erase(peer);
+				_queuedBytes.erase(peer);
+				event.peer->data = nullptr;
+				
+				Event result;
+				result.type = Event::Type::Disconnect;
+				result.peer = peer;
+				result.packet = nullptr;
+				
+				_events.Push(result);
+				break;
+			}
+				
+			case ENET_EVENT_TYPE_RECEIVE:
+			{
+				if(!Packet::IsValidENetPacket(event.packet))
+				{
+					enet_packet_destroy(event.packet);
+					break;
+				}
+				
+				// The packet takes ownership of the ENet packet and is released by the main thread
+				Event result;
+				result.type = Event::Type::Receive;
+				result.peer = GetPeerID(event.peer);
+				result.packet = new Packet(event.packet);
+				
+				_events.Push(result);
+				break;
+			}
+				
+			default:
+				break;
+		}
+	}
+	
+	void NetworkHost::Shutdown()
+	{
+		ProcessCommands();
+		
+		for(auto &pair : _peers)
+			enet_peer_disconnect(pair.second, 0);
+		
+		// Give the peers a chance to acknowledge the disconnect before the host goes away
+		ENetEvent event;
+		while(!_peers.empty() && enet_host_service(_host, &event, kDPNetworkDisconnectTimeout) > 0)
+		{
+			switch(event.type)
+			{
+				case ENET_EVENT_TYPE_RECEIVE:
+					enet_packet_destroy(event.packet);
+					break;
+					
+				case ENET_EVENT_TYPE_DISCONNECT:
+					_peers.erase(GetPeerID(event.peer));
+					break;
+					
+				default:
+					break;
+			}
+		}
+		
+		for(auto &pair : _peers)
+			enet_peer_reset(pair.second);
+		
+		_peers.clear();
+		
+		enet_host_destroy(_host);
+		_host = nullptr;
+	}
+	
+	void NetworkHost::PublishStatistics()
+	{
+		_statisticsTime = enet_time_get();
+		
+		std::lock_guard<std::mutex> lock(_statisticsLock);
+		
+		_statistics.peers.clear();
+		
+		for(auto &pair : _peers)
+		{
+			if(pair.second->state != ENET_PEER_STATE_CONNECTED)
+				continue;
+			
+			PeerStatistics peer;
+			peer.peer = pair.first;
+			peer.roundTripTime = pair.second->roundTripTime;
+			peer.packetLoss = static_cast<float>(pair.second->packetLoss) / static_cast<float>(ENET_PEER_PACKET_LOSS_SCALE);
+			
+			_statistics.peers.push_back(peer);
+		}
+		
+		// ENet only keeps 32 bit totals, so they are moved into our own counters before they can wrap
+		_statistics.sentBytes += _host->totalSentData;
+		_statistics.receivedBytes += _host->totalReceivedData;
+		
+		_host->totalSentData = 0;
+		_host->totalReceivedData = 0;
+	}
+	
+	void NetworkHost::PublishBacklog()
+	{
+		_backlogTime = enet_time_get();
+		
+		std::unordered_map<uint32, size_t> backlog;
+		
+		for(auto &pair : _peers)
+		{
+			ENetPeer *peer = pair.second;
+			if(peer->state != ENET_PEER_STATE_CONNECTED)
+				continue;
+			
+			// In flight reliable data isn't freed before it is acknowledged, so it is already part of the queued bytes
+			auto iterator = _queuedBytes.find(pair.first);
+			backlog[pair.first] = (iterator != _queuedBytes.end()) ? iterator->second : 0;
+		}
+		
+		std::lock_guard<std::mutex> lock(_statisticsLock);
+		_backlog = std::move(backlog);
+	}
+	
+	uint8 NetworkHost::GetChannelForPacket(Packet *packet)
+	{
+		// ENet drops unreliable packets that arrive after a newer one on the same channel, which is exactly
+		// what intermediate transforms want, but they must not share a channel with the reliable traffic
+		return (packet->GetFlags() & Packet::Flags::Reliable) ? kDPNetworkReliableChannel : kDPNetworkUnreliableChannel;
+	}
+}
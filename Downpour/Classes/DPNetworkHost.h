@@ -0,0 +1,153 @@
+//
+//  DPNetworkHost.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPNETWORKHOST_H__
+#define __DPNETWORKHOST_H__
+
+#include <Rayne/Rayne.h>
+#include <enet/enet.h>
+#include <thread>
+#include <mutex>
+#include "DPPacket.h"
+#include "DPSPSCQueue.h"
+
+#define kDPNetworkReliableChannel   0
+#define kDPNetworkUnreliableChannel 1
+#define kDPNetworkChannelCount      2
+
+#define kDPNetworkDisconnectTimeout 3000
+#define kDPNetworkStatisticsInterval 1000
+#define kDPNetworkBacklogInterval    100
+
+#define kDPNetworkDefaultMaxPeers   256
+
+namespace DP
+{
+	// Owns an ENetHost and services it on a dedicated I/O thread which does nothing but socket work.
+	// The main thread talks to it exclusively through two single-producer/single-consumer queues,
+	// peers are identified by IDs so that no ENetPeer ever leaves the I/O thread.
+	class NetworkHost
+	{
+	public:
+		struct Event
+		{
+			enum class Type : uint8
+			{
+				Connect,
+				Disconnect,
+				Receive
+			};
+			
+			Type type;
+			uint32 peer;
+			Packet *packet;
+		};
+		
+		struct PeerStatistics
+		{
+			uint32 peer;
+			uint32 roundTripTime;
+			float packetLoss;
+		};
+		
+		struct Statistics
+		{
+			std::vector<PeerStatistics> peers;
+			uint64 sentBytes;
+			uint64 receivedBytes;
+			size_t queuedCommands;
+			size_t queuedEvents;
+		};
+		
+		NetworkHost(ENetHost *host);
+		~NetworkHost();
+		
+		uint32 Connect(const ENetAddress &address);
+		void Send(uint32 peer, Packet *packet);
+		void Send(const std::vector<uint32> &peers, Packet *packet);
+		void Broadcast(Packet *packet);
+		
+		// The caller owns the packet of receive events and has to release it
+		bool PollEvent(Event &event);
+		
+		// Round trip times and loss are published by the I/O thread once per interval, the byte counts are totals
+		void GetStatistics(Statistics &statistics);
+		
+		// Bytes handed to ENet per peer that haven't been sent or acknowledged yet, published every backlog interval
+		void GetBacklog(std::unordered_map<uint32, size_t> &backlog);
+		
+	private:
+		struct Command
+		{
+			enum class Type : uint8
+			{
+				Connect,
+				Send,
+				Multicast,
+				Broadcast
+			};
+			
+			Type type;
+			uint32 peer;
+			Packet *packet;
+			ENetAddress address;
+			std::vector<uint32> peers;
+		};
+		
+		// Remembers which peer an ENet packet went to, so freeing it takes its bytes off that peers backlog
+		struct Delivery
+		{
+			NetworkHost *host;
+			uint32 peer;
+			size_t length;
+			void *userData;
+			::ENetPacketFreeCallback freeCallback;
+		};
+		
+		void Run();
+		void ProcessCommands();
+		void SendToPeer(uint32 peer, ENetPeer *enetPeer, Packet *packet);
+		void HandleEvent(ENetEvent &event);
+		void Shutdown();
+		void PublishStatistics();
+		void PublishBacklog();
+		
+		static uint32 GetPeerID(ENetPeer *peer) { return static_cast<uint32>(reinterpret_cast<uintptr_t>(peer->data)); }
+		static uint8 GetChannelForPacket(Packet *packet);
+		static void ENetPacketFreed(ENetPacket *packet);
+		
+		ENetHost *_host;
+		std::unordered_map<uint32, ENetPeer *> _peers;
+		
+		SPSCQueue<Command> _commands;
+		SPSCQueue<Event> _events;
+		
+		std::mutex _statisticsLock;
+		Statistics _statistics;
+		enet_uint32 _statisticsTime;
+		
+		std::unordered_map<uint32, size_t> _backlog;
+		std::unordered_map<uint32, size_t> _queuedBytes;
+		enet_uint32 _backlogTime;
+		
+		std::atomic<uint32> _peerCounter;
+		std::atomic<bool> _running;
+		std::thread _thread;
+	};
+}
+
+#endif /* __DPNETWORKHOST_H__ */
@@ -0,0 +1,242 @@
+//
+//  DPNetworkStatistics.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPNetworkStatistics.h"
+#include <fstream>
+
+namespace DP
+{
+	NetworkStatistics::Counters::Counters() :
+		sentMessages(0),
+		receivedMessages(0),
+		sentBytes(0),
+		receivedBytes(0),
+		encodeTime(0.0),
+		decodeTime(0.0)
+	{}
+	
+	NetworkStatistics::Timer::Timer(NetworkStatistics &statistics, Kind kind, Packet::Type type) :
+		_statistics(statistics),
+		_kind(kind),
+		_type(type),
+		_start(std::chrono::steady_clock::now())
+	{}
+	
+	NetworkStatistics::Timer::~Timer()
+	{
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - _start;
+		_statistics.AddTime(_kind, _type, duration.count());
+	}
+	
+	
+	NetworkStatistics::NetworkStatistics() :
+		_historySize(kDPNetworkStatisticsDefaultHistory)
+	{
+		Reset();
+	}
+	
+	void NetworkStatistics::SetHistorySize(size_t size)
+	{
+		_historySize = std::max<size_t>(size, 1);
+		
+		while(_samples.size() > _historySize)
+			_samples.pop_front();
+	}
+	
+	void NetworkStatistics::Reset()
+	{
+		_current = Sample();
+		_current.stepTime = 0.0;
+		
+		_elapsed = 0.0f;
+		_time = 0.0;
+		
+		_lastSentBytes = 0;
+		_lastReceivedBytes = 0;
+		_sentMessages = 0;
+		
+		_samples.clear();
+	}
+	
+	
+	void NetworkStatistics::RecordSent(Packet *packet, size_t peers)
+	{
+		Counters &counters = _current.types[packet->GetType()];
+		counters.sentMessages += static_cast<uint32>(peers);
+		_sentMessages += peers;
+		counters.sentBytes += (sizeof(Packet::Header) + packet->GetLength()) * peers;
+	}
+	
+	void NetworkStatistics::RecordReceived(Packet *packet)
+	{
+		Counters &counters = _current.types[packet->GetType()];
+		counters.receivedMessages ++;
+		counters.receivedBytes += sizeof(Packet::Header) + packet->GetLength();
+	}
+	
+	void NetworkStatistics::AddTime(Timer::Kind kind, Packet::Type type, double time)
+	{
+		switch(kind)
+		{
+			case Timer::Kind::Encode:
+				_current.types[type].encodeTime += time;
+				break;
+			case Timer::Kind::Decode:
+				_current.types[type].decodeTime += time;
+				break;
+			case Timer::Kind::Step:
+				_current.stepTime += time;
+				break;
+		}
+	}
+	
+	bool NetworkStatistics::Step(float delta, NetworkHost *host)
+	{
+		_elapsed += delta;
+		
+		if(_elapsed < kDPNetworkStatisticsSampleInterval)
+			return false;
+		
+		_time += _elapsed;
+		_elapsed = 0.0f;
+		
+		NetworkHost::Statistics statistics;
+		statistics.sentBytes = _lastSentBytes;
+		statistics.receivedBytes = _lastReceivedBytes;
+		statistics.queuedCommands = 0;
+		statistics.queuedEvents = 0;
+		
+		// Replays run without a network host
+		if(host)
+			host->GetStatistics(statistics);
+		
+		_current.time = _time;
+		_current.queuedCommands = statistics.queuedCommands;
+		_current.queuedEvents = statistics.queuedEvents;
+		_current.peers = std::move(statistics.peers);
+		
+		// The host only knows totals, the sample gets what went over the wire since the previous one
+		_current.wireSentBytes = statistics.sentBytes - _lastSentBytes;
+		_current.wireReceivedBytes = statistics.receivedBytes - _lastReceivedBytes;
+		
+		_lastSentBytes = statistics.sentBytes;
+		_lastReceivedBytes = statistics.receivedBytes;
+		
+		_samples.push_back(std::move(_current));
+		
+		if(_samples.size() > _historySize)
+			_samples.pop_front();
+		
+		_current = Sample();
+		_current.stepTime = 0.0;
+		
+		return true;
+	}
+	
+	// MARK: -
+	// MARK: Output
+	
+	bool NetworkStatistics::WriteCSV(const std::string &path) const
+	{
+		std::ofstream stream(path, std::ios::out | std::ios::trunc);
+		if(!stream.is_open())
+			return false;
+		
+		// One row per sample and packet type, rows for the session as a whole and the peers use their own kind
+		stream << "time,kind,name,sent_messages,sent_bytes,received_messages,received_bytes,encode_ms,decode_ms,value\n";
+		
+		for(const Sample &sample : _samples)
+		{
+			stream << sample.time << ",session,step_ms,,,,,,," << (sample.stepTime * 1000.0) << "\n";
+			stream << sample.time << ",session,wire_sent_bytes,,,,,,," << sample.wireSentBytes << "\n";
+			stream << sample.time << ",session,wire_received_bytes,,,,,,," << sample.wireReceivedBytes << "\n";
+			stream << sample.time << ",session,queued_commands,,,,,,," << sample.queuedCommands << "\n";
+			stream << sample.time << ",session,queued_events,,,,,,," << sample.queuedEvents << "\n";
+			
+			for(auto &pair : sample.types)
+			{
+				const Counters &counters = pair.second;
+				
+				stream << sample.time << ",packet," << Packet::GetTypeName(pair.first) << ",";
+				stream << counters.sentMessages << "," << counters.sentBytes << ",";
+				stream << counters.receivedMessages << "," << counters.receivedBytes << ",";
+				stream << (counters.encodeTime * 1000.0) << "," << (counters.decodeTime * 1000.0) << ",\n";
+			}
+			
+			for(const NetworkHost::PeerStatistics &peer : sample.peers)
+			{
+				stream << sample.time << ",peer_rtt_ms," << peer.peer << ",,,,,,," << peer.roundTripTime << "\n";
+				stream << sample.time << ",peer_loss," << peer.peer << ",,,,,,," << peer.packetLoss << "\n";
+			}
+		}
+		
+		return stream.good();
+	}
+	
+	bool NetworkStatistics::WriteJSON(const std::string &path) const
+	{
+		std::ofstream stream(path, std::ios::out | std::ios::trunc);
+		if(!stream.is_open())
+			return false;
+		
+		stream << "{\"samples\":[";
+		
+		for(auto sample = _samples.begin(); sample != _samples.end(); sample ++)
+		{
+			if(sample != _samples.begin())
+				stream << ",";
+			
+			stream << "{\"time\":" << sample->time;
+			stream << ",\"step_ms\":" << (sample->stepTime * 1000.0);
+			stream << ",\"wire_sent_bytes\":" << sample->wireSentBytes;
+			stream << ",\"wire_received_bytes\":" << sample->wireReceivedBytes;
+			stream << ",\"queued_commands\":" << sample->queuedCommands;
+			stream << ",\"queued_events\":" << sample->queuedEvents;
+			
+			stream << ",\"packets\":{";
+			
+			for(auto pair = sample->types.begin(); pair != sample->types.end(); pair ++)
+			{
+				const Counters &counters = pair->second;
+				
+				if(pair != sample->types.begin())
+					stream << ",";
+				
+				stream << "\"" << Packet::GetTypeName(pair->first) << "\":{";
+				stream << "\"sent_messages\":" << counters.sentMessages << ",\"sent_bytes\":" << counters.sentBytes;
+				stream << ",\"received_messages\":" << counters.receivedMessages << ",\"received_bytes\":" << counters.receivedBytes;
+				stream << ",\"encode_ms\":" << (counters.encodeTime * 1000.0) << ",\"decode_ms\":" << (counters.decodeTime * 1000.0) << "}";
+			}
+			
+			stream << "},\"peers\":[";
+			
+			for(auto peer = sample->peers.begin(); peer != sample->peers.end(); peer ++)
+			{
+				if(peer != sample->peers.begin())
+					stream << ",";
+				
+				stream << "{\"peer\":" << peer->peer << ",\"rtt_ms\":" << peer->roundTripTime << ",\"loss\":" << peer->packetLoss << "}";
+			}
+			
+			stream << "]}";
+		}
+		
+		stream << "]}\n";
+		
+		return stream.good();
+	}
+}
@@ -0,0 +1,119 @@
+//
+//  DPNetworkStatistics.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPNETWORKSTATISTICS_H__
+#define __DPNETWORKSTATISTICS_H__
+
+#include <Rayne/Rayne.h>
+#include <chrono>
+#include <map>
+#include <deque>
+#include "DPPacket.h"
+#include "DPNetworkHost.h"
+
+#define kDPNetworkStatisticsSampleInterval 1.0f
+#define kDPNetworkStatisticsDefaultHistory 300
+
+#define kDPNetworkStatisticsDidSampleMessage RNCSTR("kDPNetworkStatisticsDidSampleMessage")
+
+namespace DP
+{
+	// Counts what the world attachment sends and receives per packet type, along with the time spent encoding
+	// and decoding, and samples it once per second together with the queue depths and per peer round trip
+	// times and loss of the network host. Samples are kept in a bounded history that can be written to disk.
+	class NetworkStatistics
+	{
+	public:
+		struct Counters
+		{
+			Counters();
+			
+			uint32 sentMessages;
+			uint32 receivedMessages;
+			uint64 sentBytes;
+			uint64 receivedBytes;
+			double encodeTime;
+			double decodeTime;
+		};
+		
+		struct Sample
+		{
+			double time;
+			double stepTime;
+			uint64 wireSentBytes;
+			uint64 wireReceivedBytes;
+			size_t queuedCommands;
+			size_t queuedEvents;
+			
+			std::map<Packet::Type, Counters> types;
+			std::vector<NetworkHost::PeerStatistics> peers;
+		};
+		
+		// Adds the time between construction and destruction to the encode or decode time of a packet type
+		class Timer
+		{
+		public:
+			enum class Kind : uint8
+			{
+				Encode,
+				Decode,
+				Step
+			};
+			
+			Timer(NetworkStatistics &statistics, Kind kind, Packet::Type type = Packet::Type::RequestWorld);
+			~Timer();
+			
+		private:
+			NetworkStatistics &_statistics;
+			Kind _kind;
+			Packet::Type _type;
+			std::chrono::steady_clock::time_point _start;
+		};
+		
+		NetworkStatistics();
+		
+		void SetHistorySize(size_t size);
+		
+		void RecordSent(Packet *packet, size_t peers = 1);
+		void RecordReceived(Packet *packet);
+		
+		bool Step(float delta, NetworkHost *host);
+		void Reset();
+		
+		const std::deque<Sample> &GetSamples() const { return _samples; }
+		uint64 GetSentMessages() const { return _sentMessages; }
+		
+		bool WriteCSV(const std::string &path) const;
+		bool WriteJSON(const std::string &path) const;
+		
+	private:
+		void AddTime(Timer::Kind kind, Packet::Type type, double time);
+		
+		Sample _current;
+		float _elapsed;
+		double _time;
+		
+		uint64 _lastSentBytes;
+		uint64 _lastReceivedBytes;
+		uint64 _sentMessages;
+		
+		size_t _historySize;
+		std::deque<Sample> _samples;
+	};
+}
+
+#endif /* __DPNETWORKSTATISTICS_H__ */
@@ -0,0 +1,125 @@
+//
+//  DPNetworkStatisticsPanel.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPNetworkStatisticsPanel.h"
+#include "DPWorldAttachment.h"
+#include "DPColorScheme.h"
+#include "DPInfoPanel.h"
+
+namespace DP
+{
+	RNDefineMeta(NetworkStatisticsPanel, RN::UI::Widget)
+	
+	NetworkStatisticsPanel::NetworkStatisticsPanel() :
+		RN::UI::Widget(RN::UI::Widget::Style::Titled | RN::UI::Widget::Style::Closable, RN::Rect(0.0f, 0.0f, 500.0f, 380.0f))
+	{
+		SetTitle(RNCSTR("Network Statistics"));
+		Center();
+		
+		_statisticsLabel = new RN::UI::Label();
+		_statisticsLabel->SetNumberOfLines(0);
+		_statisticsLabel->SetTextColor(ColorScheme::GetColor(ColorScheme::Type::FileTree_Text));
+		_statisticsLabel->SetFrame(RN::Rect(0.0f, 0.0f, 500.0f, 340.0f).Inset(10.0f, 10.0f));
+		_statisticsLabel->SetLineBreak(RN::UI::LineBreakMode::TruncateTail);
+		
+		_csvButton = new RN::UI::Button(RN::UI::Button::Type::Bezel);
+		_csvButton->SetTitleColorForState(ColorScheme::GetColor(ColorScheme::Type::FileTree_Text), RN::UI::Control::State::Normal);
+		_csvButton->SetTitleForState(RNCSTR("Write CSV..."), RN::UI::Control::State::Normal);
+		_csvButton->SetFrame(RN::Rect(150.0f, 340.0f, 95.0f, 30.0f));
+		_csvButton->AddListener(RN::UI::Control::EventType::MouseUpInside, std::bind(&NetworkStatisticsPanel::Write, this, false), nullptr);
+		
+		_jsonButton = new RN::UI::Button(RN::UI::Button::Type::Bezel);
+		_jsonButton->SetTitleColorForState(ColorScheme::GetColor(ColorScheme::Type::FileTree_Text), RN::UI::Control::State::Normal);
+		_jsonButton->SetTitleForState(RNCSTR("Write JSON..."), RN::UI::Control::State::Normal);
+		_jsonButton->SetFrame(RN::Rect(255.0f, 340.0f, 95.0f, 30.0f));
+		_jsonButton->AddListener(RN::UI::Control::EventType::MouseUpInside, std::bind(&NetworkStatisticsPanel::Write, this, true), nullptr);
+		
+		GetContentView()->AddSubview(_statisticsLabel);
+		GetContentView()->AddSubview(_csvButton);
+		GetContentView()->AddSubview(_jsonButton);
+		
+		RN::MessageCenter::GetSharedInstance()->AddObserver(kDPNetworkStatisticsDidSampleMessage, std::bind(&NetworkStatisticsPanel::UpdateStatistics, this), this);
+		UpdateStatistics();
+	}
+	
+	NetworkStatisticsPanel::~NetworkStatisticsPanel()
+	{
+		RN::MessageCenter::GetSharedInstance()->RemoveObserver(this);
+		
+		_jsonButton->Release();
+		_csvButton->Release();
+		_statisticsLabel->Release();
+	}
+	
+	void NetworkStatisticsPanel::UpdateStatistics()
+	{
+		const std::deque<NetworkStatistics::Sample> &samples = WorldAttachment::GetSharedInstance()->GetStatistics().GetSamples();
+		
+		if(samples.empty())
+		{
+			_statisticsLabel->SetText(RNCSTR("No samples yet, statistics are collected while a session is running."));
+			return;
+		}
+		
+		const NetworkStatistics::Sample &sample = samples.back();
+		
+		RN::String *text = RNSTR("Step: %.2f ms\nWire: %.1f KB/s sent, %.1f KB/s received\nQueues: %u commands, %u events\n\n",
+								 sample.stepTime * 1000.0,
+								 sample.wireSentBytes / 1024.0, sample.wireReceivedBytes / 1024.0,
+								 static_cast<uint32>(sample.queuedCommands), static_cast<uint32>(sample.queuedEvents));
+		
+		for(const NetworkHost::PeerStatistics &peer : sample.peers)
+			text->Append("Peer %u: %u ms, %.1f%% loss\n", peer.peer, peer.roundTripTime, peer.packetLoss * 100.0f);
+		
+		text->Append("\n");
+		
+		for(auto &pair : sample.types)
+		{
+			const NetworkStatistics::Counters &counters = pair.second;
+			
+			text->Append("%s: %u out (%.1f KB), %u in (%.1f KB), %.2f ms encode, %.2f ms decode\n",
+						 Packet::GetTypeName(pair.first),
+						 counters.sentMessages, counters.sentBytes / 1024.0,
+						 counters.receivedMessages, counters.receivedBytes / 1024.0,
+						 counters.encodeTime * 1000.0, counters.decodeTime * 1000.0);
+		}
+		
+		_statisticsLabel->SetText(text);
+	}
+	
+	void NetworkStatisticsPanel::Write(bool json)
+	{
+		RN::SavePanel *panel = new RN::SavePanel();
+		panel->SetTitle(json ? "Write Statistics as JSON" : "Write Statistics as CSV");
+		panel->SetCanCreateDirectories(true);
+		
+		panel->Show([json](bool result, const std::string &path) {
+			
+			if(!result)
+				return;
+			
+			const NetworkStatistics &statistics = WorldAttachment::GetSharedInstance()->GetStatistics();
+			bool success = json ? statistics.WriteJSON(path) : statistics.WriteCSV(path);
+			
+			if(!success)
+				InfoPanel::WithMessage(RNSTR("Couldn't write statistics to %s", path.c_str()));
+			
+		});
+		
+		panel->Release();
+	}
+}
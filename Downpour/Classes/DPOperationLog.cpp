@@ -0,0 +1,209 @@
+//
+//  DPOperationLog.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPOperationLog.h"
+
+namespace DP
+{
+	// Transforms are resolved per component, each one counts as a property of its own
+	static const std::pair<uint8, std::string> __TransformProperties[] = {
+		{ TransformRequest::Changes::Position, "position" },
+		{ TransformRequest::Changes::Rotation, "rotation" },
+		{ TransformRequest::Changes::Scale,    "scale" }
+	};
+	
+	// MARK: -
+	// MARK: OperationLog
+	
+	OperationLog::OperationLog() :
+		_capacity(kDPOperationLogDefaultCapacity),
+		_sequence(0),
+		_policy(ConflictPolicy::LastWriterWins)
+	{}
+	
+	void OperationLog::SetCapacity(size_t capacity)
+	{
+		_capacity = capacity;
+		
+		while(_operations.size() > _capacity)
+			_operations.pop_front();
+	}
+	
+	bool OperationLog::AcceptProperty(uint32 hostID, uint64 baseSequence, NetworkHandle handle, const std::string &property, bool record)
+	{
+		Writer &writer = _writers[handle][property];
+		
+		if(_policy == ConflictPolicy::FirstWriterWins && writer.sequence > baseSequence && writer.hostID != hostID)
+			return false;
+		
+		// The change will be part of the next operation, which is therefore the sequence that conflicts are checked against
+		if(record)
+		{
+			writer.hostID = hostID;
+			writer.sequence = GetNextSequence();
+		}
+		
+		return true;
+	}
+	
+	uint8 OperationLog::AcceptTransform(const TransformRequest &request, uint64 baseSequence, bool record)
+	{
+		uint8 accepted = 0;
+		
+		for(auto &pair : __TransformProperties)
+		{
+			if((request.changes & pair.first) && AcceptProperty(request.hostID, baseSequence, request.handle, pair.second, record))
+				accepted |= pair.first;
+		}
+		
+		return accepted;
+	}
+	
+	uint64 OperationLog::BeginOperation()
+	{
+		return ++ _sequence;
+	}
+	
+	void OperationLog::Record(uint64 sequence, Operation::Type type, uint32 hostID, NetworkHandle handle)
+	{
+		Operation operation;
+		operation.sequence = sequence;
+		operation.hostID = hostID;
+		operation.type = type;
+		operation.handle = handle;
+		
+		_operations.push_back(operation);
+		
+		if(_operations.size() > _capacity)
+			_operations.pop_front();
+	}
+	
+	uint64 OperationLog::Append(Operation::Type type, uint32 hostID, NetworkHandle handle)
+	{
+		uint64 sequence = BeginOperation();
+		Record(sequence, type, hostID, handle);
+		
+		return sequence;
+	}
+	
+	void OperationLog::Forget(NetworkHandle handle)
+	{
+		_writers.erase(handle);
+	}
+	
+	void OperationLog::Reset()
+	{
+		_operations.clear();
+		_writers.clear();
+		_sequence = 0;
+	}
+	
+	// MARK: -
+	// MARK: OperationSequencer
+	
+	OperationSequencer::OperationSequencer() :
+		_hostID(0),
+		_sequence(0),
+		_policy(ConflictPolicy::LastWriterWins)
+	{}
+	
+	void OperationSequencer::Reset(uint64 sequence)
+	{
+		_sequence = sequence;
+	}
+	
+	bool OperationSequencer::BeginOperation(uint64 sequence)
+	{
+		if(sequence <= _sequence)
+			return false;
+		
+		_sequence = sequence;
+		return true;
+	}
+	
+	void OperationSequencer::BeginLocalChange(NetworkHandle handle, const std::string &property, uint32 edit)
+	{
+		uint32 &latest = _localChanges[handle][property];
+		latest = std::max(latest, edit);
+	}
+	
+	void OperationSequencer::BeginLocalTransform(const TransformRequest &request)
+	{
+		for(auto &pair : __TransformProperties)
+		{
+			if(request.changes & pair.first)
+				BeginLocalChange(request.handle, pair.second, request.edit);
+		}
+	}
+	
+	bool OperationSequencer::ShouldApplyProperty(uint32 hostID, uint32 edit, uint8 flags, NetworkHandle handle, const std::string &property)
+	{
+		if(hostID == _hostID)
+		{
+			// Our own change came back, it is no longer in flight once the server answered its latest edit.
+			// The server merges transforms, so an answer may cover several of our requests at once.
+			auto iterator = _localChanges.find(handle);
+			if(iterator != _localChanges.end())
+			{
+				auto change = iterator->second.find(property);
+				if(change != iterator->second.end() && change->second <= edit)
+				{
+					iterator->second.erase(change);
+					
+					if(iterator->second.empty())
+						_localChanges.erase(iterator);
+				}
+			}
+			
+			// The value is already applied locally, unless the server rejected it
+			return (flags & Operation::Flags::Correction);
+		}
+		
+		if(_policy == ConflictPolicy::LastWriterWins && !(flags & Operation::Flags::Correction))
+		{
+			auto iterator = _localChanges.find(handle);
+			if(iterator != _localChanges.end() && iterator->second.count(property) > 0)
+				return false;
+		}
+		
+		return true;
+	}
+	
+	uint8 OperationSequencer::ShouldApplyTransform(const TransformRequest &request, uint8 flags)
+	{
+		uint8 changes = 0;
+		
+		for(auto &pair : __TransformProperties)
+		{
+			if((request.changes & pair.first) && ShouldApplyProperty(request.hostID, request.edit, flags, request.handle, pair.second))
+				changes |= pair.first;
+		}
+		
+		return changes;
+	}
+	
+	void OperationSequencer::Forget(NetworkHandle handle)
+	{
+		_localChanges.erase(handle);
+	}
+	
+	void OperationSequencer::Clear()
+	{
+		_localChanges.clear();
+		_sequence = 0;
+	}
+}
@@ -0,0 +1,136 @@
+//
+//  DPOperationLog.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPOPERATIONLOG_H__
+#define __DPOPERATIONLOG_H__
+
+#include <Rayne/Rayne.h>
+#include <deque>
+#include "DPTransformCodec.h"
+
+#define kDPOperationLogDefaultCapacity 4096
+
+namespace DP
+{
+	enum class ConflictPolicy : uint8
+	{
+		// Changes are applied in the order the server accepted them, a client keeps its own value
+		// of a property while its change is in flight, since that change will be sequenced later anyway
+		LastWriterWins,
+		// A change is rejected if another host changed the same property after the requester last heard
+		// from the server, everyone then receives the current value again as a correction
+		FirstWriterWins
+	};
+	
+	struct Operation
+	{
+		enum class Type : uint8
+		{
+			Transform,
+			Property,
+			Create,
+			Duplicate,
+			Delete
+		};
+		
+		enum Flags : uint8
+		{
+			Correction = (1 << 0),
+			// The current state of a node a peer wasn't interested in when it changed, not part of the sequence
+			CatchUp    = (1 << 1)
+		};
+		
+		uint64 sequence;
+		uint32 hostID;
+		Type type;
+		NetworkHandle handle;
+	};
+	
+	// Lives on the server. Every accepted mutation gets the next sequence number and is kept in a bounded log,
+	// the last writer of every property is remembered to decide conflicts according to the policy.
+	class OperationLog
+	{
+	public:
+		OperationLog();
+		
+		void SetCapacity(size_t capacity);
+		void SetConflictPolicy(ConflictPolicy policy) { _policy = policy; }
+		
+		ConflictPolicy GetConflictPolicy() const { return _policy; }
+		uint64 GetSequence() const { return _sequence; }
+		uint64 GetNextSequence() const { return _sequence + 1; }
+		const std::deque<Operation> &GetOperations() const { return _operations; }
+		
+		bool AcceptProperty(uint32 hostID, uint64 baseSequence, NetworkHandle handle, const std::string &property, bool record = true);
+		uint8 AcceptTransform(const TransformRequest &request, uint64 baseSequence, bool record = true);
+		
+		uint64 BeginOperation();
+		void Record(uint64 sequence, Operation::Type type, uint32 hostID, NetworkHandle handle);
+		uint64 Append(Operation::Type type, uint32 hostID, NetworkHandle handle);
+		
+		void Forget(NetworkHandle handle);
+		void Reset();
+		
+	private:
+		struct Writer
+		{
+			uint32 hostID;
+			uint64 sequence;
+		};
+		
+		std::deque<Operation> _operations;
+		size_t _capacity;
+		uint64 _sequence;
+		ConflictPolicy _policy;
+		
+		std::unordered_map<NetworkHandle, std::unordered_map<std::string, Writer>> _writers;
+	};
+	
+	// Lives on the clients. Drops operations that were already applied, for example because they are part
+	// of the world snapshot, and decides whether a remote change may overwrite a local one still in flight.
+	class OperationSequencer
+	{
+	public:
+		OperationSequencer();
+		
+		void SetHostID(uint32 hostID) { _hostID = hostID; }
+		void SetConflictPolicy(ConflictPolicy policy) { _policy = policy; }
+		
+		uint64 GetSequence() const { return _sequence; }
+		
+		void Reset(uint64 sequence);
+		bool BeginOperation(uint64 sequence);
+		
+		void BeginLocalChange(NetworkHandle handle, const std::string &property, uint32 edit);
+		void BeginLocalTransform(const TransformRequest &request);
+		
+		bool ShouldApplyProperty(uint32 hostID, uint32 edit, uint8 flags, NetworkHandle handle, const std::string &property);
+		uint8 ShouldApplyTransform(const TransformRequest &request, uint8 flags);
+		
+		void Forget(NetworkHandle handle);
+		void Clear();
+		
+	private:
+		uint32 _hostID;
+		uint64 _sequence;
+		ConflictPolicy _policy;
+		
+		std::unordered_map<NetworkHandle, std::unordered_map<std::string, uint32>> _localChanges;
+	};
+}
+
+#endif /* __DPOPERATIONLOG_H__ */
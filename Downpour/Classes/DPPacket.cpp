@@ -16,94 +16,219 @@
 //
 
 #include "DPPacket.h"
+#include <cstring>
 
 namespace DP
 {
 	RNDefineMeta(Packet, RN::Object)
 	
-	Packet::Packet(Type type, const void *data, size_t length) :
-		_type(type),
+	static_assert(sizeof(Packet::Header) == 8, "The packet header must not contain padding");
+	
+	Packet::Packet(Type type, const void *data, size_t length, uint16 flags) :
 		_data(nullptr),
-		_length(0)
+		_received(nullptr)
 	{
+		RN_ASSERT(length <= std::numeric_limits<uint32>::max(), "Packet payload is too large!");
+		
+		if(!data)
+			length = 0;
+		
+		_header.type   = static_cast<uint16>(type);
+		_header.flags  = flags;
+		_header.length = static_cast<uint32>(length);
+		
+		_buffer = new uint8[length + sizeof(Header)];
+		
 		if(data)
 		{
-			_data = new uint8[length];
-			_length = length;
-			
 			const uint8 *source = reinterpret_cast<const uint8 *>(data);
-			std::copy(source, source + _length, _data);
+			std::copy(source, source + length, _buffer);
 		}
+		
+		std::memcpy(_buffer + length, &_header, sizeof(Header));
 	}
 	
-	Packet::Packet(RN::Deserializer *deserializer)
+	Packet::Packet(Type type, RN::Data *data, uint16 flags) :
+		_data(data->Retain()),
+		_received(nullptr)
 	{
-		_type = static_cast<Type>(deserializer->DecodeInt32());
-		_data = nullptr;
+		RN_ASSERT(data->GetLength() <= std::numeric_limits<uint32>::max(), "Packet payload is too large!");
 		
-		bool hasData = deserializer->DecodeBool();
-		if(hasData)
-		{
-			const uint8 *source = reinterpret_cast<const uint8 *>(deserializer->DecodeBytes(&_length));
-			
-			_data = new uint8[_length];
-			
-			std::copy(source, source + _length, _data);
-		}
+		_header.type   = static_cast<uint16>(type);
+		_header.flags  = flags;
+		_header.length = static_cast<uint32>(data->GetLength());
+		
+		// Appending grows the buffer in place most of the time, the payload stays where it is
+		_data->Append(&_header, sizeof(Header));
+		_buffer = static_cast<uint8 *>(_data->GetBytes());
 	}
 	
-	Packet::~Packet()
+	Packet::Packet(ENetPacket *packet) :
+		_buffer(packet->data),
+		_data(nullptr),
+		_received(packet)
 	{
-		delete [] _data;
+		std::memcpy(&_header, packet->data + packet->dataLength - sizeof(Header), sizeof(Header));
 	}
 	
-	void Packet::Serialize(RN::Serializer *serializer)
+	Packet::~Packet()
 	{
-		serializer->EncodeInt32(static_cast<int32>(_type));
-		
-		if(_data)
+		if(_received)
 		{
-			serializer->EncodeBool(true);
-			serializer->EncodeBytes(_data, _length);
+			enet_packet_destroy(_received);
+			return;
 		}
-		else
+		
+		if(_data)
 		{
-			serializer->EncodeBool(false);
+			_data->Release();
+			return;
 		}
+		
+		delete [] _buffer;
 	}
 	
 	
-	Packet *Packet::WithType(Type type)
+	Packet *Packet::WithType(Type type, uint16 flags)
 	{
-		Packet *packet = new Packet(type, nullptr, 0);
+		Packet *packet = new Packet(type, nullptr, 0, flags);
 		return packet->Autorelease();
 	}
 	
-	Packet *Packet::WithTypeAndData(Type type, const void *data, size_t length)
+	Packet *Packet::WithTypeAndData(Type type, const void *data, size_t length, uint16 flags)
 	{
-		Packet *packet = new Packet(type, data, length);
+		Packet *packet = new Packet(type, data, length, flags);
 		return packet->Autorelease();
 	}
 	
-	Packet *Packet::WithTypeAndSerializer(Type type, RN::Serializer *serializer)
+	Packet *Packet::WithTypeAndSerializer(Type type, RN::Serializer *serializer, uint16 flags)
 	{
-		RN::Data *data = serializer->GetSerializedData();
-		return WithTypeAndData(type, data->GetBytes(), data->GetLength());
+		Packet *packet = new Packet(type, serializer->GetSerializedData(), flags);
+		return packet->Autorelease();
 	}
 	
-	void Packet::GetData(void *ptr) const
+	Packet *Packet::WithENetPacket(ENetPacket *packet)
 	{
-		if(_data)
+		if(!IsValidENetPacket(packet))
+		{
+			enet_packet_destroy(packet);
+			return nullptr;
+		}
+		
+		Packet *result = new Packet(packet);
+		return result->Autorelease();
+	}
+	
+	bool Packet::IsValidENetPacket(ENetPacket *packet)
+	{
+		if(packet->dataLength < sizeof(Header))
+			return false;
+		
+		// The header isn't necessarily aligned behind the payload
+		Header header;
+		std::memcpy(&header, packet->data + packet->dataLength - sizeof(Header), sizeof(Header));
+		
+		return (packet->dataLength - sizeof(Header) == header.length);
+	}
+	
+	const char *Packet::GetTypeName(Type type)
+	{
+		switch(type)
 		{
-			uint8 *destination = reinterpret_cast<uint8 *>(ptr);
-			std::copy(_data, _data + _length, destination);
+			case Type::RequestWorld:
+				return "RequestWorld";
+			case Type::AnswerWorld:
+				return "AnswerWorld";
+			case Type::RequestTransform:
+				return "RequestTransform";
+			case Type::AnswerTransform:
+				return "AnswerTransform";
+			case Type::RequestSceneNode:
+				return "RequestSceneNode";
+			case Type::AnswerSceneNode:
+				return "AnswerSceneNode";
+			case Type::RequestDeleteSceneNode:
+				return "RequestDeleteSceneNode";
+			case Type::AnswerDeleteSceneNode:
+				return "AnswerDeleteSceneNode";
+			case Type::RequestDuplicateSceneNode:
+				return "RequestDuplicateSceneNode";
+			case Type::AnswerDuplicateSceneNode:
+				return "AnswerDuplicateSceneNode";
+			case Type::AnswerHostID:
+				return "AnswerHostID";
+			case Type::RequestSceneNodeProperty:
+				return "RequestSceneNodeProperty";
+			case Type::AnswerSceneNodeProperty:
+				return "AnswerSceneNodeProperty";
+			case Type::AnswerWorldChunk:
+				return "AnswerWorldChunk";
+			case Type::AcknowledgeWorldChunk:
+				return "AcknowledgeWorldChunk";
+			case Type::AnswerStringTable:
+				return "AnswerStringTable";
+			case Type::RequestInterest:
+				return "RequestInterest";
+			case Type::RejectProvisional:
+				return "RejectProvisional";
+			case Type::RequestHandleBlock:
+				return "RequestHandleBlock";
+			case Type::AnswerHandleBlock:
+				return "AnswerHandleBlock";
+			case Type::AnnounceSceneNodes:
+				return "AnnounceSceneNodes";
+			case Type::RequestStateHash:
+				return "RequestStateHash";
+			case Type::AnswerStateHash:
+				return "AnswerStateHash";
+			case Type::RequestStateResync:
+				return "RequestStateResync";
+			case Type::AnswerStateResync:
+				return "AnswerStateResync";
+			case Type::AnswerCatchUp:
+				return "AnswerCatchUp";
 		}
+		
+		return "Unknown";
+	}
+	
+	
+	void Packet::GetData(void *ptr) const
+	{
+		const uint8 *source = GetBytes();
+		uint8 *destination = reinterpret_cast<uint8 *>(ptr);
+		
+		std::copy(source, source + GetLength(), destination);
 	}
 	
 	RN::Deserializer *Packet::GetDeserializer() const
 	{
-		RN::Data *data = RN::Data::WithBytes(_data, _length);
-		RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(data);
+		// The data doesn't copy the payload, so the deserializer must not outlive the packet
+		RN::Data *data = new RN::Data(GetBytes(), GetLength(), true, false);
+		RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(data->Autorelease());
 		return deserializer->Autorelease();
 	}
+	
+	
+	ENetPacket *Packet::CreateENetPacket()
+	{
+		RN_ASSERT(!_received, "Received packets can't be sent again!");
+		
+		uint32 flags = ENET_PACKET_FLAG_NO_ALLOCATE;
+		if(GetFlags() & Flags::Reliable)
+			flags |= ENET_PACKET_FLAG_RELIABLE;
+		
+		// ENet references the buffer directly, the packet is kept alive until ENet is done with it
+		ENetPacket *packet = enet_packet_create(_buffer, GetLength() + sizeof(Header), flags);
+		packet->userData = Retain();
+		packet->freeCallback = &Packet::ENetPacketFreeCallback;
+		
+		return packet;
+	}
+	
+	void Packet::ENetPacketFreeCallback(ENetPacket *packet)
+	{
+		Packet *owner = static_cast<Packet *>(packet->userData);
+		owner->Release();
+	}
 }
@@ -19,13 +19,14 @@
 #define __DPPACKET_H__
 
 #include <Rayne/Rayne.h>
+#include <enet/enet.h>
 
 namespace DP
 {
 	class Packet : public RN::Object
 	{
 	public:
-		enum class Type : int32
+		enum class Type : uint16
 		{
 			RequestWorld,
 			AnswerWorld,
@@ -39,29 +40,69 @@ namespace DP
 			AnswerDuplicateSceneNode,
 			AnswerHostID,
 			RequestSceneNodeProperty,
-			AnswerSceneNodeProperty
+			AnswerSceneNodeProperty,
+			AnswerWorldChunk,
+			AcknowledgeWorldChunk,
+			AnswerStringTable,
+			RequestInterest,
+			RejectProvisional,
+			RequestHandleBlock,
+			AnswerHandleBlock,
+			AnnounceSceneNodes,
+			RequestStateHash,
+			AnswerStateHash,
+			RequestStateResync,
+			AnswerStateResync,
+			AnswerCatchUp
 		};
 		
-		static Packet *WithType(Type type);
-		static Packet *WithTypeAndData(Type type, const void *data, size_t length);
-		static Packet *WithTypeAndSerializer(Type type, RN::Serializer *serializer);
+		enum Flags : uint16
+		{
+			Reliable = (1 << 0)
+		};
+		
+		// Every packet on the wire ends with this header, directly after the payload.
+		// Outgoing packets keep payload and header in one buffer which ENet sends without copying,
+		// incoming packets are a read-only view into the buffer of the received ENetPacket.
+		// Trailing the payload lets a serializers data take the header on without moving the payload.
+		struct Header
+		{
+			uint16 type;
+			uint16 flags;
+			uint32 length;
+		};
+		
+		static Packet *WithType(Type type, uint16 flags = Flags::Reliable);
+		static Packet *WithTypeAndData(Type type, const void *data, size_t length, uint16 flags = Flags::Reliable);
+		// Takes over the serialized data, the serializer must not be used to encode anything else afterwards
+		static Packet *WithTypeAndSerializer(Type type, RN::Serializer *serializer, uint16 flags = Flags::Reliable);
+		static Packet *WithENetPacket(ENetPacket *packet);
 		
-		Packet(Type type, const void *data, size_t length);
-		Packet(RN::Deserializer *deserializer);
+		Packet(Type type, const void *data, size_t length, uint16 flags);
+		Packet(Type type, RN::Data *data, uint16 flags);
+		Packet(ENetPacket *packet);
 		~Packet() override;
 		
-		void Serialize(RN::Serializer *serializer) override;
+		Type GetType() const { return static_cast<Type>(_header.type); }
+		uint16 GetFlags() const { return _header.flags; }
+		size_t GetLength() const { return _header.length; }
 		
-		Type GetType() const { return _type; }
-		size_t GetLength() const { return _length; }
+		const uint8 *GetBytes() const { return _buffer; }
 		void GetData(void *ptr) const;
 		RN::Deserializer *GetDeserializer() const;
 		
+		ENetPacket *CreateENetPacket();
+		
+		static bool IsValidENetPacket(ENetPacket *packet);
+		static const char *GetTypeName(Type type);
+		
 	private:
-		Type _type;
+		static void ENetPacketFreeCallback(ENetPacket *packet);
 		
-		uint8 *_data;
-		size_t _length;
+		Header _header;
+		uint8 *_buffer;
+		RN::Data *_data;
+		ENetPacket *_received;
 		
 		RNDeclareMeta(Packet)
 	};
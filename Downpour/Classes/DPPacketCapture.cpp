@@ -0,0 +1,204 @@
+//
+//  DPPacketCapture.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPPacketCapture.h"
+#include <cstring>
+
+#define kDPPacketCaptureMagic "DPCP"
+
+namespace DP
+{
+	PacketCapture::PacketCapture()
+	{}
+	
+	PacketCapture::~PacketCapture()
+	{
+		Close();
+	}
+	
+	bool PacketCapture::Open(const std::string &path, Role role)
+	{
+		Close();
+		
+		_stream.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!_stream.is_open())
+			return false;
+		
+		uint16 version = kDPPacketCaptureVersion;
+		uint8 type = static_cast<uint8>(role);
+		
+		_stream.write(kDPPacketCaptureMagic, 4);
+		_stream.write(reinterpret_cast<const char *>(&version), sizeof(uint16));
+		_stream.write(reinterpret_cast<const char *>(&type), sizeof(uint8));
+		
+		_start = std::chrono::steady_clock::now();
+		return _stream.good();
+	}
+	
+	void PacketCapture::Close()
+	{
+		if(_stream.is_open())
+			_stream.close();
+	}
+	
+	
+	void PacketCapture::WriteRecord(Kind kind, uint32 peer)
+	{
+		uint8 type = static_cast<uint8>(kind);
+		uint64 time = static_cast<uint64>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count());
+		
+		_stream.write(reinterpret_cast<const char *>(&type), sizeof(uint8));
+		_stream.write(reinterpret_cast<const char *>(&time), sizeof(uint64));
+		_stream.write(reinterpret_cast<const char *>(&peer), sizeof(uint32));
+	}
+	
+	void PacketCapture::WritePacket(Packet *packet)
+	{
+		Packet::Header header;
+		header.type   = static_cast<uint16>(packet->GetType());
+		header.flags  = packet->GetFlags();
+		header.length = static_cast<uint32>(packet->GetLength());
+		
+		_stream.write(reinterpret_cast<const char *>(&header), sizeof(Packet::Header));
+		_stream.write(reinterpret_cast<const char *>(packet->GetBytes()), packet->GetLength());
+	}
+	
+	void PacketCapture::RecordEvent(const NetworkHost::Event &event)
+	{
+		if(!IsOpen())
+			return;
+		
+		switch(event.type)
+		{
+			case NetworkHost::Event::Type::Connect:
+				WriteRecord(Kind::Connect, event.peer);
+				break;
+				
+			case NetworkHost::Event::Type::Disconnect:
+				WriteRecord(Kind::Disconnect, event.peer);
+				break;
+				
+			case NetworkHost::Event::Type::Receive:
+				WriteRecord(Kind::Received, event.peer);
+				WritePacket(event.packet);
+				break;
+		}
+	}
+	
+	void PacketCapture::RecordSent(uint32 peer, Packet *packet)
+	{
+		if(!IsOpen())
+			return;
+		
+		WriteRecord(Kind::Sent, peer);
+		WritePacket(packet);
+	}
+	
+	void PacketCapture::RecordStep(float delta)
+	{
+		if(!IsOpen())
+			return;
+		
+		WriteRecord(Kind::Step, 0);
+		_stream.write(reinterpret_cast<const char *>(&delta), sizeof(float));
+	}
+	
+	// MARK: -
+	// MARK: Reading
+	
+	bool PacketCaptureReader::Open(const std::string &path)
+	{
+		_stream.open(path, std::ios::in | std::ios::binary);
+		if(!_stream.is_open())
+			return false;
+		
+		char magic[4];
+		uint16 version = 0;
+		uint8 role = 0;
+		
+		_stream.read(magic, 4);
+		_stream.read(reinterpret_cast<char *>(&version), sizeof(uint16));
+		_stream.read(reinterpret_cast<char *>(&role), sizeof(uint8));
+		
+		if(!_stream.good() || std::memcmp(magic, kDPPacketCaptureMagic, 4) != 0 || version != kDPPacketCaptureVersion || role > static_cast<uint8>(PacketCapture::Role::Client))
+		{
+			_stream.close();
+			return false;
+		}
+		
+		_role = static_cast<PacketCapture::Role>(role);
+		return true;
+	}
+	
+	bool PacketCaptureReader::ReadRecord(Record &record)
+	{
+		if(!_stream.is_open())
+			return false;
+		
+		uint8 kind = 0;
+		
+		_stream.read(reinterpret_cast<char *>(&kind), sizeof(uint8));
+		_stream.read(reinterpret_cast<char *>(&record.time), sizeof(uint64));
+		_stream.read(reinterpret_cast<char *>(&record.peer), sizeof(uint32));
+		
+		if(!_stream.good() || kind > static_cast<uint8>(PacketCapture::Kind::Step))
+			return false;
+		
+		record.kind = static_cast<PacketCapture::Kind>(kind);
+		record.delta = 0.0f;
+		record.packet = nullptr;
+		
+		switch(record.kind)
+		{
+			case PacketCapture::Kind::Received:
+			case PacketCapture::Kind::Sent:
+			{
+				Packet::Header header;
+				_stream.read(reinterpret_cast<char *>(&header), sizeof(Packet::Header));
+				
+				// A truncated capture ends with the last complete record
+				if(!_stream.good() || header.length > kDPPacketCaptureMaxPacketLength)
+					return false;
+				
+				std::vector<uint8> payload(header.length);
+				_stream.read(reinterpret_cast<char *>(payload.data()), header.length);
+				
+				if(!_stream.good())
+					return false;
+				
+				Packet *packet = new Packet(static_cast<Packet::Type>(header.type), payload.data(), payload.size(), header.flags);
+				record.packet = packet->Autorelease();
+				break;
+			}
+				
+			case PacketCapture::Kind::Step:
+			{
+				_stream.read(reinterpret_cast<char *>(&record.delta), sizeof(float));
+				
+				if(!_stream.good())
+					return false;
+				
+				break;
+			}
+				
+			default:
+				break;
+		}
+		
+		return true;
+	}
+}
@@ -0,0 +1,100 @@
+//
+//  DPPacketCapture.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPPACKETCAPTURE_H__
+#define __DPPACKETCAPTURE_H__
+
+#include <Rayne/Rayne.h>
+#include <chrono>
+#include <fstream>
+#include "DPPacket.h"
+#include "DPNetworkHost.h"
+
+#define kDPPacketCaptureVersion         1
+#define kDPPacketCaptureMaxPacketLength (256 * 1024 * 1024)
+
+namespace DP
+{
+	// Captures are a small header followed by one record per network event, packet sent, or network step:
+	//   header: char[4] "DPCP", uint16 version, uint8 role
+	//   record: uint8 kind, uint64 microseconds since the capture began, uint32 peer,
+	//           then the packet header and payload for packets, or a float delta for steps
+	// Broadcasts are recorded as sent to peer 0.
+	class PacketCapture
+	{
+	public:
+		enum class Role : uint8
+		{
+			Server,
+			Client
+		};
+		
+		enum class Kind : uint8
+		{
+			Connect,
+			Disconnect,
+			Received,
+			Sent,
+			Step
+		};
+		
+		PacketCapture();
+		~PacketCapture();
+		
+		bool Open(const std::string &path, Role role);
+		void Close();
+		
+		bool IsOpen() const { return _stream.is_open(); }
+		
+		void RecordEvent(const NetworkHost::Event &event);
+		void RecordSent(uint32 peer, Packet *packet);
+		void RecordStep(float delta);
+		
+	private:
+		void WriteRecord(Kind kind, uint32 peer);
+		void WritePacket(Packet *packet);
+		
+		std::ofstream _stream;
+		std::chrono::steady_clock::time_point _start;
+	};
+	
+	class PacketCaptureReader
+	{
+	public:
+		struct Record
+		{
+			PacketCapture::Kind kind;
+			uint64 time;
+			uint32 peer;
+			float delta;
+			Packet *packet;
+		};
+		
+		bool Open(const std::string &path);
+		
+		PacketCapture::Role GetRole() const { return _role; }
+		
+		// The packet of the record is autoreleased
+		bool ReadRecord(Record &record);
+		
+	private:
+		std::ifstream _stream;
+		PacketCapture::Role _role;
+	};
+}
+
+#endif /* __DPPACKETCAPTURE_H__ */
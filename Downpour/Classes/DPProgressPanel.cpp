@@ -0,0 +1,73 @@
+//
+//  DPProgressPanel.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPProgressPanel.h"
+#include "DPColorScheme.h"
+
+#define kDPProgressPanelBarFrame RN::Rect(10.0f, 40.0f, 380.0f, 14.0f)
+
+namespace DP
+{
+	RNDefineMeta(ProgressPanel, RN::UI::Widget)
+	
+	ProgressPanel::ProgressPanel(RN::String *title) :
+		RN::UI::Widget(RN::UI::Widget::Style::Titled, RN::Rect(0.0f, 0.0f, 400.0f, 70.0f)),
+		_progress(0.0f)
+	{
+		SetTitle(title);
+		Center();
+		
+		_messageLabel = new RN::UI::Label();
+		_messageLabel->SetTextColor(ColorScheme::GetColor(ColorScheme::Type::FileTree_Text));
+		_messageLabel->SetFrame(RN::Rect(10.0f, 10.0f, 380.0f, 20.0f));
+		
+		_progressBackground = new RN::UI::View();
+		_progressBackground->SetBackgroundColor(ColorScheme::GetColor(ColorScheme::Type::Background_Light));
+		_progressBackground->SetFrame(kDPProgressPanelBarFrame);
+		
+		_progressBar = new RN::UI::View();
+		_progressBar->SetBackgroundColor(ColorScheme::GetColor(ColorScheme::Type::FileTree_Selection));
+		
+		GetContentView()->AddSubview(_messageLabel);
+		GetContentView()->AddSubview(_progressBackground);
+		GetContentView()->AddSubview(_progressBar);
+		
+		SetProgress(0.0f);
+	}
+	
+	ProgressPanel::~ProgressPanel()
+	{
+		_progressBar->Release();
+		_progressBackground->Release();
+		_messageLabel->Release();
+	}
+	
+	void ProgressPanel::SetMessage(RN::String *message)
+	{
+		_messageLabel->SetText(message);
+	}
+	
+	void ProgressPanel::SetProgress(float progress)
+	{
+		_progress = std::min(1.0f, std::max(0.0f, progress));
+		
+		RN::Rect frame = kDPProgressPanelBarFrame;
+		frame.width *= _progress;
+		
+		_progressBar->SetFrame(frame);
+	}
+}
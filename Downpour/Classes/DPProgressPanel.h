@@ -0,0 +1,47 @@
+//
+//  DPProgressPanel.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPPROGRESSPANEL_H__
+#define __DPPROGRESSPANEL_H__
+
+#include <Rayne/Rayne.h>
+
+namespace DP
+{
+	class ProgressPanel : public RN::UI::Widget
+	{
+	public:
+		ProgressPanel(RN::String *title);
+		~ProgressPanel();
+		
+		void SetMessage(RN::String *message);
+		void SetProgress(float progress);
+		
+		float GetProgress() const { return _progress; }
+		
+	private:
+		float _progress;
+		
+		RN::UI::Label *_messageLabel;
+		RN::UI::View *_progressBackground;
+		RN::UI::View *_progressBar;
+		
+		RNDeclareMeta(ProgressPanel)
+	};
+}
+
+#endif /* __DPPROGRESSPANEL_H__ */
@@ -0,0 +1,104 @@
+//
+//  DPSPSCQueue.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPSPSCQUEUE_H__
+#define __DPSPSCQUEUE_H__
+
+#include <Rayne/Rayne.h>
+#include <atomic>
+
+namespace DP
+{
+	// Unbounded, lock-free queue between exactly one producer and one consumer thread.
+	// The consumer owns the head, the producer owns the tail, the only shared state are the links between nodes
+	// and the count, which is only meant for statistics and may be read from any thread.
+	template<class T>
+	class SPSCQueue
+	{
+	public:
+		SPSCQueue() :
+			_count(0)
+		{
+			_head = _tail = new Node();
+		}
+		
+		~SPSCQueue()
+		{
+			while(_head)
+			{
+				Node *next = _head->next.load(std::memory_order_relaxed);
+				delete _head;
+				_head = next;
+			}
+		}
+		
+		SPSCQueue(const SPSCQueue &other) = delete;
+		SPSCQueue &operator =(const SPSCQueue &other) = delete;
+		
+		// Producer thread only
+		void Push(const T &value)
+		{
+			Node *node = new Node(value);
+			
+			_tail->next.store(node, std::memory_order_release);
+			_tail = node;
+			
+			_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		
+		// Consumer thread only
+		bool Pop(T &value)
+		{
+			Node *next = _head->next.load(std::memory_order_acquire);
+			if(!next)
+				return false;
+			
+			value = next->value;
+			
+			delete _head;
+			_head = next;
+			
+			_count.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		
+		size_t GetCount() const { return _count.load(std::memory_order_relaxed); }
+		
+	private:
+		struct Node
+		{
+			Node() :
+				next(nullptr)
+			{}
+			
+			explicit Node(const T &tvalue) :
+				value(tvalue),
+				next(nullptr)
+			{}
+			
+			T value;
+			std::atomic<Node *> next;
+		};
+		
+		alignas(64) Node *_head;
+		alignas(64) Node *_tail;
+		
+		std::atomic<size_t> _count;
+	};
+}
+
+#endif /* __DPSPSCQUEUE_H__ */
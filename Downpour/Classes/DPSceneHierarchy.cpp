@@ -145,7 +145,12 @@ namespace DP
 		RN::SceneNode *parent = node->GetParent();
 		if(!parent)
 		{
-			_data.emplace_back(new SceneNodeProxy(node));
+			// Nodes of a streamed level come and go as the camera moves, keeping the LID order keeps them in place
+			auto iterator = std::lower_bound(_data.begin(), _data.end(), node->GetLID(), [](const SceneNodeProxy *proxy, uint64 lid) {
+				return (proxy->node->GetLID() < lid);
+			});
+			
+			_data.insert(iterator, new SceneNodeProxy(node));
 			_tree->ReloadItem(nullptr, false);
 		}
 		else
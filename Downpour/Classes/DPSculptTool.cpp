@@ -140,35 +140,41 @@ namespace DP
 	{
 		if(_hasValidPosition)
 		{
-			switch(_shape)
+			ApplyStroke(_target, _shape, _mode, GetWorldPosition(), GetWorldScale());
+			WorldAttachment::GetSharedInstance()->GetLevelManager().RecordSculptStroke(_target, _shape, _mode, GetWorldPosition(), GetWorldScale());
+		}
+	}
+	
+	void SculptTool::ApplyStroke(RN::Sculptable *target, Shape shape, Mode mode, const RN::Vector3 &position, const RN::Vector3 &size)
+	{
+		switch(shape)
+		{
+			case Shape::Sphere:
+			{
+				if(mode == Mode::Add)
+				{
+					target->SetSphere(position, size.GetMax());
+				}
+				else if(mode == Mode::Substract)
+				{
+					target->RemoveSphere(position, size.GetMax());
+				}
+				
+				break;
+			}
+				
+			case Shape::Cube:
 			{
-				case Shape::Sphere:
+				if(mode == Mode::Add)
 				{
-					if(_mode == Mode::Add)
-					{
-						_target->SetSphere(GetWorldPosition(), GetWorldScale().GetMax());
-					}
-					else if(_mode == Mode::Substract)
-					{
-						_target->RemoveSphere(GetWorldPosition(), GetWorldScale().GetMax());
-					}
-					
-					break;
+					target->SetCube(position, size);
 				}
-					
-				case Shape::Cube:
+				else if(mode == Mode::Substract)
 				{
-					if(_mode == Mode::Add)
-					{
-						_target->SetCube(GetWorldPosition(), GetWorldScale());
-					}
-					else if(_mode == Mode::Substract)
-					{
-						_target->RemoveCube(GetWorldPosition(), GetWorldScale());
-					}
-					
-					break;
+					target->RemoveCube(position, size);
 				}
+				
+				break;
 			}
 		}
 	}
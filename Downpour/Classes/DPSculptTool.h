@@ -48,6 +48,8 @@ namespace DP
 		
 		void UseTool();
 		
+		static void ApplyStroke(RN::Sculptable *target, Shape shape, Mode mode, const RN::Vector3 &position, const RN::Vector3 &size);
+		
 		void SetRadius(float radius);
 		float GetRadius() const { return _radius; }
 		
@@ -0,0 +1,374 @@
+//
+//  DPSnapshotTransfer.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPSnapshotTransfer.h"
+
+namespace DP
+{
+	RNDefineMeta(Snapshot, RN::Object)
+	
+	// MARK: -
+	// MARK: Snapshot
+	
+	Snapshot::Snapshot(uint32 identifier, uint64 sequence, RN::Data *data, size_t chunkSize) :
+		_identifier(identifier),
+		_sequence(sequence),
+		_chunkSize(chunkSize),
+		_data(data->Retain()),
+		_rangeCoder(enet_range_coder_create())
+	{
+		RN_ASSERT(_chunkSize > 0, "Snapshot chunks must not be empty!");
+		RN_ASSERT(_rangeCoder, "Enet couldn't create a range coder!");
+		
+		_chunkCount = (_data->GetLength() + _chunkSize - 1) / _chunkSize;
+		_compressed.resize(_chunkSize);
+	}
+	
+	Snapshot::~Snapshot()
+	{
+		enet_range_coder_destroy(_rangeCoder);
+		_data->Release();
+	}
+	
+	Packet *Snapshot::CreateInfoPacket(size_t firstChunk) const
+	{
+		WireWriter writer;
+		writer.WriteVarUInt(_identifier);
+		writer.WriteVarUInt(_sequence);
+		writer.WriteVarUInt(_data->GetLength());
+		writer.WriteVarUInt(_chunkSize);
+		writer.WriteVarUInt(_chunkCount);
+		writer.WriteVarUInt(firstChunk);
+		
+		return Packet::WithTypeAndData(Packet::Type::AnswerWorld, writer.GetBytes(), writer.GetLength());
+	}
+	
+	Packet *Snapshot::CreateChunkPacket(size_t index)
+	{
+		RN_ASSERT(index < _chunkCount, "Snapshot chunk index out of range!");
+		
+		size_t offset = index * _chunkSize;
+		size_t length = std::min(_chunkSize, _data->GetLength() - offset);
+		
+		ENetBuffer buffer;
+		buffer.data = static_cast<uint8 *>(_data->GetBytes()) + offset;
+		buffer.dataLength = length;
+		
+		// The range coder returns 0 if the output doesn't fit, in that case the chunk is sent as is
+		size_t compressedLength = enet_range_coder_compress(_rangeCoder, &buffer, 1, length, _compressed.data(), length);
+		bool compressed = (compressedLength > 0);
+		
+		WireWriter writer;
+		writer.WriteVarUInt(_identifier);
+		writer.WriteVarUInt(index);
+		writer.WriteUInt8(compressed);
+		writer.WriteVarUInt(compressed ? compressedLength : length);
+		writer.WriteBytes(compressed ? _compressed.data() : buffer.data, compressed ? compressedLength : length);
+		
+		return Packet::WithTypeAndData(Packet::Type::AnswerWorldChunk, writer.GetBytes(), writer.GetLength());
+	}
+	
+	// MARK: -
+	// MARK: SnapshotSender
+	
+	SnapshotSender::SnapshotSender(Snapshot *snapshot, size_t firstChunk, size_t windowSize) :
+		_snapshot(snapshot->Retain()),
+		_windowSize(std::max<size_t>(windowSize, 1)),
+		_nextChunk(firstChunk),
+		_acknowledged(firstChunk)
+	{}
+	
+	SnapshotSender::SnapshotSender(const SnapshotSender &other) :
+		_snapshot(other._snapshot->Retain()),
+		_windowSize(other._windowSize),
+		_nextChunk(other._nextChunk),
+		_acknowledged(other._acknowledged)
+	{}
+	
+	SnapshotSender::~SnapshotSender()
+	{
+		_snapshot->Release();
+	}
+	
+	bool SnapshotSender::CanSendChunk() const
+	{
+		return (_nextChunk < _snapshot->GetChunkCount() && _nextChunk < _acknowledged + _windowSize);
+	}
+	
+	Packet *SnapshotSender::CreateNextChunkPacket()
+	{
+		return _snapshot->CreateChunkPacket(_nextChunk ++);
+	}
+	
+	void SnapshotSender::Acknowledge(size_t receivedChunks)
+	{
+		if(receivedChunks > _nextChunk)
+			return;
+		
+		_acknowledged = std::max(_acknowledged, receivedChunks);
+	}
+	
+	// MARK: -
+	// MARK: SnapshotCache
+	
+	SnapshotCache::SnapshotCache() :
+		_snapshot(nullptr),
+		_counter(0),
+		_chunkSize(kDPSnapshotDefaultChunkSize),
+		_windowSize(kDPSnapshotDefaultWindowSize),
+		_tailLimit(kDPSnapshotDefaultTailLimit)
+	{}
+	
+	SnapshotCache::~SnapshotCache()
+	{
+		Reset();
+	}
+	
+	bool SnapshotCache::IsOutdated(uint64 sequence) const
+	{
+		return (_snapshot && sequence - _snapshot->GetSequence() > _tailLimit);
+	}
+	
+	void SnapshotCache::Refresh(uint64 sequence, RN::Data *data)
+	{
+		RN::SafeRelease(_snapshot);
+		_snapshot = new Snapshot(++ _counter, sequence, data, _chunkSize);
+		
+		ClearTail();
+	}
+	
+	void SnapshotCache::ClearTail()
+	{
+		for(Packet *packet : _tail)
+			packet->Release();
+		
+		_tail.clear();
+		_tailTransforms.clear();
+		_tailProperties.clear();
+	}
+	
+	void SnapshotCache::Reset()
+	{
+		_senders.clear();
+		RN::SafeRelease(_snapshot);
+		
+		ClearTail();
+	}
+	
+	void SnapshotCache::RecordPacket(Packet *packet)
+	{
+		if(!_snapshot)
+			return;
+		
+		switch(packet->GetType())
+		{
+			case Packet::Type::AnswerSceneNode:
+			case Packet::Type::AnswerDuplicateSceneNode:
+			case Packet::Type::AnswerDeleteSceneNode:
+				_tail.push_back(packet->Retain());
+				break;
+				
+			default:
+				break;
+		}
+	}
+	
+	void SnapshotCache::RecordTransform(NetworkHandle handle)
+	{
+		if(_snapshot)
+			_tailTransforms.insert(handle);
+	}
+	
+	void SnapshotCache::RecordProperty(NetworkHandle handle, const std::string &name)
+	{
+		if(_snapshot)
+			_tailProperties[handle].insert(name);
+	}
+	
+	void SnapshotCache::BeginTransfer(uint32 peer, size_t firstChunk)
+	{
+		_senders.erase(peer);
+		_senders.emplace(peer, SnapshotSender(_snapshot, firstChunk, _windowSize));
+	}
+	
+	void SnapshotCache::EndTransfer(uint32 peer)
+	{
+		_senders.erase(peer);
+	}
+	
+	void SnapshotCache::Acknowledge(uint32 peer, uint32 identifier, size_t receivedChunks)
+	{
+		auto iterator = _senders.find(peer);
+		if(iterator != _senders.end() && iterator->second.GetSnapshot()->GetIdentifier() == identifier)
+			iterator->second.Acknowledge(receivedChunks);
+	}
+	
+	void SnapshotCache::SendChunks(NetworkStatistics &statistics, const std::function<void (uint32, Packet *)> &send)
+	{
+		// Chunks are only sent while the peer keeps acknowledging them, so a slow client
+		// never has more than a window of chunks queued up in ENet
+		for(auto iterator = _senders.begin(); iterator != _senders.end();)
+		{
+			SnapshotSender &sender = iterator->second;
+			
+			while(sender.CanSendChunk())
+			{
+				Packet *packet;
+				
+				{
+					NetworkStatistics::Timer timer(statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnswerWorldChunk);
+					packet = sender.CreateNextChunkPacket();
+				}
+				
+				send(iterator->first, packet);
+			}
+			
+			if(sender.IsComplete())
+			{
+				iterator = _senders.erase(iterator);
+				continue;
+			}
+			
+			iterator ++;
+		}
+	}
+	
+	// MARK: -
+	// MARK: SnapshotReceiver
+	
+	SnapshotReceiver::SnapshotReceiver() :
+		_identifier(0),
+		_sequence(0),
+		_chunkSize(0),
+		_chunkCount(0),
+		_receivedChunks(0),
+		_rangeCoder(enet_range_coder_create())
+	{
+		RN_ASSERT(_rangeCoder, "Enet couldn't create a range coder!");
+	}
+	
+	SnapshotReceiver::~SnapshotReceiver()
+	{
+		enet_range_coder_destroy(_rangeCoder);
+	}
+	
+	bool SnapshotReceiver::Begin(WireReader &reader)
+	{
+		uint32 identifier = static_cast<uint32>(reader.ReadVarUInt());
+		uint64 sequence   = reader.ReadVarUInt();
+		size_t length     = static_cast<size_t>(reader.ReadVarUInt());
+		size_t chunkSize  = static_cast<size_t>(reader.ReadVarUInt());
+		size_t chunkCount = static_cast<size_t>(reader.ReadVarUInt());
+		size_t firstChunk = static_cast<size_t>(reader.ReadVarUInt());
+		
+		if(!reader.IsValid() || identifier == 0 || chunkSize == 0 || chunkCount != (length + chunkSize - 1) / chunkSize)
+		{
+			Reset();
+			return false;
+		}
+		
+		// Resuming only works if the server continues exactly where we left off
+		if(firstChunk > 0)
+		{
+			if(identifier != _identifier || sequence != _sequence || firstChunk != _receivedChunks || length != _buffer.size() || chunkSize != _chunkSize)
+			{
+				Reset();
+				return false;
+			}
+			
+			return true;
+		}
+		
+		_identifier = identifier;
+		_sequence   = sequence;
+		_chunkSize  = chunkSize;
+		_chunkCount = chunkCount;
+		_receivedChunks = 0;
+		
+		_buffer.clear();
+		_buffer.resize(length);
+		
+		return true;
+	}
+	
+	bool SnapshotReceiver::ReceiveChunk(WireReader &reader)
+	{
+		uint32 identifier = static_cast<uint32>(reader.ReadVarUInt());
+		size_t index      = static_cast<size_t>(reader.ReadVarUInt());
+		bool compressed   = (reader.ReadUInt8() != 0);
+		size_t length     = static_cast<size_t>(reader.ReadVarUInt());
+		const uint8 *bytes = reader.ReadBytesInPlace(length);
+		
+		// Chunks arrive in order over the reliable channel, anything else belongs to an outdated transfer
+		if(!reader.IsValid() || !IsActive() || identifier != _identifier || index != _receivedChunks || index >= _chunkCount)
+			return false;
+		
+		size_t offset = index * _chunkSize;
+		size_t expected = std::min(_chunkSize, _buffer.size() - offset);
+		
+		if(compressed)
+		{
+			if(enet_range_coder_decompress(_rangeCoder, bytes, length, _buffer.data() + offset, expected) != expected)
+				return false;
+		}
+		else
+		{
+			if(length != expected)
+				return false;
+			
+			std::copy(bytes, bytes + length, _buffer.begin() + offset);
+		}
+		
+		_receivedChunks ++;
+		return true;
+	}
+	
+	void SnapshotReceiver::WriteResumeRequest(WireWriter &writer) const
+	{
+		writer.WriteVarUInt(_identifier);
+		writer.WriteVarUInt(_receivedChunks);
+	}
+	
+	void SnapshotReceiver::Reset()
+	{
+		_identifier = 0;
+		_sequence   = 0;
+		_chunkSize  = 0;
+		_chunkCount = 0;
+		_receivedChunks = 0;
+		
+		std::vector<uint8>().swap(_buffer);
+	}
+	
+	float SnapshotReceiver::GetProgress() const
+	{
+		if(_chunkCount == 0)
+			return 0.0f;
+		
+		return static_cast<float>(_receivedChunks) / static_cast<float>(_chunkCount);
+	}
+	
+	RN::Deserializer *SnapshotReceiver::GetDeserializer() const
+	{
+		RN_ASSERT(IsComplete(), "The snapshot must be complete before it can be deserialized!");
+		
+		// The data doesn't copy the buffer, so the deserializer must not outlive the receiver or its next reset
+		RN::Data *data = new RN::Data(_buffer.data(), _buffer.size(), true, false);
+		RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(data->Autorelease());
+		return deserializer->Autorelease();
+	}
+}
@@ -0,0 +1,181 @@
+//
+//  DPSnapshotTransfer.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPSNAPSHOTTRANSFER_H__
+#define __DPSNAPSHOTTRANSFER_H__
+
+#include <Rayne/Rayne.h>
+#include <enet/enet.h>
+#include <functional>
+#include "DPPacket.h"
+#include "DPWireBuffer.h"
+#include "DPHandleTable.h"
+#include "DPNetworkStatistics.h"
+
+#define kDPSnapshotDefaultChunkSize  (64 * 1024)
+#define kDPSnapshotDefaultWindowSize 16
+#define kDPSnapshotDefaultTailLimit  1024
+
+namespace DP
+{
+	// A serialized world as of the given operation sequence, split into fixed size chunks which are compressed independently.
+	// Chunks are compressed when they are sent, so a snapshot only ever holds the uncompressed data.
+	class Snapshot : public RN::Object
+	{
+	public:
+		Snapshot(uint32 identifier, uint64 sequence, RN::Data *data, size_t chunkSize);
+		~Snapshot() override;
+		
+		uint32 GetIdentifier() const { return _identifier; }
+		uint64 GetSequence() const { return _sequence; }
+		size_t GetLength() const { return _data->GetLength(); }
+		size_t GetChunkSize() const { return _chunkSize; }
+		size_t GetChunkCount() const { return _chunkCount; }
+		
+		Packet *CreateInfoPacket(size_t firstChunk) const;
+		Packet *CreateChunkPacket(size_t index);
+		
+	private:
+		uint32 _identifier;
+		uint64 _sequence;
+		size_t _chunkSize;
+		size_t _chunkCount;
+		
+		RN::Data *_data;
+		void *_rangeCoder;
+		std::vector<uint8> _compressed;
+		
+		RNDeclareMeta(Snapshot)
+	};
+	
+	// Streams a snapshot to a single peer, keeping at most a window of unacknowledged chunks in flight
+	class SnapshotSender
+	{
+	public:
+		SnapshotSender(Snapshot *snapshot, size_t firstChunk, size_t windowSize);
+		SnapshotSender(const SnapshotSender &other);
+		~SnapshotSender();
+		
+		SnapshotSender &operator =(const SnapshotSender &other) = delete;
+		
+		Snapshot *GetSnapshot() const { return _snapshot; }
+		
+		bool CanSendChunk() const;
+		Packet *CreateNextChunkPacket();
+		
+		void Acknowledge(size_t receivedChunks);
+		bool IsComplete() const { return _acknowledged >= _snapshot->GetChunkCount(); }
+		
+	private:
+		Snapshot *_snapshot;
+		size_t _windowSize;
+		size_t _nextChunk;
+		size_t _acknowledged;
+	};
+	
+	// The snapshot the server hands out to joiners, along with everything that happened since it was taken. Joiners
+	// in quick succession share it and catch up through its tail, until the tail grew too long to be worth replaying.
+	class SnapshotCache
+	{
+	public:
+		SnapshotCache();
+		~SnapshotCache();
+		
+		void SetChunkSize(size_t chunkSize) { _chunkSize = chunkSize; }
+		void SetWindowSize(size_t windowSize) { _windowSize = windowSize; }
+		void SetTailLimit(size_t tailLimit) { _tailLimit = tailLimit; }
+		
+		Snapshot *GetSnapshot() const { return _snapshot; }
+		bool IsOutdated(uint64 sequence) const;
+		
+		// Transfers that are still running keep the previous snapshot alive, they already received its tail
+		void Refresh(uint64 sequence, RN::Data *data);
+		void Reset();
+		
+		// Transforms and properties are caught up with their current state instead, the structural
+		// changes are replayed as they were sent since they are what the later operations build on
+		void RecordPacket(Packet *packet);
+		void RecordTransform(NetworkHandle handle);
+		void RecordProperty(NetworkHandle handle, const std::string &name);
+		
+		const std::vector<Packet *> &GetTailPackets() const { return _tail; }
+		const std::unordered_set<NetworkHandle> &GetTailTransforms() const { return _tailTransforms; }
+		const std::unordered_map<NetworkHandle, std::unordered_set<std::string>> &GetTailProperties() const { return _tailProperties; }
+		
+		void BeginTransfer(uint32 peer, size_t firstChunk);
+		void EndTransfer(uint32 peer);
+		void Acknowledge(uint32 peer, uint32 identifier, size_t receivedChunks);
+		bool HasTransfers() const { return !_senders.empty(); }
+		
+		// Hands every transfer the chunks its window allows, finished transfers are dropped
+		void SendChunks(NetworkStatistics &statistics, const std::function<void (uint32, Packet *)> &send);
+		
+	private:
+		void ClearTail();
+		
+		Snapshot *_snapshot;
+		uint32 _counter;
+		size_t _chunkSize;
+		size_t _windowSize;
+		size_t _tailLimit;
+		
+		std::unordered_map<uint32, SnapshotSender> _senders;
+		
+		std::vector<Packet *> _tail;
+		std::unordered_set<NetworkHandle> _tailTransforms;
+		std::unordered_map<NetworkHandle, std::unordered_set<std::string>> _tailProperties;
+	};
+	
+	// Reassembles a snapshot from its chunks. The received chunks survive a disconnect,
+	// so a new connection can resume the transfer after the last acknowledged chunk.
+	class SnapshotReceiver
+	{
+	public:
+		SnapshotReceiver();
+		~SnapshotReceiver();
+		
+		bool Begin(WireReader &reader);
+		bool ReceiveChunk(WireReader &reader);
+		
+		void WriteResumeRequest(WireWriter &writer) const;
+		void Reset();
+		
+		uint32 GetIdentifier() const { return _identifier; }
+		uint64 GetSequence() const { return _sequence; }
+		size_t GetReceivedChunks() const { return _receivedChunks; }
+		size_t GetChunkCount() const { return _chunkCount; }
+		size_t GetLength() const { return _buffer.size(); }
+		float GetProgress() const;
+		
+		bool IsActive() const { return (_identifier != 0); }
+		bool IsComplete() const { return (IsActive() && _receivedChunks == _chunkCount); }
+		
+		RN::Deserializer *GetDeserializer() const;
+		
+	private:
+		uint32 _identifier;
+		uint64 _sequence;
+		size_t _chunkSize;
+		size_t _chunkCount;
+		size_t _receivedChunks;
+		
+		void *_rangeCoder;
+		std::vector<uint8> _buffer;
+	};
+}
+
+#endif /* __DPSNAPSHOTTRANSFER_H__ */
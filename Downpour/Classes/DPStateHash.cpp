@@ -0,0 +1,154 @@
+//
+//  DPStateHash.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPStateHash.h"
+
+namespace DP
+{
+	static uint64 MixHash(uint64 value)
+	{
+		// Finalizer of splitmix64, spreads similar node states over all bits so their XOR doesn't cancel out
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+		
+		return value ^ (value >> 31);
+	}
+	
+	StateHashTree::StateHashTree() :
+		_buckets(GetLevelSize(kDPStateHashDepth))
+	{
+		for(uint32 level = 0; level <= kDPStateHashDepth; level ++)
+			_levels.emplace_back(GetLevelSize(level), 0);
+	}
+	
+	size_t StateHashTree::GetLevelSize(uint32 level)
+	{
+		size_t size = 1;
+		
+		for(uint32 i = 0; i < level; i ++)
+			size *= kDPStateHashFanOut;
+		
+		return size;
+	}
+	
+	size_t StateHashTree::GetBucketIndex(NetworkHandle handle)
+	{
+		// The index of a handle is dense, so its low bits spread the nodes evenly over the buckets
+		return HandleTable<void *>::GetIndex(handle) % GetLevelSize(kDPStateHashDepth);
+	}
+	
+	uint64 StateHashTree::HashBytes(const void *bytes, size_t length, uint64 hash)
+	{
+		const uint8 *data = static_cast<const uint8 *>(bytes);
+		
+		for(size_t i = 0; i < length; i ++)
+		{
+			hash ^= data[i];
+			hash *= 0x100000001b3ULL;
+		}
+		
+		return hash;
+	}
+	
+	
+	void StateHashTree::SetNode(NetworkHandle handle, uint64 hash)
+	{
+		Entry &entry = _entries[handle];
+		entry.state = hash;
+		
+		Update(handle, entry);
+	}
+	
+	void StateHashTree::SetProperty(NetworkHandle handle, const std::string &name, uint64 hash)
+	{
+		Entry &entry = _entries[handle];
+		uint64 &property = entry.propertyHashes[name];
+		
+		// Properties are combined order independent, each one is mixed with its name first
+		uint64 nameHash = HashBytes(name.data(), name.length());
+		
+		if(property)
+			entry.properties ^= MixHash(nameHash ^ property);
+		
+		property = hash;
+		entry.properties ^= MixHash(nameHash ^ property);
+		
+		Update(handle, entry);
+	}
+	
+	void StateHashTree::RemoveNode(NetworkHandle handle)
+	{
+		auto iterator = _entries.find(handle);
+		if(iterator == _entries.end())
+			return;
+		
+		size_t index = GetBucketIndex(handle);
+		
+		for(uint32 level = kDPStateHashDepth + 1; level > 0; level --)
+		{
+			_levels[level - 1][index] ^= iterator->second.hash;
+			index /= kDPStateHashFanOut;
+		}
+		
+		_buckets[GetBucketIndex(handle)].erase(handle);
+		_entries.erase(iterator);
+	}
+	
+	void StateHashTree::Clear()
+	{
+		_entries.clear();
+		
+		for(auto &bucket : _buckets)
+			bucket.clear();
+		
+		for(auto &level : _levels)
+			std::fill(level.begin(), level.end(), 0);
+	}
+	
+	std::vector<std::string> StateHashTree::GetProperties(NetworkHandle handle) const
+	{
+		std::vector<std::string> properties;
+		
+		auto iterator = _entries.find(handle);
+		if(iterator != _entries.end())
+		{
+			for(auto &pair : iterator->second.propertyHashes)
+				properties.push_back(pair.first);
+		}
+		
+		return properties;
+	}
+	
+	void StateHashTree::Update(NetworkHandle handle, Entry &entry)
+	{
+		uint64 hash = MixHash(handle ^ MixHash(entry.state ^ entry.properties));
+		uint64 delta = entry.hash ^ hash;
+		
+		entry.hash = hash;
+		
+		size_t bucket = GetBucketIndex(handle);
+		size_t index = bucket;
+		
+		_buckets[bucket].insert(handle);
+		
+		for(uint32 level = kDPStateHashDepth + 1; level > 0; level --)
+		{
+			_levels[level - 1][index] ^= delta;
+			index /= kDPStateHashFanOut;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+//
+//  DPStateHash.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPSTATEHASH_H__
+#define __DPSTATEHASH_H__
+
+#include <Rayne/Rayne.h>
+#include "DPHandleTable.h"
+
+#define kDPStateHashFanOut 16
+#define kDPStateHashDepth  2
+#define kDPStateHashDefaultInterval 5.0f
+
+namespace DP
+{
+	// Hash tree over the replicated state of the scene, which every peer keeps up to date as its nodes change.
+	// Nodes are sorted into the leaf buckets by their handle and every hash above is the XOR of its children,
+	// so a changed node only touches the hashes on its path to the root. Two peers compare the tree level by
+	// level and only have to resync the leaf buckets that differ.
+	class StateHashTree
+	{
+	public:
+		StateHashTree();
+		
+		void SetNode(NetworkHandle handle, uint64 hash);
+		void SetProperty(NetworkHandle handle, const std::string &name, uint64 hash);
+		void RemoveNode(NetworkHandle handle);
+		void Clear();
+		
+		uint64 GetHash(uint32 level, size_t index) const { return _levels[level][index]; }
+		
+		const std::unordered_set<NetworkHandle> &GetBucketNodes(size_t bucket) const { return _buckets[bucket]; }
+		std::vector<std::string> GetProperties(NetworkHandle handle) const;
+		
+		static size_t GetLevelSize(uint32 level);
+		static size_t GetBucketIndex(NetworkHandle handle);
+		
+		static uint64 HashBytes(const void *bytes, size_t length, uint64 hash = 0xcbf29ce484222325ULL);
+		
+	private:
+		struct Entry
+		{
+			Entry() :
+				state(0),
+				properties(0),
+				hash(0)
+			{}
+			
+			uint64 state;
+			uint64 properties;
+			uint64 hash;
+			
+			std::unordered_map<std::string, uint64> propertyHashes;
+		};
+		
+		void Update(NetworkHandle handle, Entry &entry);
+		
+		std::unordered_map<NetworkHandle, Entry> _entries;
+		std::vector<std::unordered_set<NetworkHandle>> _buckets;
+		std::vector<std::vector<uint64>> _levels;
+	};
+}
+
+#endif /* __DPSTATEHASH_H__ */
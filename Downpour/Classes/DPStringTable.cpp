@@ -0,0 +1,131 @@
+//
+//  DPStringTable.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPStringTable.h"
+
+#define kDPStringTableMaxDefinitions 65536
+
+namespace DP
+{
+	StringTable::StringTable() :
+		_authoritative(false),
+		_definedCount(0)
+	{}
+	
+	uint32 StringTable::Intern(const std::string &string)
+	{
+		auto iterator = _identifiers.find(string);
+		if(iterator != _identifiers.end())
+			return iterator->second;
+		
+		if(!_authoritative)
+			return 0;
+		
+		_strings.push_back(string);
+		
+		uint32 identifier = static_cast<uint32>(_strings.size());
+		_identifiers.emplace(string, identifier);
+		
+		return identifier;
+	}
+	
+	void StringTable::Encode(WireWriter &writer, const std::string &string)
+	{
+		uint32 identifier = Intern(string);
+		writer.WriteVarUInt(identifier);
+		
+		if(identifier == 0)
+			writer.WriteString(string);
+	}
+	
+	bool StringTable::Decode(WireReader &reader, std::string &string)
+	{
+		uint32 identifier = static_cast<uint32>(reader.ReadVarUInt());
+		
+		if(identifier == 0)
+		{
+			string = reader.ReadString();
+			
+			// Strings the clients keep sending inline become part of the table,
+			// they learn the ID with the next batch of definitions
+			if(_authoritative && reader.IsValid())
+				Intern(string);
+			
+			return reader.IsValid();
+		}
+		
+		if(identifier > _strings.size())
+			return false;
+		
+		string = _strings[identifier - 1];
+		return reader.IsValid();
+	}
+	
+	void StringTable::WriteDefinitions(WireWriter &writer, bool all)
+	{
+		size_t first = all ? 0 : _definedCount;
+		
+		writer.WriteVarUInt(first + 1);
+		writer.WriteVarUInt(_strings.size() - first);
+		
+		for(size_t i = first; i < _strings.size(); i ++)
+			writer.WriteString(_strings[i]);
+		
+		// A full table goes to a single new peer, everyone else still needs the pending definitions
+		if(!all)
+			_definedCount = _strings.size();
+	}
+	
+	bool StringTable::ReadDefinitions(WireReader &reader)
+	{
+		size_t first = static_cast<size_t>(reader.ReadVarUInt());
+		size_t count = static_cast<size_t>(reader.ReadVarUInt());
+		
+		if(!reader.IsValid() || first == 0 || first > _strings.size() + 1 || first + count > kDPStringTableMaxDefinitions)
+			return false;
+		
+		for(size_t i = 0; i < count; i ++)
+		{
+			std::string string = reader.ReadString();
+			if(!reader.IsValid())
+				return false;
+			
+			size_t index = first - 1 + i;
+			
+			if(index < _strings.size())
+			{
+				_identifiers.erase(_strings[index]);
+				_strings[index] = string;
+			}
+			else
+			{
+				_strings.push_back(string);
+			}
+			
+			_identifiers[string] = static_cast<uint32>(index + 1);
+		}
+		
+		return true;
+	}
+	
+	void StringTable::Reset()
+	{
+		_strings.clear();
+		_identifiers.clear();
+		_definedCount = 0;
+	}
+}
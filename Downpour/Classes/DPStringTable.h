@@ -0,0 +1,59 @@
+//
+//  DPStringTable.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPSTRINGTABLE_H__
+#define __DPSTRINGTABLE_H__
+
+#include <Rayne/Rayne.h>
+#include "DPWireBuffer.h"
+
+namespace DP
+{
+	// Session wide table of interned strings, so that names and paths go over the wire as varint IDs.
+	// The server owns the table and assigns the IDs, clients receive the full table when they connect
+	// and every definition the server adds later. A client that encodes a string the server doesn't
+	// know yet writes it inline, behind the reserved ID 0.
+	class StringTable
+	{
+	public:
+		StringTable();
+		
+		void SetAuthoritative(bool authoritative) { _authoritative = authoritative; }
+		bool IsAuthoritative() const { return _authoritative; }
+		
+		uint32 Intern(const std::string &string);
+		
+		void Encode(WireWriter &writer, const std::string &string);
+		bool Decode(WireReader &reader, std::string &string);
+		
+		bool HasPendingDefinitions() const { return (_definedCount < _strings.size()); }
+		void WriteDefinitions(WireWriter &writer, bool all);
+		bool ReadDefinitions(WireReader &reader);
+		
+		size_t GetCount() const { return _strings.size(); }
+		void Reset();
+		
+	private:
+		bool _authoritative;
+		size_t _definedCount;
+		
+		std::vector<std::string> _strings;
+		std::unordered_map<std::string, uint32> _identifiers;
+	};
+}
+
+#endif /* __DPSTRINGTABLE_H__ */
@@ -0,0 +1,316 @@
+//
+//  DPTransformCodec.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPTransformCodec.h"
+
+#define kDPTransformCodecRotationBits 15
+
+namespace DP
+{
+	TransformCodec::TransformCodec() :
+		_positionGrid(kDPTransformCodecDefaultPositionGrid),
+		_scaleGrid(kDPTransformCodecDefaultScaleGrid)
+	{}
+	
+	void TransformCodec::SetPositionGrid(float grid)
+	{
+		RN_ASSERT(grid > 0.0f, "The position grid must be larger than 0!");
+		
+		_positionGrid = grid;
+		_baselines.clear();
+	}
+	
+	void TransformCodec::SetScaleGrid(float grid)
+	{
+		RN_ASSERT(grid > 0.0f, "The scale grid must be larger than 0!");
+		
+		_scaleGrid = grid;
+		_baselines.clear();
+	}
+	
+	void TransformCodec::Forget(NetworkHandle handle)
+	{
+		_baselines.erase(handle);
+	}
+	
+	void TransformCodec::Reset()
+	{
+		_baselines.clear();
+	}
+	
+	
+	TransformCodec::Quantized TransformCodec::Quantize(const TransformRequest &request) const
+	{
+		Quantized result;
+		
+		result.position[0] = static_cast<int64>(std::llround(request.position.x / _positionGrid));
+		result.position[1] = static_cast<int64>(std::llround(request.position.y / _positionGrid));
+		result.position[2] = static_cast<int64>(std::llround(request.position.z / _positionGrid));
+		
+		result.scale[0] = static_cast<int64>(std::llround(request.scale.x / _scaleGrid));
+		result.scale[1] = static_cast<int64>(std::llround(request.scale.y / _scaleGrid));
+		result.scale[2] = static_cast<int64>(std::llround(request.scale.z / _scaleGrid));
+		
+		result.rotation = PackRotation(request.rotation);
+		
+		return result;
+	}
+	
+	// Gives the transform a receiver decodes from the quantized one
+	void TransformCodec::Restore(const Quantized &quantized, TransformRequest &request) const
+	{
+		request.position.x = quantized.position[0] * _positionGrid;
+		request.position.y = quantized.position[1] * _positionGrid;
+		request.position.z = quantized.position[2] * _positionGrid;
+		
+		request.scale.x = quantized.scale[0] * _scaleGrid;
+		request.scale.y = quantized.scale[1] * _scaleGrid;
+		request.scale.z = quantized.scale[2] * _scaleGrid;
+		
+		request.rotation = UnpackRotation(quantized.rotation);
+	}
+	
+	// Layout per batch:
+	//   varint group count
+	//   per group: varint host ID, varint edit, varint node count
+	//   per node:  varint handle, uint8 changes, [3 varint position], [48 bit rotation], [3 varint scale]
+	
+	void TransformCodec::Encode(WireWriter &writer, const std::vector<TransformRequest> &requests, bool updateBaselines)
+	{
+		std::vector<const TransformRequest *> sorted;
+		sorted.reserve(requests.size());
+		
+		for(const TransformRequest &request : requests)
+			sorted.push_back(&request);
+		
+		std::stable_sort(sorted.begin(), sorted.end(), [](const TransformRequest *a, const TransformRequest *b) {
+			return (a->hostID < b->hostID) || (a->hostID == b->hostID && a->edit < b->edit);
+		});
+		
+		size_t groups = 0;
+		for(size_t i = 0; i < sorted.size(); i ++)
+		{
+			if(i == 0 || sorted[i]->hostID != sorted[i - 1]->hostID || sorted[i]->edit != sorted[i - 1]->edit)
+				groups ++;
+		}
+		
+		writer.WriteVarUInt(groups);
+		
+		for(size_t i = 0; i < sorted.size();)
+		{
+			uint32 hostID = sorted[i]->hostID;
+			uint32 edit = sorted[i]->edit;
+			
+			size_t end = i;
+			while(end < sorted.size() && sorted[end]->hostID == hostID && sorted[end]->edit == edit)
+				end ++;
+			
+			writer.WriteVarUInt(hostID);
+			writer.WriteVarUInt(edit);
+			writer.WriteVarUInt(end - i);
+			
+			for(; i < end; i ++)
+			{
+				const TransformRequest *request = sorted[i];
+				Quantized quantized = Quantize(*request);
+				
+				uint8 changes = TransformRequest::Changes::All;
+				
+				auto iterator = _baselines.find(request->handle);
+				if(iterator != _baselines.end())
+				{
+					const Quantized &baseline = iterator->second;
+					changes = 0;
+					
+					if(!std::equal(quantized.position, quantized.position + 3, baseline.position))
+						changes |= TransformRequest::Changes::Position;
+					
+					if(quantized.rotation != baseline.rotation)
+						changes |= TransformRequest::Changes::Rotation;
+					
+					if(!std::equal(quantized.scale, quantized.scale + 3, baseline.scale))
+						changes |= TransformRequest::Changes::Scale;
+				}
+				
+				writer.WriteVarUInt(request->handle);
+				writer.WriteUInt8(changes);
+				
+				if(changes & TransformRequest::Changes::Position)
+				{
+					writer.WriteVarInt(quantized.position[0]);
+					writer.WriteVarInt(quantized.position[1]);
+					writer.WriteVarInt(quantized.position[2]);
+				}
+				
+				if(changes & TransformRequest::Changes::Rotation)
+				{
+					writer.WriteUInt16(static_cast<uint16>(quantized.rotation));
+					writer.WriteUInt32(static_cast<uint32>(quantized.rotation >> 16));
+				}
+				
+				if(changes & TransformRequest::Changes::Scale)
+				{
+					writer.WriteVarInt(quantized.scale[0]);
+					writer.WriteVarInt(quantized.scale[1]);
+					writer.WriteVarInt(quantized.scale[2]);
+				}
+				
+				if(updateBaselines)
+					_baselines[request->handle] = quantized;
+			}
+		}
+	}
+	
+	bool TransformCodec::Decode(WireReader &reader, std::vector<TransformRequest> &requests) const
+	{
+		size_t groups = static_cast<size_t>(reader.ReadVarUInt());
+		
+		for(size_t i = 0; i < groups && reader.IsValid(); i ++)
+		{
+			uint32 hostID = static_cast<uint32>(reader.ReadVarUInt());
+			uint32 edit   = static_cast<uint32>(reader.ReadVarUInt());
+			size_t count  = static_cast<size_t>(reader.ReadVarUInt());
+			
+			for(size_t j = 0; j < count && reader.IsValid(); j ++)
+			{
+				TransformRequest request;
+				request.hostID  = hostID;
+				request.edit    = edit;
+				request.handle  = reader.ReadVarUInt();
+				request.changes = reader.ReadUInt8();
+				
+				if(request.changes & TransformRequest::Changes::Position)
+				{
+					request.position.x = reader.ReadVarInt() * _positionGrid;
+					request.position.y = reader.ReadVarInt() * _positionGrid;
+					request.position.z = reader.ReadVarInt() * _positionGrid;
+				}
+				
+				if(request.changes & TransformRequest::Changes::Rotation)
+				{
+					uint64 packed = reader.ReadUInt16();
+					packed |= static_cast<uint64>(reader.ReadUInt32()) << 16;
+					
+					request.rotation = UnpackRotation(packed);
+				}
+				
+				if(request.changes & TransformRequest::Changes::Scale)
+				{
+					request.scale.x = reader.ReadVarInt() * _scaleGrid;
+					request.scale.y = reader.ReadVarInt() * _scaleGrid;
+					request.scale.z = reader.ReadVarInt() * _scaleGrid;
+				}
+				
+				if(reader.IsValid())
+					requests.push_back(request);
+			}
+		}
+		
+		return reader.IsValid();
+	}
+	
+	
+	// Smallest three: The largest component is dropped and restored from the unit length constraint.
+	// Its index goes into the top two bits, the three remaining components are stored with 15 bits each.
+	
+	uint64 TransformCodec::PackRotation(const RN::Quaternion &rotation)
+	{
+		float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+		
+		float length = std::sqrt(components[0] * components[0] + components[1] * components[1] + components[2] * components[2] + components[3] * components[3]);
+		if(length <= std::numeric_limits<float>::epsilon())
+		{
+			components[0] = components[1] = components[2] = 0.0f;
+			components[3] = 1.0f;
+			length = 1.0f;
+		}
+		
+		uint32 largest = 0;
+		for(uint32 i = 1; i < 4; i ++)
+		{
+			if(std::fabs(components[i]) > std::fabs(components[largest]))
+				largest = i;
+		}
+		
+		// q and -q describe the same rotation, so the dropped component is always made positive
+		float sign = (components[largest] < 0.0f) ? -1.0f : 1.0f;
+		
+		const float range = static_cast<float>((1 << kDPTransformCodecRotationBits) - 1);
+		const float limit = 1.0f / std::sqrt(2.0f);
+		
+		uint64 packed = largest;
+		
+		for(uint32 i = 0; i < 4; i ++)
+		{
+			if(i == largest)
+				continue;
+			
+			float value = (components[i] * sign) / length;
+			value = std::min(limit, std::max(-limit, value));
+			value = (value + limit) / (2.0f * limit);
+			
+			packed = (packed << kDPTransformCodecRotationBits) | static_cast<uint64>(std::lround(value * range));
+		}
+		
+		return packed;
+	}
+	
+	RN::Quaternion TransformCodec::UnpackRotation(uint64 packed)
+	{
+		const uint64 mask  = (1 << kDPTransformCodecRotationBits) - 1;
+		const float range = static_cast<float>(mask);
+		const float limit = 1.0f / std::sqrt(2.0f);
+		
+		uint32 largest = static_cast<uint32>((packed >> (kDPTransformCodecRotationBits * 3)) & 0x3);
+		
+		float components[4];
+		float sum = 0.0f;
+		
+		for(int32 i = 3, shift = 0; i >= 0; i --)
+		{
+			if(i == static_cast<int32>(largest))
+				continue;
+			
+			float value = static_cast<float>((packed >> shift) & mask) / range;
+			value = value * (2.0f * limit) - limit;
+			
+			components[i] = value;
+			sum += value * value;
+			
+			shift += kDPTransformCodecRotationBits;
+		}
+		
+		components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+		
+		RN::Quaternion rotation;
+		rotation.x = components[0];
+		rotation.y = components[1];
+		rotation.z = components[2];
+		rotation.w = components[3];
+		
+		return rotation;
+	}
+	
+	float TransformCodec::GetRotationErrorBound()
+	{
+		// Each stored component is off by at most half a step. The restored one is at least 1/2, so it is off by
+		// at most three half steps, which keeps the quaternion within sqrt(3) steps of the original one.
+		// Two unit quaternions that far apart describe rotations 4 * asin(distance / 2) apart.
+		const float step = std::sqrt(2.0f) / static_cast<float>((1 << kDPTransformCodecRotationBits) - 1);
+		return 4.0f * std::asin(std::sqrt(3.0f) * step * 0.5f);
+	}
+}
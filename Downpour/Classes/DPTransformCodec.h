@@ -0,0 +1,97 @@
+//
+//  DPTransformCodec.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPTRANSFORMCODEC_H__
+#define __DPTRANSFORMCODEC_H__
+
+#include <Rayne/Rayne.h>
+#include "DPWireBuffer.h"
+#include "DPHandleTable.h"
+
+#define kDPTransformCodecDefaultPositionGrid 0.0005f
+#define kDPTransformCodecDefaultScaleGrid    0.0005f
+
+namespace DP
+{
+	struct TransformRequest
+	{
+		enum Changes : uint8
+		{
+			Position = (1 << 0),
+			Rotation = (1 << 1),
+			Scale    = (1 << 2),
+			
+			All = Position | Rotation | Scale
+		};
+		
+		uint32 hostID;
+		uint32 edit;
+		NetworkHandle handle;
+		uint8 changes;
+		RN::Vector3 position;
+		RN::Vector3 scale;
+		RN::Quaternion rotation;
+	};
+	
+	// Encodes batches of transforms for the wire.
+	// Position and scale are quantized onto a per session grid and written as zigzag varints, rotations
+	// are packed with the smallest three method into 48 bits. A changed mask per node makes components
+	// that didn't change since the last batch encoded by the same codec cost nothing.
+	// Batches that may get lost on the way must not update the baselines, otherwise the receiver could miss changes.
+	
+	class TransformCodec
+	{
+	public:
+		struct Quantized
+		{
+			int64 position[3];
+			int64 scale[3];
+			uint64 rotation;
+		};
+		
+		TransformCodec();
+		
+		void SetPositionGrid(float grid);
+		void SetScaleGrid(float grid);
+		
+		float GetPositionGrid() const { return _positionGrid; }
+		float GetScaleGrid() const { return _scaleGrid; }
+		
+		void Encode(WireWriter &writer, const std::vector<TransformRequest> &requests, bool updateBaselines = true);
+		bool Decode(WireReader &reader, std::vector<TransformRequest> &requests) const;
+		
+		void Forget(NetworkHandle handle);
+		void Reset();
+		
+		Quantized Quantize(const TransformRequest &request) const;
+		void Restore(const Quantized &quantized, TransformRequest &request) const;
+		
+		static uint64 PackRotation(const RN::Quaternion &rotation);
+		static RN::Quaternion UnpackRotation(uint64 packed);
+		
+		// Largest angle in radians between a rotation and its packed round trip
+		static float GetRotationErrorBound();
+		
+	private:
+		float _positionGrid;
+		float _scaleGrid;
+		
+		std::unordered_map<NetworkHandle, Quantized> _baselines;
+	};
+}
+
+#endif /* __DPTRANSFORMCODEC_H__ */
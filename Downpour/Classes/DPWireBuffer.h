@@ -0,0 +1,203 @@
+//
+//  DPWireBuffer.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPWIREBUFFER_H__
+#define __DPWIREBUFFER_H__
+
+#include <Rayne/Rayne.h>
+
+namespace DP
+{
+	// Compact little helpers to write and read packet payloads byte by byte.
+	// Integers can be written as varints, signed ones are zigzag encoded first.
+	
+	class WireWriter
+	{
+	public:
+		void WriteUInt8(uint8 value)
+		{
+			_buffer.push_back(value);
+		}
+		
+		void WriteUInt16(uint16 value) { WriteBytes(&value, sizeof(uint16)); }
+		void WriteUInt32(uint32 value) { WriteBytes(&value, sizeof(uint32)); }
+		void WriteUInt64(uint64 value) { WriteBytes(&value, sizeof(uint64)); }
+		void WriteFloat(float value) { WriteBytes(&value, sizeof(float)); }
+		
+		void WriteVarUInt(uint64 value)
+		{
+			while(value >= 0x80)
+			{
+				_buffer.push_back(static_cast<uint8>(value | 0x80));
+				value >>= 7;
+			}
+			
+			_buffer.push_back(static_cast<uint8>(value));
+		}
+		
+		void WriteVarInt(int64 value)
+		{
+			WriteVarUInt((static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63));
+		}
+		
+		void WriteBytes(const void *bytes, size_t length)
+		{
+			const uint8 *source = reinterpret_cast<const uint8 *>(bytes);
+			_buffer.insert(_buffer.end(), source, source + length);
+		}
+		
+		void WriteString(const std::string &string)
+		{
+			WriteVarUInt(string.length());
+			WriteBytes(string.data(), string.length());
+		}
+		
+		// Objects go through a flat serializer and are written length prefixed
+		void WriteObject(RN::Object *object)
+		{
+			RN::FlatSerializer *serializer = new RN::FlatSerializer();
+			serializer->EncodeObject(object);
+			
+			RN::Data *data = serializer->GetSerializedData();
+			WriteVarUInt(data->GetLength());
+			WriteBytes(data->GetBytes(), data->GetLength());
+			
+			serializer->Release();
+		}
+		
+		const uint8 *GetBytes() const { return _buffer.data(); }
+		size_t GetLength() const { return _buffer.size(); }
+		
+	private:
+		std::vector<uint8> _buffer;
+	};
+	
+	class WireReader
+	{
+	public:
+		WireReader(const uint8 *bytes, size_t length) :
+			_bytes(bytes),
+			_length(length),
+			_offset(0),
+			_valid(true)
+		{}
+		
+		uint8 ReadUInt8()
+		{
+			if(_offset >= _length)
+			{
+				_valid = false;
+				return 0;
+			}
+			
+			return _bytes[_offset ++];
+		}
+		
+		uint16 ReadUInt16() { uint16 value = 0; ReadBytes(&value, sizeof(uint16)); return value; }
+		uint32 ReadUInt32() { uint32 value = 0; ReadBytes(&value, sizeof(uint32)); return value; }
+		uint64 ReadUInt64() { uint64 value = 0; ReadBytes(&value, sizeof(uint64)); return value; }
+		float ReadFloat() { float value = 0.0f; ReadBytes(&value, sizeof(float)); return value; }
+		
+		uint64 ReadVarUInt()
+		{
+			uint64 value = 0;
+			
+			for(uint32 shift = 0; shift < 64; shift += 7)
+			{
+				uint8 byte = ReadUInt8();
+				value |= static_cast<uint64>(byte & 0x7f) << shift;
+				
+				if(!(byte & 0x80))
+					return value;
+			}
+			
+			_valid = false;
+			return 0;
+		}
+		
+		int64 ReadVarInt()
+		{
+			uint64 value = ReadVarUInt();
+			return static_cast<int64>(value >> 1) ^ -static_cast<int64>(value & 1);
+		}
+		
+		void ReadBytes(void *bytes, size_t length)
+		{
+			if(length > _length - _offset)
+			{
+				_valid = false;
+				_offset = _length;
+				return;
+			}
+			
+			std::copy(_bytes + _offset, _bytes + _offset + length, reinterpret_cast<uint8 *>(bytes));
+			_offset += length;
+		}
+		
+		const uint8 *ReadBytesInPlace(size_t length)
+		{
+			if(length > _length - _offset)
+			{
+				_valid = false;
+				_offset = _length;
+				return nullptr;
+			}
+			
+			const uint8 *bytes = _bytes + _offset;
+			_offset += length;
+			
+			return bytes;
+		}
+		
+		std::string ReadString()
+		{
+			size_t length = static_cast<size_t>(ReadVarUInt());
+			const uint8 *bytes = ReadBytesInPlace(length);
+			
+			return bytes ? std::string(reinterpret_cast<const char *>(bytes), length) : std::string();
+		}
+		
+		RN::Object *ReadObject()
+		{
+			size_t length = static_cast<size_t>(ReadVarUInt());
+			const uint8 *bytes = ReadBytesInPlace(length);
+			
+			if(!bytes)
+				return nullptr;
+			
+			// The data doesn't copy the bytes, they have to stay alive while the object is decoded
+			RN::Data *data = new RN::Data(bytes, length, true, false);
+			RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(data->Autorelease());
+			
+			return deserializer->Autorelease()->DecodeObject();
+		}
+		
+		// Reading past the end of the buffer never touches invalid memory, but marks the reader as invalid
+		bool IsValid() const { return _valid; }
+		bool IsAtEnd() const { return (_offset >= _length); }
+		
+		size_t GetOffset() const { return _offset; }
+		
+	private:
+		const uint8 *_bytes;
+		size_t _length;
+		size_t _offset;
+		bool _valid;
+	};
+}
+
+#endif /* __DPWIREBUFFER_H__ */
@@ -0,0 +1,114 @@
+//
+//  DPWorkerPool.cpp
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DPWorkerPool.h"
+
+namespace DP
+{
+	WorkerPool::WorkerPool(size_t threads) :
+		_function(nullptr),
+		_count(0),
+		_next(0),
+		_active(0),
+		_generation(0),
+		_running(true)
+	{
+		if(threads == 0)
+		{
+			size_t cores = std::thread::hardware_concurrency();
+			threads = (cores > 1) ? cores - 1 : 0;
+		}
+		
+		for(size_t i = 0; i < threads; i ++)
+			_threads.emplace_back(&WorkerPool::Run, this);
+	}
+	
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_running = false;
+		}
+		
+		_startCondition.notify_all();
+		
+		for(std::thread &thread : _threads)
+			thread.join();
+	}
+	
+	void WorkerPool::Apply(size_t count, const std::function<void (size_t)> &function)
+	{
+		if(_threads.empty() || count <= 1)
+		{
+			for(size_t i = 0; i < count; i ++)
+				function(i);
+			
+			return;
+		}
+		
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_function = &function;
+			_count = count;
+			_next = 0;
+			_active = _threads.size();
+			_generation ++;
+		}
+		
+		_startCondition.notify_all();
+		Work();
+		
+		// The job lives on our stack, so every worker has to be out of it before returning
+		std::unique_lock<std::mutex> lock(_lock);
+		_doneCondition.wait(lock, [this]{ return (_active == 0); });
+		
+		_function = nullptr;
+	}
+	
+	void WorkerPool::Work()
+	{
+		size_t index;
+		while((index = _next.fetch_add(1)) < _count)
+			(*_function)(index);
+	}
+	
+	void WorkerPool::Run()
+	{
+		uint32 generation = 0;
+		
+		while(1)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_lock);
+				_startCondition.wait(lock, [&]{ return (!_running || _generation != generation); });
+				
+				if(!_running)
+					return;
+				
+				generation = _generation;
+			}
+			
+			Work();
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if((-- _active) == 0)
+				_doneCondition.notify_one();
+		}
+	}
+}
@@ -0,0 +1,64 @@
+//
+//  DPWorkerPool.h
+//  Downpour
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __DPWORKERPOOL_H__
+#define __DPWORKERPOOL_H__
+
+#include <Rayne/Rayne.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace DP
+{
+	// A fixed set of threads for data parallel work on the main thread. Apply() hands out the indices of a job
+	// one by one to the workers and the calling thread and returns once all of them are done, so the function
+	// may reference anything on the callers stack. The function must not touch Rayne objects, the workers have
+	// no autorelease pool.
+	class WorkerPool
+	{
+	public:
+		// 0 uses one thread less than there are cores, the calling thread makes up for the last one
+		WorkerPool(size_t threads = 0);
+		~WorkerPool();
+		
+		size_t GetThreadCount() const { return _threads.size(); }
+		
+		void Apply(size_t count, const std::function<void (size_t)> &function);
+		
+	private:
+		void Run();
+		void Work();
+		
+		std::vector<std::thread> _threads;
+		
+		std::mutex _lock;
+		std::condition_variable _startCondition;
+		std::condition_variable _doneCondition;
+		
+		const std::function<void (size_t)> *_function;
+		size_t _count;
+		std::atomic<size_t> _next;
+		size_t _active;
+		uint32 _generation;
+		bool _running;
+	};
+}
+
+#endif /* __DPWORKERPOOL_H__ */
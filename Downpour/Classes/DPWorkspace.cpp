@@ -18,6 +18,7 @@
 #include "DPWorkspace.h"
 #include "DPEditorIcon.h"
 #include "DPInfoPanel.h"
+#include "DPNetworkStatisticsPanel.h"
 #include "DPIPPanel.h"
 
 #define kDPWorkspaceToolbarHeight 40.0f
@@ -87,6 +88,9 @@ namespace DP
 		CreateMainMenu();
 		UpdateSize();
 		
+		LevelManager &levelManager = _worldAttachment->GetLevelManager();
+		levelManager.OpenJournal(levelManager.GetLevelPath());
+		
 		RN::MessageCenter::GetSharedInstance()->AddObserver(kRNUIServerDidResizeMessage, std::bind(&Workspace::UpdateSize, this), this);
 	}
 	
@@ -94,6 +98,7 @@ namespace DP
 	{
 		RN::MessageCenter::GetSharedInstance()->RemoveObserver(this);
 		RN::WorldCoordinator::GetSharedInstance()->GetWorld()->RemoveAttachment(_worldAttachment);
+		_worldAttachment->GetLevelManager().RestoreStreamedLevel();
 		
 		_viewport->Release();
 		_fileTree->Release();
@@ -221,6 +226,14 @@ namespace DP
 		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Host Session"), std::bind(&Workspace::HostSession, this)));
 		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Connect to Session"), std::bind(&Workspace::ConnectToSession, this)));
 		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Disconnect from Session"), std::bind(&Workspace::DisconnectFromSession, this)));
+		networkMenu->AddItem(RN::UI::MenuItem::SeparatorItem());
+		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Statistics..."), std::bind(&Workspace::ShowNetworkStatistics, this)));
+		networkMenu->AddItem(RN::UI::MenuItem::SeparatorItem());
+		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Start Capture..."), std::bind(&Workspace::StartCapture, this)));
+		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Stop Capture"), std::bind(&Workspace::StopCapture, this)));
+		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Replay Capture..."), std::bind(&Workspace::ReplayCapture, this)));
+		networkMenu->AddItem(RN::UI::MenuItem::SeparatorItem());
+		networkMenu->AddItem(RN::UI::MenuItem::WithTitle(RNCSTR("Run Load Test"), std::bind(&Workspace::RunLoadTest, this)));
 		
 		menu->AddItem(fileItem);
 		menu->AddItem(editItem);
@@ -255,6 +268,11 @@ namespace DP
 				
 				RN::Kernel::GetSharedInstance()->ScheduleFunction([path]() {
 					
+					// Unsaved edits stay in the journal of the current level and are replayed when it is opened again
+					LevelManager &levelManager = WorldAttachment::GetSharedInstance()->GetLevelManager();
+					levelManager.ResetLevelChunks();
+					levelManager.CloseJournal();
+					
 					{
 						RN::AutoreleasePool pool;
 						DeactivateDownpour();
@@ -264,12 +282,13 @@ namespace DP
 					
 						RN::MessageCenter::GetSharedInstance()->AddObserver(kRNWorldCoordinatorDidFinishLoadingMessage, [](RN::Message *message) {
 							
+							WorldAttachment::GetSharedInstance()->GetLevelManager().FinishLoadingLevel();
 							ActivateDownpour();
 							RN::MessageCenter::GetSharedInstance()->RemoveObserver(const_cast<char *>(__DPCookie));
 							
 						}, const_cast<char *>(__DPCookie));
 						
-						RN::WorldCoordinator::GetSharedInstance()->LoadWorld(path);
+						WorldAttachment::GetSharedInstance()->GetLevelManager().LoadLevel(path);
 						
 					});
 				});
@@ -281,17 +300,28 @@ namespace DP
 	
 	void Workspace::Save()
 	{
-		std::string path = RN::WorldCoordinator::GetSharedInstance()->GetWorldFile();
+		// The world attachment only knows the file the level was loaded from, not where it was saved to since
+		std::string path = _levelPath.empty() ? _worldAttachment->GetLevelManager().GetLevelPath() : _levelPath;
 		if(path.empty())
 		{
 			SaveAs();
 			return;
 		}
 		
+		SaveLevel(path);
+	}
+	
+	void Workspace::SaveLevel(const std::string &path)
+	{
 		try
 		{
-			RN::WorldCoordinator::GetSharedInstance()->SaveWorld(path);
-			RNInfo("Downpour: Saved world succesfully to %s", path.c_str());
+			if(!_worldAttachment->GetLevelManager().SaveLevel(path))
+			{
+				RNInfo("Downpour: Still saving or opening the world, try again once it is done");
+				return;
+			}
+			
+			_levelPath = path;
 		}
 		catch(RN::Exception e)
 		{
@@ -310,19 +340,7 @@ namespace DP
 		panel->Show([&](bool result, const std::string &path) {
 			
 			if(result)
-			{
-				try
-				{
-					RN::WorldCoordinator::GetSharedInstance()->SaveWorld(path);
-					RNInfo("Downpour: Saved world succesfully to %s", path.c_str());
-				}
-				catch(RN::Exception e)
-				{
-					ExceptionPanel *exceptionPanel = new ExceptionPanel(e);
-					exceptionPanel->Open();
-					exceptionPanel->Release();
-				}
-			}
+				SaveLevel(path);
 			
 		});
 		
@@ -392,6 +410,64 @@ namespace DP
 		_worldAttachment->DestroyHost();
 	}
 	
+	void Workspace::ShowNetworkStatistics()
+	{
+		NetworkStatisticsPanel *panel = new NetworkStatisticsPanel();
+		panel->Open();
+		panel->Release();
+	}
+	
+	void Workspace::StartCapture()
+	{
+		RN::SavePanel *panel = new RN::SavePanel();
+		panel->SetTitle("Capture Session to...");
+		panel->SetCanCreateDirectories(true);
+		
+		panel->Show([&](bool result, const std::string &path) {
+			
+			if(result && !_worldAttachment->StartCapture(path))
+				InfoPanel::WithMessage(RNCSTR("Couldn't start the capture, make sure a session is running and the file is writable"));
+			
+		});
+		
+		panel->Release();
+	}
+	
+	void Workspace::StopCapture()
+	{
+		_worldAttachment->StopCapture();
+	}
+	
+	void Workspace::ReplayCapture()
+	{
+		RN::OpenPanel *panel = new RN::OpenPanel();
+		panel->SetTitle("Replay Capture");
+		
+		panel->Show([&](bool result, const std::vector<std::string> &paths) {
+			
+			if(!result)
+				return;
+			
+			if(!_worldAttachment->ReplayCapture(paths.front()))
+			{
+				InfoPanel::WithMessage(RNCSTR("Couldn't replay the capture, only captures of a server can be replayed"));
+				return;
+			}
+			
+			ShowNetworkStatistics();
+			
+		});
+		
+		panel->Release();
+	}
+	
+	void Workspace::RunLoadTest()
+	{
+		// The clients connect over loopback to a server hosted by this workspace
+		if(!_worldAttachment->StartLoadTest(LoadGenerator::GetConfigurationFromSettings()))
+			InfoPanel::WithMessage(RNCSTR("A load test is already running"));
+	}
+	
 	// -----------------------
 	// MARK: -
 	// MARK: Selection
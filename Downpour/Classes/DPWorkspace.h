@@ -83,6 +83,13 @@ namespace DP
 		void HostSession();
 		void ConnectToSession();
 		void DisconnectFromSession();
+		void ShowNetworkStatistics();
+		
+		void StartCapture();
+		void StopCapture();
+		void ReplayCapture();
+		
+		void RunLoadTest();
 		
 	private:
 		void SanitizeAndPostSelection();
@@ -95,6 +102,7 @@ namespace DP
 		
 		void KeyDown(RN::Event *event) override;
 		void DuplicateSelection();
+		void SaveLevel(const std::string &path);
 		
 		SavedState *_state;
 		WorldAttachment *_worldAttachment;
@@ -118,6 +126,7 @@ namespace DP
 		RN::Array *_pasteBoard;
 		
 		RN::Module *_module;
+		std::string _levelPath;
 		
 		RNDeclareSingleton(Workspace)
 	};
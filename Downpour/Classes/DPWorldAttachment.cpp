@@ -24,30 +24,92 @@ namespace DP
 {
 	RNDefineSingleton(WorldAttachment)
 	
+	static size_t GetSizeSetting(RN::String *key, size_t defaultValue)
+	{
+		RN::Number *number = RN::Settings::GetSharedInstance()->GetObjectForKey<RN::Number>(key);
+		return number ? number->GetUint32Value() : defaultValue;
+	}
+	
+	static void EncodeHandles(RN::Serializer *serializer, const std::vector<NetworkHandle> &handles)
+	{
+		serializer->EncodeInt32(static_cast<int32>(handles.size()));
+		
+		for(NetworkHandle handle : handles)
+			serializer->EncodeInt64(handle);
+	}
+	
+	static std::vector<NetworkHandle> DecodeHandles(RN::Deserializer *deserializer)
+	{
+		std::vector<NetworkHandle> handles(static_cast<uint32>(deserializer->DecodeInt32()));
+		
+		for(NetworkHandle &handle : handles)
+			handle = deserializer->DecodeInt64();
+		
+		return handles;
+	}
+	
+	// A headless server runs without a workspace, so there is no selection to update
+	template<class T>
+	static void SelectInWorkspace(T selection)
+	{
+		Workspace *workspace = Workspace::GetSharedInstance();
+		if(workspace)
+			workspace->SetSelection(selection);
+	}
+	
+	static size_t CountSceneNodes(RN::SceneNode *node)
+	{
+		size_t count = 1;
+		
+		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *child, size_t i, bool &stop) {
+			count += CountSceneNodes(child);
+		});
+		
+		return count;
+	}
+	
+	bool WorldAttachment::IsEditorSceneNode(RN::SceneNode *node)
+	{
+		if(node->GetFlags() & RN::SceneNode::Flags::NoSave)
+			return true;
+		
+		return (node->IsKindOfClass(RN::Camera::GetMetaClass()) || node->IsKindOfClass(Gizmo::GetMetaClass()) ||
+				node->IsKindOfClass(EditorIcon::GetMetaClass()) || node->IsKindOfClass(SculptTool::GetMetaClass()));
+	}
+	
 	WorldAttachment::WorldAttachment() :
 		_sceneNodes(nullptr),
 		_camera(nullptr),
-		_host(nullptr),
-		_peer(nullptr),
+		_network(nullptr),
+		_serverPeer(0),
+		_hostID(0),
+		_clientCount(0),
 		_isConnected(false),
 		_isServer(false),
 		_isRemoteChange(false),
 		_isLoadingWorld(false),
-		_hostID(0),
-		_clientCount(0)
+		_isContinuousEdit(false),
+		_isAwaitingWorld(false),
+		_editCounter(0),
+		_provisionalCounter(0),
+		_handleBlockSize(kDPHandleBlockDefaultSize),
+		_isAwaitingHandles(false),
+		_stateHashInterval(kDPStateHashDefaultInterval),
+		_stateHashTimer(0.0f),
+		_workerPool(nullptr),
+		_catchUpTimer(0.0f),
+		_peerBudget(kDPPeerDefaultBudget),
+		_interestRadius(kDPInterestDefaultRadius),
+		_isInterestDirty(true),
+		_loadGenerator(nullptr),
+		_snapshotProgress(nullptr),
+		_levelManager(this, _lock)
 	{
 		_lightClass  = RN::Light::GetMetaClass();
 		_cameraClass = RN::Camera::GetMetaClass();
 		
 		RN::LockGuard<decltype(_lock)> lock(_lock);
 		RN_ASSERT(enet_initialize() == 0, "Enet could not be initialized!");
-		
-		RN::Timer::ScheduledTimerWithDuration(std::chrono::milliseconds(5), [&]() {
-			if(!_isConnected)
-				return;
-			
-			_isServer ? StepServer() : StepClient();
-		}, true);
 	}
 	
 	WorldAttachment::~WorldAttachment()
@@ -69,10 +131,41 @@ namespace DP
 			
 			RN::SafeRelease(_sceneNodes);
 			_sceneNodes = RN::SafeRetain(static_cast<RN::Array *>(message->GetObject()));
+			_isInterestDirty = true;
 			
 		}, this);
 	}
 	
+	void WorldAttachment::StepWorld(float delta)
+	{
+		_levelManager.Step(delta);
+		
+		// Everything the I/O thread received since the last frame is applied here in one go
+		if(!_network)
+			return;
+		
+		_catchUpTimer += delta;
+		
+		if(!_isServer)
+		{
+			ExpireProvisionalOperations(delta);
+			CompareStateHash(delta);
+		}
+		
+		{
+			NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Step);
+			_isServer ? StepServer() : StepClient();
+		}
+		
+		_capture.RecordStep(delta);
+		
+		if(_statistics.Step(delta, _network))
+			RN::MessageCenter::GetSharedInstance()->PostMessage(kDPNetworkStatisticsDidSampleMessage, nullptr, nullptr);
+		
+		if(_loadGenerator && _loadGenerator->IsFinished())
+			FinishLoadTest();
+	}
+	
 	void WorldAttachment::DidBeginCamera(RN::Camera *camera)
 	{
 		if(!_camera)
@@ -106,82 +199,305 @@ namespace DP
 	
 	void WorldAttachment::DidAddSceneNode(RN::SceneNode *node)
 	{
+		_levelManager.DidAddSceneNode(node);
+		
 		RN::MessageCenter::GetSharedInstance()->PostMessage(kDPWorldAttachmentDidAddSceneNode, node, nullptr);
 	}
 	void WorldAttachment::WillRemoveSceneNode(RN::SceneNode *node)
 	{
+		_levelManager.WillRemoveSceneNode(node);
+		
 		RN::MessageCenter::GetSharedInstance()->PostMessage(kDPWorldAttachmentWillRemoveSceneNode, node, nullptr);
 	}
 	
 	void WorldAttachment::SceneNodeDidUpdate(RN::SceneNode *node, RN::SceneNode::ChangeSet changeSet)
 	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		// Whatever changed, the state hash of the node is recomputed the next time it is compared
+		NetworkHandle handle = GetNetworkHandle(node);
+		if(handle)
+			_dirtyStateHashes.insert(handle);
+		
+		_levelManager.SceneNodeDidUpdate(node, changeSet);
+		
 		if(!(changeSet & RN::SceneNode::ChangeSet::Position))
 			return;
 		
-		RN::LockGuard<decltype(_lock)> lock(_lock);
+		if(IsEditorSceneNode(node))
+			return;
 		
 		if(!_isConnected || _isLoadingWorld || _isRemoteChange)
 			return;
 		
-		if(node->GetFlags() & RN::SceneNode::Flags::NoSave)
+		if(!handle)
 			return;
 		
-		if(node->IsKindOfClass(RN::Camera::GetMetaClass()))
-			return;
+		// Only the latest transform per node is kept, everything gets flushed as one batch with the next network step.
+		// Intermediate transforms of a continuous edit go over the unreliable channel until the edit is committed
+		if(_isContinuousEdit)
+		{
+			_continuousEditNodes.insert(handle);
+			QueueTransform(node, handle, _hostID, _editCounter, false);
+		}
+		else
+		{
+			QueueTransform(node, handle, _hostID, ++ _editCounter, true);
+		}
+	}
+	
+	void WorldAttachment::BeginContinuousEdit()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		_isContinuousEdit = true;
+		_editCounter ++;
+	}
+	
+	void WorldAttachment::EndContinuousEdit()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
 		
-		if(node->IsKindOfClass(DP::Gizmo::GetMetaClass()))
+		if(!_isContinuousEdit)
 			return;
 		
-		if(node->IsKindOfClass(DP::EditorIcon::GetMetaClass()))
+		_isContinuousEdit = false;
+		
+		// Commit the final state of every touched node reliably, receivers drop all
+		// unreliable transforms of this edit that arrive after the commit
+		for(NetworkHandle handle : _continuousEditNodes)
+		{
+			RN::SceneNode *node = _networkNodes.Get(handle);
+			if(node)
+				QueueTransform(node, handle, _hostID, _editCounter, true);
+		}
+		
+		_continuousEditNodes.clear();
+	}
+	
+	static TransformRequest MakeTransform(RN::SceneNode *node, NetworkHandle handle, uint32 hostID, uint32 edit)
+	{
+		TransformRequest request;
+		request.hostID   = hostID;
+		request.edit     = edit;
+		request.handle   = handle;
+		request.changes  = TransformRequest::Changes::All;
+		request.position = node->GetPosition();
+		request.scale    = node->GetScale();
+		request.rotation = node->GetRotation();
+		
+		return request;
+	}
+	
+	static TransformRequest &StoreTransform(std::unordered_map<NetworkHandle, TransformRequest> &pending, RN::SceneNode *node, NetworkHandle handle, uint32 hostID, uint32 edit)
+	{
+		TransformRequest &request = pending[handle];
+		request = MakeTransform(node, handle, hostID, edit);
+		
+		return request;
+	}
+	
+	void WorldAttachment::QueueTransform(RN::SceneNode *node, NetworkHandle handle, uint32 hostID, uint32 edit, bool reliable)
+	{
+		if(!reliable)
+		{
+			StoreTransform(_pendingUnreliableTransforms, node, handle, hostID, edit);
 			return;
+		}
+		
+		_pendingUnreliableTransforms.erase(handle);
+		TransformRequest &request = StoreTransform(_pendingTransforms, node, handle, hostID, edit);
+		
+		// The server is authoritative, its own changes are always accepted
+		if(_isServer && hostID == _hostID)
+			_operationLog.AcceptTransform(request, _operationLog.GetNextSequence());
+	}
+	
+	void WorldAttachment::QueueCorrection(RN::SceneNode *node, NetworkHandle handle, uint32 hostID, uint32 edit)
+	{
+		_pendingUnreliableTransforms.erase(handle);
+		StoreTransform(_pendingCorrections, node, handle, hostID, edit);
+	}
+	
+	void WorldAttachment::FlushTransforms()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
 		
-		if(_sceneNodeLookup.count(node->GetLID()) == 0)
+		FlushTransforms(_pendingTransforms, true, 0);
+		FlushTransforms(_pendingCorrections, true, Operation::Flags::Correction);
+		FlushTransforms(_pendingUnreliableTransforms, false, 0);
+	}
+	
+	void WorldAttachment::FlushTransforms(std::unordered_map<NetworkHandle, TransformRequest> &pending, bool reliable, uint8 flags)
+	{
+		if(pending.empty())
 			return;
 		
+		NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, _isServer ? Packet::Type::AnswerTransform : Packet::Type::RequestTransform);
+		
+		std::vector<TransformRequest> batch;
+		batch.reserve(pending.size());
+		
+		for(auto &pair : pending)
+			batch.push_back(pair.second);
+		
+		pending.clear();
+		
+		uint16 packetFlags = reliable ? Packet::Flags::Reliable : 0;
+		
 		if(_isServer)
 		{
-			TransformRequest request;
-			request.hostID   = _hostID;
-			request.lid      = node->GetLID();
-			request.position = node->GetPosition();
-			request.scale    = node->GetScale();
-			request.rotation = node->GetRotation();
+			// A reliable batch is a single operation, previews don't get a sequence
+			uint64 sequence = 0;
+			
+			if(reliable)
+			{
+				sequence = _operationLog.BeginOperation();
+				
+				for(const TransformRequest &request : batch)
+				{
+					_operationLog.Record(sequence, Operation::Type::Transform, request.hostID, request.handle);
+					_snapshotCache.RecordTransform(request.handle);
+				}
+			}
+			
+			for(const TransformRequest &request : batch)
+			{
+				RN::SceneNode *node = _networkNodes.Get(request.handle);
+				if(node)
+					_interestManager.UpdateNode(request.handle, node->GetWorldPosition());
+			}
+			
+			// Every peer gets only the nodes it is interested in, encoded against its own baselines since
+			// the peers don't all receive the same transforms anymore. Committed changes that got filtered
+			// out are caught up later, previews are simply dropped.
+			struct PeerBatch
+			{
+				uint32 peer;
+				TransformCodec *codec;
+				WireWriter writer;
+				std::vector<NetworkHandle> stale;
+				bool empty;
+			};
+			
+			std::vector<PeerBatch> peers(_peerTransformCodecs.size());
+			size_t index = 0;
+			
+			for(auto &pair : _peerTransformCodecs)
+			{
+				peers[index].peer = pair.first;
+				peers[index].codec = &pair.second;
+				index ++;
+			}
+			
+			// Filtering and encoding only touch the peers own codec and read the interest manager,
+			// so large sessions spread it over the worker pool. Packets are created back on this thread.
+			auto encode = [&](size_t i) {
+				
+				PeerBatch &peer = peers[i];
+				
+				std::vector<TransformRequest> filtered;
+				filtered.reserve(batch.size());
+				
+				for(const TransformRequest &request : batch)
+				{
+					if(_interestManager.IsInterested(peer.peer, request.handle, request.hostID))
+					{
+						filtered.push_back(request);
+					}
+					else if(reliable)
+					{
+						peer.stale.push_back(request.handle);
+					}
+				}
+				
+				peer.empty = filtered.empty();
+				if(peer.empty)
+					return;
+				
+				peer.writer.WriteVarUInt(sequence);
+				peer.writer.WriteUInt8(flags);
+				
+				peer.codec->Encode(peer.writer, filtered, reliable);
+			};
 			
-			BroadcastPacket(Packet::WithTypeAndData(Packet::Type::AnswerTransform, &request, sizeof(TransformRequest)));
+			if(_workerPool && peers.size() >= kDPParallelFanOutThreshold)
+			{
+				_workerPool->Apply(peers.size(), encode);
+			}
+			else
+			{
+				for(size_t i = 0; i < peers.size(); i ++)
+					encode(i);
+			}
+			
+			for(PeerBatch &peer : peers)
+			{
+				for(NetworkHandle handle : peer.stale)
+					_interestManager.MarkStale(peer.peer, handle);
+				
+				if(!peer.empty)
+					SendPacketToPeer(peer.peer, Packet::WithTypeAndData(Packet::Type::AnswerTransform, peer.writer.GetBytes(), peer.writer.GetLength(), packetFlags));
+			}
 		}
 		else
 		{
-			TransformRequest request;
-			request.hostID   = _hostID;
-			request.lid      = node->GetLID();
-			request.position = node->GetPosition();
-			request.scale    = node->GetScale();
-			request.rotation = node->GetRotation();
+			WireWriter writer;
 			
-			SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestTransform, &request, sizeof(TransformRequest)));
+			// The server checks for conflicts against the last operation we applied
+			writer.WriteVarUInt(_operationSequencer.GetSequence());
+			
+			if(reliable)
+			{
+				for(const TransformRequest &request : batch)
+					_operationSequencer.BeginLocalTransform(request);
+			}
+			
+			// Unreliable batches may get lost, so they must not advance the codecs baselines
+			_transformCodec.Encode(writer, batch, reliable);
+			
+			SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestTransform, writer.GetBytes(), writer.GetLength(), packetFlags));
 		}
 	}
 	
-	void WorldAttachment::ApplyTransforms(const TransformRequest &request)
+	bool WorldAttachment::ApplyTransforms(const TransformRequest &request, bool reliable)
 	{
 		RN::LockGuard<decltype(_lock)> lock(_lock);
 		
-		if(request.hostID == _hostID)
-			return;
-		
-		RN_ASSERT(_sceneNodeLookup.count(request.lid) > 0, "A transform for a not existing ID has been received!");
+		RN::SceneNode *node = _networkNodes.Get(request.handle);
+		if(!node)
+			return false;
 		
-		RN::SceneNode *node = _sceneNodeLookup[request.lid];
-		if(node)
+		// Unreliable transforms can overtake the reliable commit of their edit, those are stale and dropped
+		if(request.edit > 0)
 		{
-			_isRemoteChange = true;
+			uint32 &committed = _committedEdits[request.hostID];
 			
+			if(!reliable && request.edit <= committed)
+				return false;
+			
+			if(reliable)
+				committed = std::max(committed, request.edit);
+		}
+		
+		_isRemoteChange = true;
+		
+		if(request.changes & TransformRequest::Changes::Position)
 			node->SetPosition(request.position);
+		
+		if(request.changes & TransformRequest::Changes::Scale)
 			node->SetScale(request.scale);
+		
+		if(request.changes & TransformRequest::Changes::Rotation)
 			node->SetRotation(request.rotation);
-			
-			_isRemoteChange = false;
-		}
+		
+		_isRemoteChange = false;
+		
+		// Our own baseline no longer describes the node, a later change back to it would otherwise be skipped
+		if(request.changes)
+			_transformCodec.Forget(request.handle);
+		
+		return true;
 	}
 	
 	void WorldAttachment::RequestSceneNodePropertyChange(RN::SceneNode *node, const std::string &name, RN::Object *object, uint32 hostID)
@@ -200,17 +516,18 @@ namespace DP
 		if(hostID == -1)
 			hostID = _hostID;
 		
+		NetworkHandle handle = GetNetworkHandle(node);
+		
 		if(_isServer || !_isConnected)
 		{
-			RN::FlatSerializer *serializer = new RN::FlatSerializer();
-			serializer->EncodeInt32(hostID);
-			serializer->EncodeInt64(node->GetLID());
-			serializer->EncodeString(name);
-			serializer->EncodeObject(object);
-			
-			BroadcastPacket(Packet::WithTypeAndSerializer(Packet::Type::AnswerSceneNodeProperty, serializer));
+			if(_isServer && handle)
+			{
+				// The server is authoritative, its own changes are always accepted
+				_operationLog.AcceptProperty(hostID, _operationLog.GetNextSequence(), handle, name);
+				BroadcastSceneNodeProperty(node, handle, name, object, hostID, 0, 0);
+			}
 			
-			serializer->Release();
+			_levelManager.JournalSceneNodeProperty(node, name, object);
 			
 			if(hostID != _hostID)
 			{
@@ -218,21 +535,84 @@ namespace DP
 				node->SetValueForKey(object, name);
 			}
 		}
-		else
+		else if(handle)
 		{
-			RN::FlatSerializer *serializer = new RN::FlatSerializer();
-			serializer->EncodeInt32(hostID);
-			serializer->EncodeInt64(node->GetLID());
-			serializer->EncodeString(name);
-			serializer->EncodeObject(object);
+			uint32 edit = ++ _editCounter;
+			_operationSequencer.BeginLocalChange(handle, name, edit);
 			
-			SendPacketToServer(Packet::WithTypeAndSerializer(Packet::Type::RequestSceneNodeProperty, serializer));
+			NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::RequestSceneNodeProperty);
 			
-			serializer->Release();
+			WireWriter writer;
+			writer.WriteVarUInt(_operationSequencer.GetSequence());
+			writer.WriteVarUInt(hostID);
+			writer.WriteVarUInt(edit);
+			writer.WriteVarUInt(handle);
+			_stringTable.Encode(writer, name);
+			writer.WriteObject(object);
+			
+			SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestSceneNodeProperty, writer.GetBytes(), writer.GetLength()));
+		}
+	}
+	
+	void WorldAttachment::BroadcastSceneNodeProperty(RN::SceneNode *node, NetworkHandle handle, const std::string &name, RN::Object *object, uint32 hostID, uint32 edit, uint8 flags)
+	{
+		NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnswerSceneNodeProperty);
+		
+		HashSceneNodeProperty(handle, name, object);
+		_snapshotCache.RecordProperty(handle, name);
+		
+		WireWriter writer;
+		writer.WriteVarUInt(_operationLog.Append(Operation::Type::Property, hostID, handle));
+		writer.WriteUInt8(flags);
+		writer.WriteVarUInt(hostID);
+		writer.WriteVarUInt(edit);
+		writer.WriteVarUInt(handle);
+		_stringTable.Encode(writer, name);
+		writer.WriteObject(object);
+		
+		FlushStringDefinitions();
+		
+		std::vector<uint32> peers;
+		
+		for(uint32 peer : _interestManager.GetPeers())
+		{
+			if(_interestManager.IsInterested(peer, handle, hostID))
+			{
+				peers.push_back(peer);
+			}
+			else
+			{
+				_interestManager.MarkStale(peer, handle, name);
+			}
 		}
+		
+		SendPacketToPeers(peers, Packet::WithTypeAndData(Packet::Type::AnswerSceneNodeProperty, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	void WorldAttachment::FlushStringDefinitions()
+	{
+		// Definitions are broadcast ahead of the first packet that uses them, so every peer knows them in time
+		if(!_stringTable.HasPendingDefinitions())
+			return;
+		
+		WireWriter writer;
+		_stringTable.WriteDefinitions(writer, false);
+		
+		BroadcastPacket(Packet::WithTypeAndData(Packet::Type::AnswerStringTable, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	void WorldAttachment::BroadcastSceneNodeDeletion(std::vector<NetworkHandle> handles)
+	{
+		uint64 sequence = _operationLog.BeginOperation();
+		
+		for(NetworkHandle handle : handles)
+			_operationLog.Record(sequence, Operation::Type::Delete, _hostID, handle);
+		
+		handles.push_back(sequence);
+		BroadcastPacket(Packet::WithTypeAndData(Packet::Type::AnswerDeleteSceneNode, handles.data(), handles.size() * sizeof(uint64)));
 	}
 	
-	void WorldAttachment::RequestSceneNode(RN::Object *object, const RN::Vector3 &position, uint32 hostID)
+	bool WorldAttachment::RequestSceneNode(RN::Object *object, const RN::Vector3 &position, uint32 hostID, uint32 provisional)
 	{
 		if(hostID == -1)
 			hostID = _hostID;
@@ -240,26 +620,60 @@ namespace DP
 		if(_isServer || !_isConnected)
 		{
 			RN::SceneNode *node = CreateSceneNode(object, position);
+			if(!node)
+				return false;
+			
+			std::vector<NetworkHandle> handles = RegisterSceneNodes(node);
+			
+			NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnswerSceneNode);
+			
+			RN::FlatSerializer *serializer = new RN::FlatSerializer();
+			serializer->EncodeInt64(_operationLog.Append(Operation::Type::Create, hostID, handles.front()));
+			serializer->EncodeInt32(hostID);
+			serializer->EncodeInt32(provisional);
+			serializer->EncodeObject(node);
+			EncodeHandles(serializer, handles);
+			
+			BroadcastPacket(Packet::WithTypeAndSerializer(Packet::Type::AnswerSceneNode, serializer));
+			
+			serializer->Release();
+			
+			if(hostID == _hostID)
+			{
+				SelectInWorkspace(node);
+			}
+			
+			return true;
+		}
+		else
+		{
+			RN::SceneNode *node = CreateSceneNode(object, position);
+			
 			if(node)
 			{
-				RegisterSceneNodeRecursive(node);
-				
-				RN::FlatSerializer *serializer = new RN::FlatSerializer();
-				serializer->EncodeInt32(hostID);
-				serializer->EncodeObject(node);
+				// With enough granted handles the node is final right away and the server is only told about it
+				std::vector<NetworkHandle> handles;
 				
-				BroadcastPacket(Packet::WithTypeAndSerializer(Packet::Type::AnswerSceneNode, serializer));
-				
-				serializer->Release();
-				
-				if(hostID == _hostID)
+				if(TakeHandles(CountSceneNodes(node), handles))
 				{
-					Workspace::GetSharedInstance()->SetSelection(node);
+					RN::Array *nodes = new RN::Array();
+					nodes->AddObject(node);
+					
+					size_t index = 0;
+					RegisterSceneNodes(node, handles, index);
+					AnnounceSceneNodes(nodes, handles);
+					
+					nodes->Release();
+					
+					SelectInWorkspace(node);
+					return true;
 				}
+				
+				// Otherwise the node shows up under a provisional ID, the servers answer replaces it
+				provisional = BeginProvisionalOperation({ node });
+				SelectInWorkspace(node);
 			}
-		}
-		else
-		{
+			
 			if(object->IsKindOfClass(RN::Value::GetMetaClass()))
 			{
 				RN::Value *value = static_cast<RN::Value *>(object);
@@ -271,18 +685,33 @@ namespace DP
 				}
 				catch(RN::Exception e)
 				{
-					return;
+					ResolveProvisionalOperation(provisional, {});
+					return false;
 				}
 			}
 			
-			RN::FlatSerializer *serializer = new RN::FlatSerializer();
-			serializer->EncodeInt32(hostID);
-			serializer->EncodeObject(object);
-			serializer->EncodeVector3(position);
+			WireWriter writer;
+			writer.WriteVarUInt(hostID);
+			
+			// Class names are interned, anything else is sent as the object itself
+			if(object->IsKindOfClass(RN::String::GetMetaClass()))
+			{
+				writer.WriteUInt8(1);
+				_stringTable.Encode(writer, static_cast<RN::String *>(object)->GetUTF8String());
+			}
+			else
+			{
+				writer.WriteUInt8(0);
+				writer.WriteObject(object);
+			}
 			
-			SendPacketToServer(Packet::WithTypeAndSerializer(Packet::Type::RequestSceneNode, serializer));
+			writer.WriteFloat(position.x);
+			writer.WriteFloat(position.y);
+			writer.WriteFloat(position.z);
+			writer.WriteVarUInt(provisional);
 			
-			serializer->Release();
+			SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestSceneNode, writer.GetBytes(), writer.GetLength()));
+			return true;
 		}
 	}
 	
@@ -346,75 +775,135 @@ namespace DP
 		return nullptr;
 	}
 	
-	void WorldAttachment::DuplicateSceneNodes(RN::Array *sceneNodes, uint32 hostID)
+	RN::Array *WorldAttachment::CopySceneNodes(RN::Array *sceneNodes)
 	{
-		if(hostID == -1)
-			hostID = _hostID;
+		RN::Array *duplicates = new RN::Array();
 		
-		if(!_isConnected || _isServer)
-		{
-			RN::Array *duplicates = new RN::Array();
-			RN::Serializer *serializer = new RN::FlatSerializer();
+		sceneNodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
 			
-			sceneNodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
+			RN::MetaClass *meta = node->GetClass();
+			bool noDirectCopy = false;
+			
+			// Find the first class that supports copying to avoid trying to make a copy
+			// of something that doesn't support copying in the first place
+			while(!meta->SupportsCopying())
+			{
+				noDirectCopy = true;
+				meta = meta->GetSuperClass();
+			}
+			
+			try
+			{
+				RN::SceneNode *copy = static_cast<RN::SceneNode *>(meta->ConstructWithCopy(node));
+				duplicates->AddObject(copy);
 				
-				RN::MetaClass *meta = node->GetClass();
-				bool noDirectCopy = false;
+				if(noDirectCopy)
+					RNDebug("Can't copy %s, copying %s instead (make sure to implement the Copyable meta class trait!", node->GetClass()->GetName().c_str(), meta->GetName().c_str());
+			}
+			catch(RN::Exception e)
+			{} // Meh...
+		});
+		
+		RN::World::GetActiveWorld()->ApplyNodes();
+		return duplicates->Autorelease();
+	}
+	
+	void WorldAttachment::DuplicateSceneNodes(RN::Array *sceneNodes, uint32 hostID, uint32 provisional)
+	{
+		if(hostID == -1)
+			hostID = _hostID;
+		
+		if(!_isConnected || _isServer)
+		{
+			RN::Array *duplicates = CopySceneNodes(sceneNodes);
+			
+			std::vector<NetworkHandle> roots;
+			std::vector<NetworkHandle> handles;
+			
+			duplicates->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
 				
-				// Find the first class that supports copying to avoid trying to make a copy
-				// of something that doesn't support copying in the first place
-				while(!meta->SupportsCopying())
-				{
-					noDirectCopy = true;
-					meta = meta->GetSuperClass();
-				}
+				std::vector<NetworkHandle> subtree = RegisterSceneNodes(node);
+				
+				roots.push_back(subtree.front());
+				handles.insert(handles.end(), subtree.begin(), subtree.end());
 				
-				try
-				{
-					RN::SceneNode *copy = static_cast<RN::SceneNode *>(meta->ConstructWithCopy(node));
-					RegisterSceneNodeRecursive(copy);
-					duplicates->AddObject(copy);
-					
-					if(noDirectCopy)
-						RNDebug("Can't copy %s, copying %s instead (make sure to implement the Copyable meta class trait!", node->GetClass()->GetName().c_str(), meta->GetName().c_str());
-				}
-				catch(RN::Exception e)
-				{} // Meh...
 			});
 			
 			if(_isServer)
 			{
+				NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnswerDuplicateSceneNode);
+				
+				uint64 sequence = _operationLog.BeginOperation();
+				
+				for(NetworkHandle handle : roots)
+					_operationLog.Record(sequence, Operation::Type::Duplicate, hostID, handle);
+				
+				RN::Serializer *serializer = new RN::FlatSerializer();
+				serializer->EncodeInt64(sequence);
 				serializer->EncodeInt32(hostID);
+				serializer->EncodeInt32(provisional);
 				serializer->EncodeObject(duplicates);
+				EncodeHandles(serializer, handles);
 				BroadcastPacket(Packet::WithTypeAndSerializer(Packet::Type::AnswerDuplicateSceneNode, serializer));
+				serializer->Release();
 			}
 			
-			RN::World::GetActiveWorld()->ApplyNodes();
 			if(hostID == _hostID)
 			{
-				Workspace::GetSharedInstance()->SetSelection(duplicates);
+				SelectInWorkspace(duplicates);
 			}
-			duplicates->Release();
-			serializer->Release();
 		}
 		else
 		{
-			std::vector<uint64> ids;
+			std::vector<NetworkHandle> ids;
+			RN::Array *sources = new RN::Array();
 			
 			sceneNodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
 				
-				if(_sceneNodeLookup.count(node->GetLID()))
+				NetworkHandle handle = GetNetworkHandle(node);
+				if(handle)
 				{
-					ids.push_back(node->GetLID());
+					ids.push_back(handle);
+					sources->AddObject(node);
 				}
 				
 			});
 			
 			if(!ids.empty())
 			{
-				ids.push_back(hostID);
-				BroadcastPacket(Packet::WithTypeAndData(Packet::Type::RequestDuplicateSceneNode, ids.data(), ids.size() * sizeof(uint64)));
+				RN::Array *duplicates = CopySceneNodes(sources);
+				std::vector<RN::SceneNode *> nodes;
+				size_t count = 0;
+				
+				duplicates->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
+					nodes.push_back(node);
+					count += CountSceneNodes(node);
+				});
+				
+				std::vector<NetworkHandle> handles;
+				
+				if(TakeHandles(count, handles))
+				{
+					size_t index = 0;
+					
+					for(RN::SceneNode *node : nodes)
+						RegisterSceneNodes(node, handles, index);
+					
+					AnnounceSceneNodes(duplicates, handles);
+				}
+				else
+				{
+					// The copies are shown right away and replaced by the servers duplicates once they arrive,
+					// which come in the same order as long as the server could copy every node
+					ids.push_back(BeginProvisionalOperation(nodes));
+					ids.push_back(hostID);
+					BroadcastPacket(Packet::WithTypeAndData(Packet::Type::RequestDuplicateSceneNode, ids.data(), ids.size() * sizeof(uint64)));
+				}
+				
+				SelectInWorkspace(duplicates);
 			}
+			
+			sources->Release();
 		}
 	}
 	
@@ -422,16 +911,19 @@ namespace DP
 	{
 		if(!_isConnected || _isServer)
 		{
-			std::vector<uint64> ids;
+			std::vector<NetworkHandle> ids;
 			
 			sceneNodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
 				
-				if(_sceneNodeLookup.count(node->GetLID()))
+				NetworkHandle handle = GetNetworkHandle(node);
+				if(handle)
 				{
-					UnregisterSceneNodeRecursive(node);
-					ids.push_back(node->GetLID());
+					ids.push_back(handle);
+					UnregisterSceneNodes(node);
 				}
 				
+				_levelManager.JournalSceneNodeDeletion(node);
+				
 				if(node->GetParent())
 					node->RemoveFromParent();
 				
@@ -439,17 +931,18 @@ namespace DP
 			});
 			
 			if(_isServer && !ids.empty())
-				BroadcastPacket(Packet::WithTypeAndData(Packet::Type::AnswerDeleteSceneNode, ids.data(), ids.size() * sizeof(uint64)));
+				BroadcastSceneNodeDeletion(ids);
 		}
 		else
 		{
-			std::vector<uint64> ids;
+			std::vector<NetworkHandle> ids;
 			
 			sceneNodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
 				
-				if(_sceneNodeLookup.count(node->GetLID()))
+				NetworkHandle handle = GetNetworkHandle(node);
+				if(handle)
 				{
-					ids.push_back(node->GetLID());
+					ids.push_back(handle);
 				}
 				
 			});
@@ -459,470 +952,2219 @@ namespace DP
 		}
 	}
 	
-	void WorldAttachment::HandleSceneNodeDeletion(const std::vector<uint64> &ids)
+	uint32 WorldAttachment::BeginProvisionalOperation(const std::vector<RN::SceneNode *> &nodes)
+	{
+		uint32 provisional = ++ _provisionalCounter;
+		
+		ProvisionalOperation &operation = _provisionalOperations[provisional];
+		operation.age = 0.0f;
+		
+		for(RN::SceneNode *node : nodes)
+		{
+			ProvisionalNode entry;
+			entry.node = node->Retain();
+			entry.position = node->GetPosition();
+			entry.rotation = node->GetRotation();
+			entry.scale = node->GetScale();
+			
+			operation.nodes.push_back(entry);
+		}
+		
+		return provisional;
+	}
+	
+	void WorldAttachment::ResolveProvisionalOperation(uint32 provisional, const std::vector<RN::SceneNode *> &nodes)
 	{
-		for(uint64 id : ids)
+		auto iterator = _provisionalOperations.find(provisional);
+		if(iterator == _provisionalOperations.end())
+			return;
+		
+		std::vector<ProvisionalNode> provisionalNodes = std::move(iterator->second.nodes);
+		_provisionalOperations.erase(iterator);
+		
+		// Without a one to one match the confirmed nodes simply replace the provisional ones, otherwise
+		// anything the user did to a provisional node in the meantime is carried over as a regular edit
+		bool remap = (provisionalNodes.size() == nodes.size());
+		
+		for(size_t i = 0; i < provisionalNodes.size(); i ++)
 		{
-			auto iterator = _sceneNodeLookup.find(id);
-			if(iterator != _sceneNodeLookup.end())
+			ProvisionalNode &entry = provisionalNodes[i];
+			RN::SceneNode *node = entry.node;
+			
+			if(remap && (node->GetPosition() != entry.position || node->GetRotation() != entry.rotation || node->GetScale() != entry.scale))
 			{
-				RN::SceneNode *node = iterator->second;
-				UnregisterSceneNodeRecursive(node);
+				RN::SceneNode *confirmed = nodes[i];
 				
-				if(node->GetParent())
-					node->RemoveFromParent();
+				_isRemoteChange = true;
+				confirmed->SetPosition(node->GetPosition());
+				confirmed->SetRotation(node->GetRotation());
+				confirmed->SetScale(node->GetScale());
+				_isRemoteChange = false;
 				
-				node->RemoveFromWorld();
+				QueueTransform(confirmed, GetNetworkHandle(confirmed), _hostID, ++ _editCounter, true);
 			}
+			
+			if(node->GetParent())
+				node->RemoveFromParent();
+			
+			node->RemoveFromWorld();
+			node->Release();
 		}
 	}
 	
-	void WorldAttachment::RegisterSceneNodeRecursive(RN::SceneNode *node)
-	{
-		RN::LockGuard<decltype(_lock)> lock(_lock);
-		_sceneNodeLookup[node->GetLID()] = node;
-		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *n, size_t i, bool &end){RegisterSceneNodeRecursive(n);});
-	}
-	
-	void WorldAttachment::UnregisterSceneNodeRecursive(RN::SceneNode *node)
+	void WorldAttachment::ExpireProvisionalOperations(float delta)
 	{
-		RN::LockGuard<decltype(_lock)> lock(_lock);
-		auto iterator = _sceneNodeLookup.find(node->GetLID());
-		if(iterator != _sceneNodeLookup.end())
+		std::vector<uint32> expired;
+		
+		for(auto &pair : _provisionalOperations)
 		{
-			_sceneNodeLookup.erase(iterator);
+			pair.second.age += delta;
+			
+			if(pair.second.age >= kDPProvisionalTimeout)
+				expired.push_back(pair.first);
 		}
 		
-		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *n, size_t i, bool &end){UnregisterSceneNodeRecursive(n);});
+		for(uint32 provisional : expired)
+		{
+			RNDebug("Rolling back provisional operation %u, the server never answered", provisional);
+			ResolveProvisionalOperation(provisional, {});
+		}
 	}
 	
+	void WorldAttachment::RollbackProvisionalOperations()
+	{
+		std::vector<uint32> provisionals;
+		
+		for(auto &pair : _provisionalOperations)
+			provisionals.push_back(pair.first);
+		
+		for(uint32 provisional : provisionals)
+			ResolveProvisionalOperation(provisional, {});
+	}
 	
-	void WorldAttachment::StepServer()
+	void WorldAttachment::HandleSceneNodeDeletion(const std::vector<NetworkHandle> &handles)
 	{
-		RN::LockGuard<decltype(_lock)> lock(_lock);
-		ENetEvent event;
-		while(enet_host_service(_host, &event, 1) > 0)
+		for(NetworkHandle handle : handles)
 		{
-			switch(event.type)
+			RN::SceneNode *node = _networkNodes.Get(handle);
+			if(node)
 			{
-				case ENET_EVENT_TYPE_CONNECT:
-				{
-					_clientCount++;
-					SendPacketToPeer(event.peer, Packet::WithTypeAndData(DP::Packet::Type::AnswerHostID, &_clientCount, sizeof(uint32)));
-					break;
-				}
+				UnregisterSceneNodes(node);
+				_levelManager.JournalSceneNodeDeletion(node);
 				
-				case ENET_EVENT_TYPE_RECEIVE:
-				{
-					Packet *packet;
-					
-					{
-						RN::Data *data = new RN::Data(event.packet->data, event.packet->dataLength);
-						RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(data->Autorelease());
-						
-						packet = static_cast<Packet *>(deserializer->DecodeObject());
-						deserializer->Release();
-						
-						enet_packet_destroy(event.packet);
-					}
-					
-					switch(packet->GetType())
-					{
-						case Packet::Type::RequestWorld:
-						{
-							RN::FlatSerializer *serializer = new RN::FlatSerializer();
-							RN::WorldCoordinator::GetSharedInstance()->SaveWorld(serializer);
-							
-							SendPacketToPeer(event.peer, Packet::WithTypeAndSerializer(Packet::Type::AnswerWorld, serializer));
-							serializer->Release();
-							
-							break;
-						}
-							
-						case Packet::Type::RequestSceneNode:
-						{
-							RN::Deserializer *deserializer = packet->GetDeserializer();
-							uint32 hostID = deserializer->DecodeInt32();
-							RN::Object *object   = deserializer->DecodeObject();
-							RN::Vector3 position = deserializer->DecodeVector3();
-							
-							RequestSceneNode(object, position, hostID);
-							break;
-						}
-						
-						case Packet::Type::RequestTransform:
-						{
-							TransformRequest request;
-							packet->GetData(&request);
-							
-							ApplyTransforms(request);
-							BroadcastPacket(Packet::WithTypeAndData(Packet::Type::AnswerTransform, &request, sizeof(TransformRequest)));
-							
-							break;
-						}
-							
-						case Packet::Type::RequestSceneNodeProperty:
-						{
-							RN::Deserializer *deserializer = packet->GetDeserializer();
-							uint32 hostID = deserializer->DecodeInt32();
-							uint64 lid = deserializer->DecodeInt64();
-							std::string name = deserializer->DecodeString();
-							RN::Object *object = deserializer->DecodeObject();
-							
-							if(_sceneNodeLookup.count(lid) > 0)
-							{
-								RequestSceneNodePropertyChange(_sceneNodeLookup[lid], name, object, hostID);
-							}
-							break;
-						}
-							
-						case Packet::Type::RequestDuplicateSceneNode:
-						{
-							size_t count = packet->GetLength() / sizeof(uint64);
-							std::vector<uint64> ids(count);
-							packet->GetData(ids.data());
-							
-							uint32 hostID = static_cast<uint32>(ids.back());
-							ids.pop_back();
-							
-							RN::Array *nodes = new RN::Array();
-							for(auto i : ids)
-							{
-								if(_sceneNodeLookup.count(i) > 0)
-									nodes->AddObject(_sceneNodeLookup[i]);
-							}
-							
-							DuplicateSceneNodes(nodes, hostID);
-							break;
-						}
-							
-						case Packet::Type::RequestDeleteSceneNode:
-						{
-							size_t count = packet->GetLength() / sizeof(uint64);
-							std::vector<uint64> ids(count);
-							
-							packet->GetData(ids.data());
-							HandleSceneNodeDeletion(ids);
-							
-							BroadcastPacket(Packet::WithTypeAndData(Packet::Type::AnswerDeleteSceneNode, ids.data(), ids.size() * sizeof(uint64)));
-							break;
-						}
-							
-						default:
-							break;
-					}
-					
-					break;
-				}
-					
-				case ENET_EVENT_TYPE_DISCONNECT:
-				{
-					break;
-				}
-					
-				default:
-					break;
+				if(node->GetParent())
+					node->RemoveFromParent();
+				
+				node->RemoveFromWorld();
 			}
 		}
 	}
 	
-	extern void ActivateDownpour();
-	extern void DeactivateDownpour();
-	
-	void WorldAttachment::StepClient()
+	void WorldAttachment::GrantHandleBlock(uint32 peer)
 	{
 		RN::LockGuard<decltype(_lock)> lock(_lock);
-		ENetEvent event;
 		
-		while(enet_host_service(_host, &event, 1) > 0)
-		{
-			switch(event.type)
-			{
-				case ENET_EVENT_TYPE_RECEIVE:
-				{
-					Packet *packet;
-					
-					{
-						RN::Data *data = new RN::Data(event.packet->data, event.packet->dataLength);
-						RN::FlatDeserializer *deserializer = new RN::FlatDeserializer(data->Autorelease());
-						
-						packet = static_cast<Packet *>(deserializer->DecodeObject());
-						deserializer->Release();
-						
-						enet_packet_destroy(event.packet);
-					}
-					
-					switch(packet->GetType())
-					{
-						case Packet::Type::AnswerHostID:
-						{
-							packet->GetData(&_hostID);
-							break;
-						}
-							
-						case Packet::Type::AnswerWorld:
-						{
-							RN::Deserializer *deserializer = packet->GetDeserializer()->Retain();
-							
-							RN::Kernel::GetSharedInstance()->ScheduleFunction([this, deserializer]() {
-								
-								{
-									RN::World::GetActiveWorld()->RemoveAttachment(this);
-									RN::AutoreleasePool pool;
-									DeactivateDownpour();
-								}
-								
-								RN::Kernel::GetSharedInstance()->ScheduleFunction([this, deserializer]() {
-									
-									RN::MessageCenter::GetSharedInstance()->AddObserver(kRNWorldCoordinatorDidFinishLoadingMessage, [this](RN::Message *message) {
-										
-										_sceneNodeLookup.clear();
-										
-										RN::Array *nodes = RN::World::GetActiveWorld()->GetSceneNodes();
-										nodes->Enumerate<RN::SceneNode>([](RN::SceneNode *node, size_t i, bool &stop ){
-											if(!node->IsKindOfClass(RN::Camera::GetMetaClass()))
-											{
-												WorldAttachment::GetSharedInstance()->_sceneNodeLookup[node->GetLID()] = node;
-											}
-										});
-										
-										RN::MessageCenter::GetSharedInstance()->RemoveObserver(this);
-										ActivateDownpour();
-										RN::World::GetActiveWorld()->Update(0.0f);
-										
-										_isLoadingWorld = false;
-										
-									}, this);
-									
-									RN::WorldCoordinator::GetSharedInstance()->LoadWorld(deserializer);
-									deserializer->Release();
-								});
-							});
-							
-							break;
-						}
-							
-						case Packet::Type::AnswerSceneNode:
-						{
-							RN::Deserializer *deserializer = packet->GetDeserializer();
-							uint32 hostID = deserializer->DecodeInt32();
-							RN::SceneNode *node = static_cast<RN::SceneNode *>(deserializer->DecodeObject());
-							
-							if(hostID == _hostID)
-							{
-								Workspace::GetSharedInstance()->SetSelection(node);
-							}
-							
-							RegisterSceneNodeRecursive(node);
-							break;
-						}
-							
-						case Packet::Type::AnswerTransform:
-						{
-							TransformRequest request;
-							packet->GetData(&request);
-							
-							ApplyTransforms(request);
-							break;
-						}
-							
-						case Packet::Type::AnswerSceneNodeProperty:
-						{
-							RN::Deserializer *deserializer = packet->GetDeserializer();
-							uint32 hostID = deserializer->DecodeInt32();
-							uint64 lid = deserializer->DecodeInt64();
-							std::string name = deserializer->DecodeString();
-							RN::Object *object = deserializer->DecodeObject();
-							
-							if(_sceneNodeLookup.count(lid) > 0 && hostID != _hostID)
-							{
-								_isRemoteChange = true;
-								_sceneNodeLookup[lid]->SetValueForKey(object, name);
-							}
-							break;
-						}
-							
-						case Packet::Type::AnswerDuplicateSceneNode:
-						{
-							RN::Deserializer *deserializer = packet->GetDeserializer();
-							uint32 hostID = deserializer->DecodeInt32();
-							RN::Array *nodes = static_cast<RN::Array *>(deserializer->DecodeObject());
-							
-							nodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &end){
-								RegisterSceneNodeRecursive(node);
-							});
-							
-							if(hostID == _hostID)
-							{
-								Workspace::GetSharedInstance()->SetSelection(nodes);
-							}
-							
-							break;
-						}
-							
-						case Packet::Type::AnswerDeleteSceneNode:
-						{
-							size_t count = packet->GetLength() / sizeof(uint64);
-							std::vector<uint64> ids(count);
-							
-							packet->GetData(ids.data());
-							HandleSceneNodeDeletion(ids);
-							break;
-						}
-							
-						default:
-							break;
-					}
-					
-					break;
-				}
-					
-				case ENET_EVENT_TYPE_DISCONNECT:
-				{
-					//_isConnected = false;
-					break;
-				}
-
-				default:
-					break;
-			}
-		}
+		// A client holds at most two blocks, asking for more than that gets it an empty one
+		std::unordered_set<NetworkHandle> &granted = _peerHandles[peer];
+		std::vector<NetworkHandle> handles;
+		
+		if(granted.size() < _handleBlockSize)
+			_networkNodes.Allocate(_handleBlockSize, handles);
+		
+		granted.insert(handles.begin(), handles.end());
+		
+		WireWriter writer;
+		writer.WriteVarUInt(handles.size());
+		
+		for(NetworkHandle handle : handles)
+			writer.WriteVarUInt(handle);
+		
+		SendPacketToPeer(peer, Packet::WithTypeAndData(Packet::Type::AnswerHandleBlock, writer.GetBytes(), writer.GetLength()));
 	}
-
 	
-	void WorldAttachment::CreateServer()
+	void WorldAttachment::ReleaseHandleBlock(uint32 peer)
 	{
 		RN::LockGuard<decltype(_lock)> lock(_lock);
-		DestroyHost();
-		
-		ENetAddress address;
-		address.host = ENET_HOST_ANY;
-		address.port = 2003;
 		
-		RN_ASSERT((_host = enet_host_create(&address, 32, 2, 0, 0)), "Enet couldn't create server");
+		auto iterator = _peerHandles.find(peer);
+		if(iterator == _peerHandles.end())
+			return;
 		
-		_isServer    = true;
-		_isConnected = true;
-		_hostID = 0;
-		_clientCount = 0;
+		for(NetworkHandle handle : iterator->second)
+			_networkNodes.Release(handle);
 		
-		RN::Array *nodes = RN::World::GetActiveWorld()->GetSceneNodes();
-		nodes->Enumerate<RN::SceneNode>([](RN::SceneNode *node, size_t i, bool &stop) {
-			if(!node->IsKindOfClass(RN::Camera::GetMetaClass()))
-			{
-				WorldAttachment::GetSharedInstance()->_sceneNodeLookup[node->GetLID()] = node;
-			}
-		});
+		_peerHandles.erase(iterator);
 	}
 	
-	void WorldAttachment::CreateClient()
+	void WorldAttachment::RequestHandleBlock()
 	{
-		RN::LockGuard<decltype(_lock)> lock(_lock);
-		DestroyHost();
+		if(_isAwaitingHandles)
+			return;
 		
-		RN_ASSERT((_host = enet_host_create(NULL, 1, 2, 0, 0)), "Enet couldn't create client!");
-		_isServer = false;
+		_isAwaitingHandles = true;
+		SendPacketToServer(Packet::WithType(Packet::Type::RequestHandleBlock));
 	}
 	
-	void WorldAttachment::DestroyHost()
+	bool WorldAttachment::TakeHandles(size_t count, std::vector<NetworkHandle> &handles)
 	{
-		RN::LockGuard<decltype(_lock)> lock(_lock);
-		Disconnect();
+		if(_handleBlock.size() < count)
+		{
+			RequestHandleBlock();
+			return false;
+		}
 		
-		if(_host)
-			enet_host_destroy(_host);
+		handles.assign(_handleBlock.begin(), _handleBlock.begin() + count);
+		_handleBlock.erase(_handleBlock.begin(), _handleBlock.begin() + count);
 		
-		_host = nullptr;
-		_peer = nullptr;
+		return true;
 	}
 	
-	void WorldAttachment::Connect(const std::string &ip)
+	void WorldAttachment::AnnounceSceneNodes(RN::Array *sceneNodes, const std::vector<NetworkHandle> &handles)
 	{
-		if(!_host || _isServer)
-			return;
+		NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnnounceSceneNodes);
 		
-		RN::LockGuard<decltype(_lock)> lock(_lock);
+		RN::FlatSerializer *serializer = new RN::FlatSerializer();
+		serializer->EncodeInt32(_hostID);
+		serializer->EncodeObject(sceneNodes);
+		EncodeHandles(serializer, handles);
 		
-		ENetAddress address;
-		ENetEvent event;
+		SendPacketToServer(Packet::WithTypeAndSerializer(Packet::Type::AnnounceSceneNodes, serializer));
+		serializer->Release();
 		
-		/* Connect to some.server.net:1234. */
-		enet_address_set_host(&address, ip.c_str());
-		address.port = 2003;
+		// Refilled ahead of time so that bulk placement rarely has to wait for the server. Asking only after
+		// the announcement makes sure the server no longer counts the used handles as outstanding
+		if(_handleBlock.size() < _handleBlockSize / 2)
+			RequestHandleBlock();
+	}
+	
+	void WorldAttachment::HandleSceneNodeAnnouncement(uint32 peer, Packet *packet)
+	{
+		RN::Deserializer *deserializer = packet->GetDeserializer();
+		uint32 hostID = deserializer->DecodeInt32();
+		RN::Array *nodes = static_cast<RN::Array *>(deserializer->DecodeObject());
+		std::vector<NetworkHandle> handles = DecodeHandles(deserializer);
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		// Only unused handles granted to this very peer are accepted, anything else could overwrite another node
+		auto iterator = _peerHandles.find(peer);
+		size_t count = 0;
+		
+		nodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+			count += CountSceneNodes(node);
+		});
+		
+		bool isValid = (hostID == _interestManager.GetHostID(peer) && iterator != _peerHandles.end() && count == handles.size() && std::unordered_set<NetworkHandle>(handles.begin(), handles.end()).size() == count);
+		
+		for(size_t i = 0; isValid && i < handles.size(); i ++)
+			isValid = (iterator->second.count(handles[i]) > 0);
+		
+		if(!isValid)
+		{
+			RNDebug("Ignoring %u nodes announced by peer %u under a host ID or handles it wasn't granted", static_cast<uint32>(count), peer);
+			
+			nodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+				node->RemoveFromWorld();
+			});
+			
+			return;
+		}
+		
+		for(NetworkHandle handle : handles)
+			iterator->second.erase(handle);
+		
+		std::vector<NetworkHandle> roots;
+		size_t index = 0;
+		
+		nodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &stop) {
+			roots.push_back(handles[index]);
+			RegisterSceneNodes(node, handles, index);
+		});
+		
+		uint64 sequence = _operationLog.BeginOperation();
+		
+		for(NetworkHandle handle : roots)
+			_operationLog.Record(sequence, Operation::Type::Create, hostID, handle);
+		
+		// The announcing client has the nodes already, everybody else receives them like any duplicate
+		std::vector<uint32> peers;
+		peers.reserve(_peerTransformCodecs.size());
+		
+		for(auto &pair : _peerTransformCodecs)
+		{
+			if(pair.first != peer)
+				peers.push_back(pair.first);
+		}
+		
+		RN::Serializer *serializer = new RN::FlatSerializer();
+		serializer->EncodeInt64(sequence);
+		serializer->EncodeInt32(hostID);
+		serializer->EncodeInt32(0);
+		serializer->EncodeObject(nodes);
+		EncodeHandles(serializer, handles);
+		
+		Packet *packet = Packet::WithTypeAndSerializer(Packet::Type::AnswerDuplicateSceneNode, serializer);
+		serializer->Release();
+		
+		_snapshotCache.RecordPacket(packet);
+		SendPacketToPeers(peers, packet);
+	}
+	
+	NetworkHandle WorldAttachment::GetNetworkHandle(RN::SceneNode *node) const
+	{
+		auto iterator = _networkHandles.find(node);
+		return (iterator != _networkHandles.end()) ? iterator->second : 0;
+	}
+	
+	std::vector<NetworkHandle> WorldAttachment::RegisterSceneNodes(RN::SceneNode *node)
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		std::vector<NetworkHandle> handles;
+		RegisterSceneNodeRecursive(node, handles);
+		
+		return handles;
+	}
+	
+	void WorldAttachment::RegisterSceneNodes(RN::SceneNode *node, const std::vector<NetworkHandle> &handles, size_t &index)
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		RegisterSceneNodeRecursive(node, handles, index);
+	}
+	
+	void WorldAttachment::UnregisterSceneNodes(RN::SceneNode *node)
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		UnregisterSceneNodeRecursive(node);
+	}
+	
+	void WorldAttachment::RegisterSceneNode(RN::SceneNode *node, NetworkHandle handle)
+	{
+		_networkHandles[node] = handle;
+		_dirtyStateHashes.insert(handle);
+		
+		if(_isServer)
+			_interestManager.UpdateNode(handle, node->GetWorldPosition());
+	}
+	
+	void WorldAttachment::RegisterSceneNodeRecursive(RN::SceneNode *node, std::vector<NetworkHandle> &handles)
+	{
+		NetworkHandle handle = _networkNodes.Insert(node);
+		handles.push_back(handle);
+		
+		RegisterSceneNode(node, handle);
+		
+		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *child, size_t i, bool &end) {
+			RegisterSceneNodeRecursive(child, handles);
+		});
+	}
+	
+	void WorldAttachment::RegisterSceneNodeRecursive(RN::SceneNode *node, const std::vector<NetworkHandle> &handles, size_t &index)
+	{
+		// The server lists the handles of a subtree depth first, which is the order the children are decoded in
+		if(index >= handles.size())
+			return;
+		
+		NetworkHandle handle = handles[index ++];
+		
+		_networkNodes.InsertAt(handle, node);
+		RegisterSceneNode(node, handle);
+		
+		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *child, size_t i, bool &end) {
+			RegisterSceneNodeRecursive(child, handles, index);
+		});
+	}
+	
+	void WorldAttachment::UnregisterSceneNodeRecursive(RN::SceneNode *node)
+	{
+		auto iterator = _networkHandles.find(node);
+		if(iterator != _networkHandles.end())
+		{
+			NetworkHandle handle = iterator->second;
+			
+			_networkHandles.erase(iterator);
+			_networkNodes.Remove(handle);
+			
+			_pendingTransforms.erase(handle);
+			_pendingUnreliableTransforms.erase(handle);
+			_pendingCorrections.erase(handle);
+			_continuousEditNodes.erase(handle);
+			_transformCodec.Forget(handle);
+			_operationLog.Forget(handle);
+			_operationSequencer.Forget(handle);
+			_interestManager.RemoveNode(handle);
+			_stateHash.RemoveNode(handle);
+			_dirtyStateHashes.erase(handle);
+		}
+		
+		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *child, size_t i, bool &end) {
+			UnregisterSceneNodeRecursive(child);
+		});
+	}
+	
+	void WorldAttachment::CollectNetworkHandles(RN::SceneNode *node, std::vector<NetworkHandle> &handles) const
+	{
+		// Same depth first order RegisterSceneNodeRecursive() assigns them in
+		handles.push_back(GetNetworkHandle(node));
+		
+		node->GetChildren()->Enumerate<RN::SceneNode>([&](RN::SceneNode *child, size_t i, bool &end) {
+			CollectNetworkHandles(child, handles);
+		});
+	}
+	
+	
+	void WorldAttachment::StepServer()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		NetworkHost::Event event;
+		
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		
+		while(_network->PollEvent(event))
+		{
+			_capture.RecordEvent(event);
+			HandleServerEvent(event);
+		}
+		
+		std::chrono::steady_clock::time_point fanOut = std::chrono::steady_clock::now();
+		uint64 sentMessages = _statistics.GetSentMessages();
+		
+		FinishServerStep();
+		
+		if(_loadGenerator)
+		{
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			std::chrono::duration<double> stepTime = end - start;
+			std::chrono::duration<double> fanOutTime = end - fanOut;
+			
+			_loadGenerator->RecordServerStep(stepTime.count(), fanOutTime.count(), _statistics.GetSentMessages() - sentMessages);
+		}
+	}
+	
+	void WorldAttachment::HandleServerEvent(NetworkHost::Event &event)
+	{
+		switch(event.type)
+		{
+			case NetworkHost::Event::Type::Connect:
+			{
+				_clientCount++;
+				
+				SessionInfo info;
+				info.hostID = _clientCount;
+				info.positionGrid = _transformCodec.GetPositionGrid();
+				info.scaleGrid = _transformCodec.GetScaleGrid();
+				info.conflictPolicy = static_cast<uint8>(_operationLog.GetConflictPolicy());
+				
+				SendPacketToPeer(event.peer, Packet::WithTypeAndData(DP::Packet::Type::AnswerHostID, &info, sizeof(SessionInfo)));
+				
+				WireWriter writer;
+				_stringTable.WriteDefinitions(writer, true);
+				
+				SendPacketToPeer(event.peer, Packet::WithTypeAndData(Packet::Type::AnswerStringTable, writer.GetBytes(), writer.GetLength()));
+				
+				// Until the peer publishes its region it receives everything, its snapshot has no baselines for the codec
+				TransformCodec codec;
+				codec.SetPositionGrid(_transformCodec.GetPositionGrid());
+				codec.SetScaleGrid(_transformCodec.GetScaleGrid());
+				
+				_peerTransformCodecs[event.peer] = codec;
+				_interestManager.AddPeer(event.peer, info.hostID);
+				
+				GrantHandleBlock(event.peer);
+				break;
+			}
+			
+			case NetworkHost::Event::Type::Receive:
+			{
+				Packet *packet = event.packet->Autorelease();
+				
+				_statistics.RecordReceived(packet);
+				NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Decode, packet->GetType());
+				
+				// The host ID comes with the connection, requests made in the name of another host are dropped
+				uint32 peerHostID = _interestManager.GetHostID(event.peer);
+				
+				switch(packet->GetType())
+				{
+					case Packet::Type::RequestWorld:
+					{
+						HandleWorldRequest(event.peer, packet);
+						break;
+					}
+						
+					case Packet::Type::RequestInterest:
+					{
+						HandleInterestRequest(event.peer, packet);
+						break;
+					}
+						
+					case Packet::Type::AcknowledgeWorldChunk:
+					{
+						WireReader reader(packet->GetBytes(), packet->GetLength());
+						uint32 identifier = static_cast<uint32>(reader.ReadVarUInt());
+						size_t receivedChunks = static_cast<size_t>(reader.ReadVarUInt());
+						
+						if(reader.IsValid())
+							_snapshotCache.Acknowledge(event.peer, identifier, receivedChunks);
+						
+						break;
+					}
+						
+					case Packet::Type::RequestSceneNode:
+					{
+						WireReader reader(packet->GetBytes(), packet->GetLength());
+						uint32 hostID = static_cast<uint32>(reader.ReadVarUInt());
+						RN::Object *object = nullptr;
+						
+						if(reader.ReadUInt8() == 1)
+						{
+							std::string name;
+							if(!_stringTable.Decode(reader, name))
+								break;
+							
+							object = RNSTR(name.c_str());
+						}
+						else
+						{
+							object = reader.ReadObject();
+						}
+						
+						RN::Vector3 position;
+						position.x = reader.ReadFloat();
+						position.y = reader.ReadFloat();
+						position.z = reader.ReadFloat();
+						
+						uint32 provisional = static_cast<uint32>(reader.ReadVarUInt());
+						
+						if(!reader.IsValid() || hostID != peerHostID)
+							break;
+						
+						// Nobody else ever heard of the node, so only the requester has to roll it back
+						if((!object || !RequestSceneNode(object, position, hostID, provisional)) && provisional != 0)
+						{
+							WireWriter writer;
+							writer.WriteVarUInt(provisional);
+							
+							SendPacketToPeer(event.peer, Packet::WithTypeAndData(Packet::Type::RejectProvisional, writer.GetBytes(), writer.GetLength()));
+						}
+						break;
+					}
+					
+					case Packet::Type::RequestHandleBlock:
+					{
+						GrantHandleBlock(event.peer);
+						break;
+					}
+						
+					case Packet::Type::AnnounceSceneNodes:
+					{
+						HandleSceneNodeAnnouncement(event.peer, packet);
+						break;
+					}
+						
+					case Packet::Type::RequestStateHash:
+					{
+						HandleStateHashRequest(event.peer, packet);
+						break;
+					}
+						
+					case Packet::Type::RequestStateResync:
+					{
+						HandleStateResyncRequest(event.peer, packet);
+						break;
+					}
+						
+					case Packet::Type::RequestTransform:
+					{
+						std::vector<TransformRequest> requests;
+						WireReader reader(packet->GetBytes(), packet->GetLength());
+						
+						uint64 baseSequence = reader.ReadVarUInt();
+						
+						if(!_transformCodec.Decode(reader, requests))
+							break;
+						
+						bool isForeign = std::any_of(requests.begin(), requests.end(), [&](const TransformRequest &request) {
+							return (request.hostID != peerHostID);
+						});
+						
+						if(isForeign)
+						{
+							RNDebug("Ignoring transforms sent by peer %u in the name of another host", event.peer);
+							break;
+						}
+						
+						bool reliable = (packet->GetFlags() & Packet::Flags::Reliable);
+						
+						// Received transforms are merged into the pending batch and rebroadcast with the next flush
+						for(TransformRequest &request : requests)
+						{
+							RN::SceneNode *node = _networkNodes.Get(request.handle);
+							if(!node)
+								continue;
+							
+							// Previews are checked against the policy as well, but only committed changes count as a write
+							uint8 accepted = _operationLog.AcceptTransform(request, baseSequence, reliable);
+							
+							if(reliable && accepted != request.changes)
+								QueueCorrection(node, request.handle, request.hostID, request.edit);
+							
+							request.changes = accepted;
+							
+							if(ApplyTransforms(request, reliable) && request.changes)
+							{
+								// The sender has moved on from what we last sent it
+								auto codec = _peerTransformCodecs.find(event.peer);
+								if(codec != _peerTransformCodecs.end())
+									codec->second.Forget(request.handle);
+								
+								QueueTransform(node, request.handle, request.hostID, request.edit, reliable);
+							}
+						}
+						
+						break;
+					}
+						
+					case Packet::Type::RequestSceneNodeProperty:
+					{
+						WireReader reader(packet->GetBytes(), packet->GetLength());
+						uint64 baseSequence = reader.ReadVarUInt();
+						uint32 hostID = static_cast<uint32>(reader.ReadVarUInt());
+						uint32 edit = static_cast<uint32>(reader.ReadVarUInt());
+						NetworkHandle handle = reader.ReadVarUInt();
+						
+						std::string name;
+						if(!_stringTable.Decode(reader, name))
+							break;
+						
+						RN::Object *object = reader.ReadObject();
+						if(!reader.IsValid() || hostID != peerHostID)
+							break;
+						
+						RN::SceneNode *node = _networkNodes.Get(handle);
+						if(!node)
+							break;
+						
+						if(_operationLog.AcceptProperty(hostID, baseSequence, handle, name))
+						{
+							BroadcastSceneNodeProperty(node, handle, name, object, hostID, edit, 0);
+							_levelManager.JournalSceneNodeProperty(node, name, object);
+							
+							_isRemoteChange = true;
+							node->SetValueForKey(object, name);
+						}
+						else
+						{
+							// Everyone gets the current value again, including the requester whose change got rejected
+							BroadcastSceneNodeProperty(node, handle, name, node->GetValueForKey(name), hostID, edit, Operation::Flags::Correction);
+						}
+						break;
+					}
+						
+					case Packet::Type::RequestDuplicateSceneNode:
+					{
+						size_t count = packet->GetLength() / sizeof(uint64);
+						if(count < 2)
+							break;
+						
+						std::vector<uint64> ids(count);
+						packet->GetData(ids.data());
+						
+						// The host ID comes last, preceded by the provisional ID of the requester
+						uint32 hostID = static_cast<uint32>(ids.back());
+						ids.pop_back();
+						
+						if(hostID != peerHostID)
+							break;
+						
+						uint32 provisional = static_cast<uint32>(ids.back());
+						ids.pop_back();
+						
+						RN::Array *nodes = new RN::Array();
+						for(NetworkHandle handle : ids)
+						{
+							RN::SceneNode *node = _networkNodes.Get(handle);
+							if(node)
+								nodes->AddObject(node);
+						}
+						
+						DuplicateSceneNodes(nodes, hostID, provisional);
+						break;
+					}
+						
+					case Packet::Type::RequestDeleteSceneNode:
+					{
+						size_t count = packet->GetLength() / sizeof(uint64);
+						std::vector<NetworkHandle> handles(count);
+						
+						packet->GetData(handles.data());
+						HandleSceneNodeDeletion(handles);
+						
+						BroadcastSceneNodeDeletion(handles);
+						break;
+					}
+						
+					default:
+						break;
+				}
+				
+				break;
+			}
+				
+			case NetworkHost::Event::Type::Disconnect:
+			{
+				_snapshotCache.EndTransfer(event.peer);
+				_peerTransformCodecs.erase(event.peer);
+				_interestManager.RemovePeer(event.peer);
+				ReleaseHandleBlock(event.peer);
+				break;
+			}
+		}
+	}
+	
+	void WorldAttachment::FinishServerStep()
+	{
+		UpdatePeerBudgets();
+		
+		// Keeping a snapshot with a long tail around only costs memory, once no transfer needs it anymore
+		// it is dropped and the next joiner gets a fresh one
+		if(!_snapshotCache.HasTransfers() && _snapshotCache.IsOutdated(_operationLog.GetSequence()))
+			_snapshotCache.Reset();
+		
+		_snapshotCache.SendChunks(_statistics, [this](uint32 peer, Packet *packet) {
+			SendPacketToPeer(peer, packet);
+		});
+		
+		FlushStringDefinitions();
+		FlushTransforms();
+		
+		// Everything that changed outside of a peers region trickles in at a low rate
+		if(_catchUpTimer >= kDPInterestCatchUpInterval)
+		{
+			_catchUpTimer = 0.0f;
+			
+			for(uint32 peer : _interestManager.GetPeers())
+			{
+				// Congested peers get a smaller snapshot of the current state, and only while their queue has room for it
+				if(!_interestManager.IsCongested(peer))
+				{
+					SendCatchUp(peer, false);
+				}
+				else if(_peerBacklog[peer] < _peerBudget)
+				{
+					SendCatchUp(peer, false, kDPInterestCongestedCatchUpLimit);
+				}
+			}
+		}
+	}
+	
+	void WorldAttachment::UpdatePeerBudgets()
+	{
+		if(!_network || _peerBudget == 0)
+			return;
+		
+		_network->GetBacklog(_peerBacklog);
+		
+		for(auto &pair : _peerBacklog)
+		{
+			bool congested = _interestManager.IsCongested(pair.first);
+			
+			// Transforms and properties for a congested peer are only marked as stale, so superseded
+			// updates replace each other instead of piling up in its queue
+			if(!congested && pair.second > _peerBudget)
+			{
+				RNDebug("Downpour: Peer %u has %u bytes queued, switching it to catch ups", pair.first, static_cast<uint32>(pair.second));
+				_interestManager.SetCongested(pair.first, true);
+			}
+			else if(congested && pair.second < _peerBudget / 4)
+			{
+				RNDebug("Downpour: Peer %u caught up with its queue", pair.first);
+				_interestManager.SetCongested(pair.first, false);
+				
+				SendCatchUp(pair.first, true);
+			}
+		}
+	}
+	
+	void WorldAttachment::HandleInterestRequest(uint32 peer, Packet *packet)
+	{
+		WireReader reader(packet->GetBytes(), packet->GetLength());
+		
+		RN::Vector3 center;
+		center.x = reader.ReadFloat();
+		center.y = reader.ReadFloat();
+		center.z = reader.ReadFloat();
+		float radius = reader.ReadFloat();
+		
+		size_t count = static_cast<size_t>(reader.ReadVarUInt());
+		std::vector<NetworkHandle> selection;
+		
+		for(size_t i = 0; i < count && reader.IsValid(); i ++)
+			selection.push_back(reader.ReadVarUInt());
+		
+		if(!reader.IsValid())
+			return;
+		
+		_interestManager.SetRegion(peer, center, radius);
+		_interestManager.SetSelection(peer, selection);
+		
+		// Nodes that just came into the region or selection shouldn't wait for the next regular catch up
+		SendCatchUp(peer, true);
+	}
+	
+	void WorldAttachment::SendCatchUp(uint32 peer, bool interestingOnly, size_t limit)
+	{
+		auto codec = _peerTransformCodecs.find(peer);
+		if(codec == _peerTransformCodecs.end())
+			return;
+		
+		InterestManager::CatchUp catchUp;
+		_interestManager.CollectCatchUp(peer, interestingOnly, limit, catchUp);
+		
+		if(catchUp.transforms.empty() && catchUp.properties.empty())
+			return;
+		
+		NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnswerCatchUp);
+		
+		// Catch ups carry the current state and no sequence, they are attributed to the server.
+		// Everything collected goes out in a single packet, the collection is already capped by the limit.
+		std::vector<TransformRequest> batch;
+		batch.reserve(catchUp.transforms.size());
+		
+		for(NetworkHandle handle : catchUp.transforms)
+		{
+			RN::SceneNode *node = _networkNodes.Get(handle);
+			if(node)
+				batch.push_back(MakeTransform(node, handle, _hostID, 0));
+		}
+		
+		auto &properties = catchUp.properties;
+		properties.erase(std::remove_if(properties.begin(), properties.end(), [this](const std::pair<NetworkHandle, std::string> &property) {
+			return !_networkNodes.Contains(property.first);
+		}), properties.end());
+		
+		if(batch.empty() && properties.empty())
+			return;
+		
+		WireWriter writer;
+		codec->second.Encode(writer, batch, true);
+		
+		writer.WriteVarUInt(_hostID);
+		writer.WriteVarUInt(properties.size());
+		
+		for(auto &property : properties)
+		{
+			writer.WriteVarUInt(property.first);
+			_stringTable.Encode(writer, property.second);
+			writer.WriteObject(_networkNodes.Get(property.first)->GetValueForKey(property.second));
+		}
+		
+		FlushStringDefinitions();
+		SendPacketToPeer(peer, Packet::WithTypeAndData(Packet::Type::AnswerCatchUp, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	void WorldAttachment::HandleCatchUp(Packet *packet)
+	{
+		std::vector<TransformRequest> requests;
+		WireReader reader(packet->GetBytes(), packet->GetLength());
+		
+		if(!_transformCodec.Decode(reader, requests))
+			return;
+		
+		// Our own changes that are still in flight win over the state the catch up was taken from
+		for(TransformRequest &request : requests)
+		{
+			request.changes = _operationSequencer.ShouldApplyTransform(request, Operation::Flags::CatchUp);
+			ApplyTransforms(request, true);
+		}
+		
+		uint32 hostID = static_cast<uint32>(reader.ReadVarUInt());
+		size_t count = static_cast<size_t>(reader.ReadVarUInt());
+		
+		for(size_t i = 0; i < count && reader.IsValid(); i ++)
+		{
+			NetworkHandle handle = reader.ReadVarUInt();
+			
+			std::string name;
+			if(!_stringTable.Decode(reader, name))
+				return;
+			
+			RN::Object *object = reader.ReadObject();
+			if(!reader.IsValid())
+				return;
+			
+			HashSceneNodeProperty(handle, name, object);
+			
+			RN::SceneNode *node = _networkNodes.Get(handle);
+			
+			if(node && _operationSequencer.ShouldApplyProperty(hostID, 0, Operation::Flags::CatchUp, handle, name))
+			{
+				_isRemoteChange = true;
+				node->SetValueForKey(object, name);
+			}
+		}
+	}
+	
+	void WorldAttachment::PublishInterest()
+	{
+		if(!_camera || !_isConnected)
+			return;
+		
+		// The region is only published again once the camera moved a fraction of it, or the selection changed
+		RN::Vector3 center = _camera->GetWorldPosition();
+		if(!_isInterestDirty && center.GetDistance(_publishedInterestCenter) < _interestRadius * 0.1f)
+			return;
+		
+		_isInterestDirty = false;
+		_publishedInterestCenter = center;
+		
+		std::vector<NetworkHandle> selection;
+		
+		if(_sceneNodes)
+		{
+			_sceneNodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t index, bool &stop) {
+				NetworkHandle handle = GetNetworkHandle(node);
+				if(handle)
+					selection.push_back(handle);
+			});
+		}
+		
+		WireWriter writer;
+		writer.WriteFloat(center.x);
+		writer.WriteFloat(center.y);
+		writer.WriteFloat(center.z);
+		writer.WriteFloat(_interestRadius);
+		writer.WriteVarUInt(selection.size());
+		
+		for(NetworkHandle handle : selection)
+			writer.WriteVarUInt(handle);
+		
+		SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestInterest, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	uint64 WorldAttachment::HashSceneNode(RN::SceneNode *node, NetworkHandle handle) const
+	{
+		// The transform is hashed the way a receiver decodes it, otherwise quantization alone would make every peer differ
+		TransformRequest restored;
+		_transformCodec.Restore(_transformCodec.Quantize(MakeTransform(node, handle, 0, 0)), restored);
+		
+		TransformCodec::Quantized quantized = _transformCodec.Quantize(restored);
+		uint64 hash = StateHashTree::HashBytes(&quantized, sizeof(TransformCodec::Quantized));
+		
+		std::string name = node->GetClass()->GetFullname();
+		hash = StateHashTree::HashBytes(name.data(), name.length(), hash);
+		
+		NetworkHandle parent = node->GetParent() ? GetNetworkHandle(node->GetParent()) : 0;
+		return StateHashTree::HashBytes(&parent, sizeof(NetworkHandle), hash);
+	}
+	
+	void WorldAttachment::HashSceneNodeProperty(NetworkHandle handle, const std::string &name, RN::Object *object)
+	{
+		// A node we don't have must not show up in the tree, it would be listed as known in resync requests
+		if(!_networkNodes.Contains(handle))
+			return;
+		
+		WireWriter writer;
+		writer.WriteObject(object);
+		
+		_stateHash.SetProperty(handle, name, StateHashTree::HashBytes(writer.GetBytes(), writer.GetLength()));
+	}
+	
+	void WorldAttachment::UpdateStateHashes()
+	{
+		for(NetworkHandle handle : _dirtyStateHashes)
+		{
+			RN::SceneNode *node = _networkNodes.Get(handle);
+			if(node)
+				_stateHash.SetNode(handle, HashSceneNode(node, handle));
+		}
+		
+		_dirtyStateHashes.clear();
+	}
+	
+	bool WorldAttachment::IsStateSettled() const
+	{
+		// A client can only expect to match the server while none of its own changes are on the way
+		return (_isConnected && !_isLoadingWorld && !_isAwaitingWorld && !_isContinuousEdit && _provisionalOperations.empty() && _pendingTransforms.empty() && _pendingCorrections.empty());
+	}
+	
+	void WorldAttachment::CompareStateHash(float delta)
+	{
+		if(_stateHashInterval <= 0.0f)
+			return;
+		
+		_stateHashTimer += delta;
+		
+		if(_stateHashTimer < _stateHashInterval || !IsStateSettled())
+			return;
+		
+		_stateHashTimer = 0.0f;
+		
+		// Asking for the children of the root right away costs about as much as asking for the root alone
+		RequestStateHashes(0, { 0 });
+	}
+	
+	void WorldAttachment::RequestStateHashes(uint32 level, const std::vector<size_t> &indices)
+	{
+		WireWriter writer;
+		writer.WriteVarUInt(_operationSequencer.GetSequence());
+		writer.WriteVarUInt(level);
+		writer.WriteVarUInt(indices.size());
+		
+		for(size_t index : indices)
+			writer.WriteVarUInt(index);
+		
+		SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestStateHash, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	void WorldAttachment::HandleStateHashRequest(uint32 peer, Packet *packet)
+	{
+		WireReader reader(packet->GetBytes(), packet->GetLength());
+		uint64 sequence = reader.ReadVarUInt();
+		uint32 level = static_cast<uint32>(reader.ReadVarUInt());
+		size_t count = static_cast<size_t>(reader.ReadVarUInt());
+		
+		// Comparing is pointless while operations are in flight or the peer is still waiting for catch ups
+		if(!reader.IsValid() || level >= kDPStateHashDepth || sequence != _operationLog.GetSequence() || _interestManager.HasStaleState(peer))
+			return;
+		
+		std::vector<size_t> indices;
+		
+		for(size_t i = 0; i < count && reader.IsValid(); i ++)
+		{
+			size_t index = static_cast<size_t>(reader.ReadVarUInt());
+			if(index < StateHashTree::GetLevelSize(level))
+				indices.push_back(index);
+		}
+		
+		if(!reader.IsValid())
+			return;
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		UpdateStateHashes();
+		
+		WireWriter writer;
+		writer.WriteVarUInt(sequence);
+		writer.WriteVarUInt(level);
+		writer.WriteVarUInt(indices.size());
+		
+		for(size_t index : indices)
+		{
+			writer.WriteVarUInt(index);
+			
+			for(size_t i = 0; i < kDPStateHashFanOut; i ++)
+				writer.WriteUInt64(_stateHash.GetHash(level + 1, index * kDPStateHashFanOut + i));
+		}
+		
+		SendPacketToPeer(peer, Packet::WithTypeAndData(Packet::Type::AnswerStateHash, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	void WorldAttachment::HandleStateHashAnswer(Packet *packet)
+	{
+		WireReader reader(packet->GetBytes(), packet->GetLength());
+		uint64 sequence = reader.ReadVarUInt();
+		uint32 level = static_cast<uint32>(reader.ReadVarUInt());
+		size_t count = static_cast<size_t>(reader.ReadVarUInt());
+		
+		// Anything that happened since the request makes the answer meaningless
+		if(!reader.IsValid() || level >= kDPStateHashDepth || sequence != _operationSequencer.GetSequence() || !IsStateSettled())
+			return;
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		UpdateStateHashes();
+		
+		std::vector<size_t> diverged;
+		
+		for(size_t i = 0; i < count && reader.IsValid(); i ++)
+		{
+			size_t index = static_cast<size_t>(reader.ReadVarUInt());
+			if(index >= StateHashTree::GetLevelSize(level))
+				return;
+			
+			for(size_t j = 0; j < kDPStateHashFanOut; j ++)
+			{
+				size_t child = index * kDPStateHashFanOut + j;
+				uint64 hash = reader.ReadUInt64();
+				
+				if(reader.IsValid() && hash != _stateHash.GetHash(level + 1, child))
+					diverged.push_back(child);
+			}
+		}
+		
+		if(!reader.IsValid() || diverged.empty())
+			return;
+		
+		if(level + 1 < kDPStateHashDepth)
+		{
+			RequestStateHashes(level + 1, diverged);
+			return;
+		}
+		
+		RNDebug("Downpour: Resyncing %u diverged buckets of the scene state", static_cast<uint32>(diverged.size()));
+		
+		// The server needs to know which nodes we have in the buckets to tell missing and superfluous ones apart
+		WireWriter writer;
+		writer.WriteVarUInt(sequence);
+		writer.WriteVarUInt(diverged.size());
+		
+		for(size_t bucket : diverged)
+		{
+			const std::unordered_set<NetworkHandle> &nodes = _stateHash.GetBucketNodes(bucket);
+			
+			writer.WriteVarUInt(bucket);
+			writer.WriteVarUInt(nodes.size());
+			
+			for(NetworkHandle handle : nodes)
+				writer.WriteVarUInt(handle);
+		}
+		
+		SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestStateResync, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	// Layout of the resync:
+	//   varint sequence, varint deleted node count, [varint handle]
+	//   varint node count, per node: varint handle, varint parent handle, uint8 kind,
+	//     kind 0 (known to the peer): 3 float position, 4 float rotation, 3 float scale
+	//     kind 1 (missing on the peer): object node including its children, varint handle count, [varint handle]
+	//   followed by varint property count, [string name, object value]
+	
+	void WorldAttachment::HandleStateResyncRequest(uint32 peer, Packet *packet)
+	{
+		WireReader reader(packet->GetBytes(), packet->GetLength());
+		uint64 sequence = reader.ReadVarUInt();
+		size_t count = static_cast<size_t>(reader.ReadVarUInt());
+		
+		if(!reader.IsValid() || sequence != _operationLog.GetSequence())
+			return;
+		
+		std::unordered_set<size_t> buckets;
+		std::unordered_set<NetworkHandle> known;
+		
+		for(size_t i = 0; i < count && reader.IsValid(); i ++)
+		{
+			size_t bucket = static_cast<size_t>(reader.ReadVarUInt());
+			size_t nodes = static_cast<size_t>(reader.ReadVarUInt());
+			
+			if(bucket >= StateHashTree::GetLevelSize(kDPStateHashDepth))
+				return;
+			
+			buckets.insert(bucket);
+			
+			for(size_t j = 0; j < nodes && reader.IsValid(); j ++)
+				known.insert(reader.ReadVarUInt());
+		}
+		
+		if(!reader.IsValid())
+			return;
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		UpdateStateHashes();
+		
+		NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnswerStateResync);
+		
+		WireWriter writer;
+		writer.WriteVarUInt(sequence);
+		
+		std::vector<NetworkHandle> deleted;
+		
+		for(NetworkHandle handle : known)
+		{
+			if(!_networkNodes.Contains(handle))
+				deleted.push_back(handle);
+		}
+		
+		writer.WriteVarUInt(deleted.size());
+		
+		for(NetworkHandle handle : deleted)
+			writer.WriteVarUInt(handle);
+		
+		std::vector<NetworkHandle> nodes;
+		
+		for(size_t bucket : buckets)
+		{
+			for(NetworkHandle handle : _stateHash.GetBucketNodes(bucket))
+			{
+				RN::SceneNode *node = _networkNodes.Get(handle);
+				if(!node)
+					continue;
+				
+				// A missing node whose parent is missing as well comes along with the parent
+				NetworkHandle parent = node->GetParent() ? GetNetworkHandle(node->GetParent()) : 0;
+				if(!known.count(handle) && parent && buckets.count(StateHashTree::GetBucketIndex(parent)) && !known.count(parent))
+					continue;
+				
+				nodes.push_back(handle);
+			}
+		}
+		
+		writer.WriteVarUInt(nodes.size());
+		
+		auto codec = _peerTransformCodecs.find(peer);
+		
+		for(NetworkHandle handle : nodes)
+		{
+			RN::SceneNode *node = _networkNodes.Get(handle);
+			
+			// The resync overwrites the peers transform with unquantized values
+			if(codec != _peerTransformCodecs.end())
+				codec->second.Forget(handle);
+			
+			writer.WriteVarUInt(handle);
+			writer.WriteVarUInt(node->GetParent() ? GetNetworkHandle(node->GetParent()) : 0);
+			
+			if(known.count(handle))
+			{
+				RN::Vector3 position = node->GetPosition();
+				RN::Quaternion rotation = node->GetRotation();
+				RN::Vector3 scale = node->GetScale();
+				
+				writer.WriteUInt8(0);
+				writer.WriteFloat(position.x);
+				writer.WriteFloat(position.y);
+				writer.WriteFloat(position.z);
+				writer.WriteFloat(rotation.x);
+				writer.WriteFloat(rotation.y);
+				writer.WriteFloat(rotation.z);
+				writer.WriteFloat(rotation.w);
+				writer.WriteFloat(scale.x);
+				writer.WriteFloat(scale.y);
+				writer.WriteFloat(scale.z);
+			}
+			else
+			{
+				std::vector<NetworkHandle> subtree;
+				CollectNetworkHandles(node, subtree);
+				
+				writer.WriteUInt8(1);
+				writer.WriteObject(node);
+				writer.WriteVarUInt(subtree.size());
+				
+				for(NetworkHandle child : subtree)
+					writer.WriteVarUInt(child);
+			}
+			
+			std::vector<std::string> properties = _stateHash.GetProperties(handle);
+			writer.WriteVarUInt(properties.size());
+			
+			for(const std::string &name : properties)
+			{
+				writer.WriteString(name);
+				writer.WriteObject(node->GetValueForKey(name));
+			}
+		}
+		
+		SendPacketToPeer(peer, Packet::WithTypeAndData(Packet::Type::AnswerStateResync, writer.GetBytes(), writer.GetLength()));
+	}
+	
+	void WorldAttachment::HandleStateResyncAnswer(Packet *packet)
+	{
+		WireReader reader(packet->GetBytes(), packet->GetLength());
+		uint64 sequence = reader.ReadVarUInt();
+		
+		if(!reader.IsValid() || sequence != _operationSequencer.GetSequence() || !IsStateSettled())
+			return;
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		std::vector<NetworkHandle> deleted(static_cast<size_t>(reader.ReadVarUInt()));
+		
+		for(NetworkHandle &handle : deleted)
+			handle = reader.ReadVarUInt();
+		
+		if(!reader.IsValid())
+			return;
+		
+		HandleSceneNodeDeletion(deleted);
+		
+		size_t count = static_cast<size_t>(reader.ReadVarUInt());
+		
+		for(size_t i = 0; i < count && reader.IsValid(); i ++)
+		{
+			NetworkHandle handle = reader.ReadVarUInt();
+			NetworkHandle parentHandle = reader.ReadVarUInt();
+			RN::SceneNode *node = nullptr;
+			
+			if(reader.ReadUInt8() == 0)
+			{
+				RN::Vector3 position, scale;
+				RN::Quaternion rotation;
+				
+				position.x = reader.ReadFloat();
+				position.y = reader.ReadFloat();
+				position.z = reader.ReadFloat();
+				rotation.x = reader.ReadFloat();
+				rotation.y = reader.ReadFloat();
+				rotation.z = reader.ReadFloat();
+				rotation.w = reader.ReadFloat();
+				scale.x = reader.ReadFloat();
+				scale.y = reader.ReadFloat();
+				scale.z = reader.ReadFloat();
+				
+				node = _networkNodes.Get(handle);
+				
+				if(node && reader.IsValid())
+				{
+					_isRemoteChange = true;
+					node->SetPosition(position);
+					node->SetRotation(rotation);
+					node->SetScale(scale);
+					_isRemoteChange = false;
+					
+					_transformCodec.Forget(handle);
+				}
+			}
+			else
+			{
+				node = static_cast<RN::SceneNode *>(reader.ReadObject());
+				std::vector<NetworkHandle> subtree(static_cast<size_t>(reader.ReadVarUInt()));
+				
+				for(NetworkHandle &child : subtree)
+					child = reader.ReadVarUInt();
+				
+				if(!node || !reader.IsValid())
+					break;
+				
+				// Whatever we still have under one of the handles is outdated and replaced by the servers version
+				std::vector<NetworkHandle> outdated;
+				
+				for(NetworkHandle child : subtree)
+				{
+					if(_networkNodes.Contains(child))
+						outdated.push_back(child);
+				}
+				
+				HandleSceneNodeDeletion(outdated);
+				
+				size_t index = 0;
+				RegisterSceneNodes(node, subtree, index);
+			}
+			
+			RN::SceneNode *parent = parentHandle ? _networkNodes.Get(parentHandle) : nullptr;
+			
+			if(node && node->GetParent() != parent)
+			{
+				if(node->GetParent())
+					node->RemoveFromParent();
+				
+				if(parent)
+					parent->AddChild(node);
+				
+				_dirtyStateHashes.insert(handle);
+			}
+			
+			size_t properties = static_cast<size_t>(reader.ReadVarUInt());
+			
+			for(size_t j = 0; j < properties && reader.IsValid(); j ++)
+			{
+				std::string name = reader.ReadString();
+				RN::Object *object = reader.ReadObject();
+				
+				if(node && object && reader.IsValid())
+				{
+					_isRemoteChange = true;
+					node->SetValueForKey(object, name);
+					HashSceneNodeProperty(handle, name, object);
+				}
+			}
+		}
+	}
+	
+	void WorldAttachment::HandleWorldRequest(uint32 peer, Packet *packet)
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		// The world is only serialized when somebody joins, joiners in quick succession share the snapshot
+		// and catch up through its tail, until the tail grew too long to be worth replaying
+		if(!_snapshotCache.GetSnapshot() || _snapshotCache.IsOutdated(_operationLog.GetSequence()))
+			RefreshSnapshot();
+		
+		Snapshot *snapshot = _snapshotCache.GetSnapshot();
+		
+		// Whatever the peer had before is replaced by the snapshot
+		auto codec = _peerTransformCodecs.find(peer);
+		if(codec != _peerTransformCodecs.end())
+			codec->second.Reset();
+		
+		size_t firstChunk = 0;
+		
+		// A client that lost its connection during a transfer asks to resume after its last received chunk,
+		// which only works as long as we still have the snapshot it was receiving
+		if(packet->GetLength() > 0)
+		{
+			WireReader reader(packet->GetBytes(), packet->GetLength());
+			uint32 identifier = static_cast<uint32>(reader.ReadVarUInt());
+			size_t receivedChunks = static_cast<size_t>(reader.ReadVarUInt());
+			
+			// Resuming is only possible as long as the snapshot is still cached, the tail brings it up to date again
+			if(reader.IsValid() && snapshot->GetIdentifier() == identifier && receivedChunks <= snapshot->GetChunkCount())
+				firstChunk = receivedChunks;
+		}
+		
+		SendPacketToPeer(peer, snapshot->CreateInfoPacket(firstChunk));
+		SendSnapshotTail(peer);
+		
+		_snapshotCache.BeginTransfer(peer, firstChunk);
+	}
+	
+	void WorldAttachment::RefreshSnapshot()
+	{
+		NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Encode, Packet::Type::AnswerWorld);
+		
+		RN::FlatSerializer *serializer = new RN::FlatSerializer();
+		
+		// The saved world only knows engine LIDs, so the network handles go ahead of it keyed by LID
+		serializer->EncodeInt32(static_cast<int32>(_networkNodes.GetCount()));
+		_networkNodes.Enumerate([&](NetworkHandle handle, RN::SceneNode *node) {
+			serializer->EncodeInt64(node->GetLID());
+			serializer->EncodeInt64(handle);
+		});
+		
+		RN::WorldCoordinator::GetSharedInstance()->SaveWorld(serializer);
+		
+		_snapshotCache.Refresh(_operationLog.GetSequence(), serializer->GetSerializedData());
+		serializer->Release();
+	}
+	
+	void WorldAttachment::SendSnapshotTail(uint32 peer)
+	{
+		for(Packet *packet : _snapshotCache.GetTailPackets())
+			SendPacketToPeer(peer, packet);
+		
+		for(NetworkHandle handle : _snapshotCache.GetTailTransforms())
+			_interestManager.MarkStale(peer, handle);
+		
+		for(auto &pair : _snapshotCache.GetTailProperties())
+		{
+			for(const std::string &name : pair.second)
+				_interestManager.MarkStale(peer, pair.first, name);
+		}
+		
+		SendCatchUp(peer, false, std::numeric_limits<size_t>::max());
+	}
+	
+	extern void ActivateDownpour();
+	extern void DeactivateDownpour();
+	
+	void WorldAttachment::StepClient()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		NetworkHost::Event event;
+		
+		while(_network->PollEvent(event))
+		{
+			switch(event.type)
+			{
+				case NetworkHost::Event::Type::Connect:
+				{
+					_capture.RecordEvent(event);
+					
+					_isConnected = true;
+					_isAwaitingWorld = true;
+					
+					if(_snapshotReceiver.IsActive() && _snapshotAddress == _serverAddress)
+					{
+						WireWriter writer;
+						_snapshotReceiver.WriteResumeRequest(writer);
+						
+						SendPacketToServer(Packet::WithTypeAndData(Packet::Type::RequestWorld, writer.GetBytes(), writer.GetLength()));
+					}
+					else
+					{
+						_snapshotReceiver.Reset();
+						_snapshotAddress = _serverAddress;
+						
+						SendPacketToServer(Packet::WithType(Packet::Type::RequestWorld));
+					}
+					
+					break;
+				}
+					
+				case NetworkHost::Event::Type::Receive:
+				{
+					Packet *packet = event.packet->Autorelease();
+					_statistics.RecordReceived(packet);
+					_capture.RecordEvent(event);
+					
+					// Operations that arrive before the world are applied once it is loaded, the ones
+					// that are already part of the snapshot get dropped then by their sequence number
+					if(_isAwaitingWorld && IsOperationPacket(packet))
+					{
+						_deferredPackets.push_back(packet->Retain());
+						break;
+					}
+					
+					HandleClientPacket(packet);
+					
+					break;
+				}
+					
+				case NetworkHost::Event::Type::Disconnect:
+				{
+					_capture.RecordEvent(event);
+					
+					if(!_isConnected)
+						InfoPanel::WithMessage(RNCSTR("Couldn't connect to server! Ping time out"));
+					
+					//_isConnected = false;
+					break;
+				}
+			}
+		}
+		
+		PublishInterest();
+		FlushTransforms();
+	}
+
+	
+	void WorldAttachment::HandleClientPacket(Packet *packet)
+	{
+		NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Decode, packet->GetType());
+		
+		switch(packet->GetType())
+		{
+			case Packet::Type::AnswerHostID:
+			{
+				if(packet->GetLength() != sizeof(SessionInfo))
+					break;
+				
+				SessionInfo info;
+				packet->GetData(&info);
+				
+				_hostID = info.hostID;
+				_transformCodec.SetPositionGrid(info.positionGrid);
+				_transformCodec.SetScaleGrid(info.scaleGrid);
+				
+				_operationSequencer.SetHostID(_hostID);
+				_operationSequencer.SetConflictPolicy(static_cast<ConflictPolicy>(info.conflictPolicy));
+				break;
+			}
+				
+			case Packet::Type::AnswerStringTable:
+			{
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				_stringTable.ReadDefinitions(reader);
+				break;
+			}
+				
+			case Packet::Type::AnswerStateHash:
+			{
+				HandleStateHashAnswer(packet);
+				break;
+			}
+				
+			case Packet::Type::AnswerStateResync:
+			{
+				HandleStateResyncAnswer(packet);
+				break;
+			}
+				
+			case Packet::Type::AnswerCatchUp:
+			{
+				HandleCatchUp(packet);
+				break;
+			}
+				
+			case Packet::Type::AnswerHandleBlock:
+			{
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				size_t count = static_cast<size_t>(reader.ReadVarUInt());
+				
+				std::vector<NetworkHandle> handles;
+				
+				for(size_t i = 0; i < count && reader.IsValid(); i ++)
+					handles.push_back(reader.ReadVarUInt());
+				
+				if(!reader.IsValid())
+					break;
+				
+				_handleBlock.insert(_handleBlock.end(), handles.begin(), handles.end());
+				_isAwaitingHandles = false;
+				
+				if(count > 0)
+					_handleBlockSize = count;
+				break;
+			}
+				
+			case Packet::Type::AnswerWorld:
+			{
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				
+				// The server couldn't resume the transfer we asked for, so start over with a fresh snapshot
+				if(!_snapshotReceiver.Begin(reader))
+				{
+					SendPacketToServer(Packet::WithType(Packet::Type::RequestWorld));
+					break;
+				}
+				
+				// The server follows up with every operation since its snapshot was taken, so anything that arrived
+				// before could otherwise be applied ahead of older operations from that tail and get them dropped
+				for(Packet *deferred : _deferredPackets)
+					deferred->Release();
+				
+				_deferredPackets.clear();
+				
+				UpdateSnapshotProgress();
+				
+				if(_snapshotReceiver.IsComplete())
+					LoadSnapshot();
+				
+				break;
+			}
+				
+			case Packet::Type::AnswerWorldChunk:
+			{
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				
+				if(!_snapshotReceiver.ReceiveChunk(reader))
+					break;
+				
+				// The acknowledgement is the same as a resume request, the number of chunks received so far
+				WireWriter writer;
+				_snapshotReceiver.WriteResumeRequest(writer);
+				
+				SendPacketToServer(Packet::WithTypeAndData(Packet::Type::AcknowledgeWorldChunk, writer.GetBytes(), writer.GetLength()));
+				UpdateSnapshotProgress();
+				
+				if(_snapshotReceiver.IsComplete())
+					LoadSnapshot();
+				
+				break;
+			}
+				
+			case Packet::Type::AnswerSceneNode:
+			{
+				RN::Deserializer *deserializer = packet->GetDeserializer();
+				uint64 sequence = deserializer->DecodeInt64();
+				
+				if(!_operationSequencer.BeginOperation(sequence))
+					break;
+				
+				uint32 hostID = deserializer->DecodeInt32();
+				uint32 provisional = deserializer->DecodeInt32();
+				RN::SceneNode *node = static_cast<RN::SceneNode *>(deserializer->DecodeObject());
+				
+				size_t index = 0;
+				RegisterSceneNodes(node, DecodeHandles(deserializer), index);
+				
+				if(hostID == _hostID)
+				{
+					ResolveProvisionalOperation(provisional, { node });
+					SelectInWorkspace(node);
+				}
+				
+				break;
+			}
+				
+			case Packet::Type::AnswerTransform:
+			{
+				std::vector<TransformRequest> requests;
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				
+				uint64 sequence = reader.ReadVarUInt();
+				uint8 flags = reader.ReadUInt8();
+				
+				if(!_transformCodec.Decode(reader, requests))
+					break;
+				
+				// Unreliable transforms are previews without a sequence, everything else is applied exactly once
+				bool reliable = (packet->GetFlags() & Packet::Flags::Reliable);
+				if(reliable && !_operationSequencer.BeginOperation(sequence))
+					break;
+				
+				for(TransformRequest &request : requests)
+				{
+					if(reliable)
+					{
+						request.changes = _operationSequencer.ShouldApplyTransform(request, flags);
+					}
+					else if(request.hostID == _hostID)
+					{
+						continue;
+					}
+					
+					ApplyTransforms(request, reliable);
+				}
+				
+				break;
+			}
+				
+			case Packet::Type::AnswerSceneNodeProperty:
+			{
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				uint64 sequence = reader.ReadVarUInt();
+				uint8 flags = reader.ReadUInt8();
+				uint32 hostID = static_cast<uint32>(reader.ReadVarUInt());
+				uint32 edit = static_cast<uint32>(reader.ReadVarUInt());
+				NetworkHandle handle = reader.ReadVarUInt();
+				
+				std::string name;
+				if(!_stringTable.Decode(reader, name))
+					break;
+				
+				RN::Object *object = reader.ReadObject();
+				if(!reader.IsValid())
+					break;
+				
+				if(!_operationSequencer.BeginOperation(sequence))
+					break;
+				
+				// The hash follows the committed value, even when a newer local change keeps it from being applied
+				HashSceneNodeProperty(handle, name, object);
+				
+				RN::SceneNode *node = _networkNodes.Get(handle);
+				
+				if(node && _operationSequencer.ShouldApplyProperty(hostID, edit, flags, handle, name))
+				{
+					_isRemoteChange = true;
+					node->SetValueForKey(object, name);
+				}
+				break;
+			}
+				
+			case Packet::Type::AnswerDuplicateSceneNode:
+			{
+				RN::Deserializer *deserializer = packet->GetDeserializer();
+				uint64 sequence = deserializer->DecodeInt64();
+				
+				if(!_operationSequencer.BeginOperation(sequence))
+					break;
+				
+				uint32 hostID = deserializer->DecodeInt32();
+				uint32 provisional = deserializer->DecodeInt32();
+				RN::Array *nodes = static_cast<RN::Array *>(deserializer->DecodeObject());
+				std::vector<NetworkHandle> handles = DecodeHandles(deserializer);
+				std::vector<RN::SceneNode *> confirmed;
+				size_t index = 0;
+				
+				nodes->Enumerate<RN::SceneNode>([&](RN::SceneNode *node, size_t i, bool &end){
+					RegisterSceneNodes(node, handles, index);
+					confirmed.push_back(node);
+				});
+				
+				if(hostID == _hostID)
+				{
+					ResolveProvisionalOperation(provisional, confirmed);
+					SelectInWorkspace(nodes);
+				}
+				
+				break;
+			}
+				
+			case Packet::Type::RejectProvisional:
+			{
+				WireReader reader(packet->GetBytes(), packet->GetLength());
+				uint32 provisional = static_cast<uint32>(reader.ReadVarUInt());
+				
+				if(reader.IsValid())
+					ResolveProvisionalOperation(provisional, {});
+				
+				break;
+			}
+				
+			case Packet::Type::AnswerDeleteSceneNode:
+			{
+				size_t count = packet->GetLength() / sizeof(uint64);
+				std::vector<NetworkHandle> handles(count);
+				
+				packet->GetData(handles.data());
+				
+				// The sequence is appended as the last element
+				if(handles.empty() || !_operationSequencer.BeginOperation(handles.back()))
+					break;
+				
+				handles.pop_back();
+				HandleSceneNodeDeletion(handles);
+				break;
+			}
+				
+			default:
+				break;
+		}
+	}
+	
+	bool WorldAttachment::IsOperationPacket(Packet *packet) const
+	{
+		switch(packet->GetType())
+		{
+			case Packet::Type::AnswerTransform:
+			case Packet::Type::AnswerSceneNode:
+			case Packet::Type::AnswerSceneNodeProperty:
+			case Packet::Type::AnswerDuplicateSceneNode:
+			case Packet::Type::AnswerDeleteSceneNode:
+			case Packet::Type::AnswerCatchUp:
+				return true;
+				
+			default:
+				return false;
+		}
+	}
+	
+	void WorldAttachment::LoadSnapshot()
+	{
+		_isLoadingWorld = true;
+		_operationSequencer.Reset(_snapshotReceiver.GetSequence());
+		
+		RN::Kernel::GetSharedInstance()->ScheduleFunction([this]() {
+			
+			{
+				RN::World::GetActiveWorld()->RemoveAttachment(this);
+				RN::AutoreleasePool pool;
+				DeactivateDownpour();
+			}
+			
+			RN::Kernel::GetSharedInstance()->ScheduleFunction([this]() {
+				
+				RN::MessageCenter::GetSharedInstance()->AddObserver(kRNWorldCoordinatorDidFinishLoadingMessage, [this](RN::Message *message) {
+					
+					_networkNodes.Clear();
+					_networkHandles.clear();
+					_stateHash.Clear();
+					_dirtyStateHashes.clear();
+
+					// Mirror the servers handles, they were sent ahead of the world keyed by the engine LIDs
+					RN::Array *nodes = RN::World::GetActiveWorld()->GetSceneNodes();
+					nodes->Enumerate<RN::SceneNode>([this](RN::SceneNode *node, size_t i, bool &stop ){
+						if(!node->IsKindOfClass(RN::Camera::GetMetaClass()))
+						{
+							auto iterator = _snapshotHandles.find(node->GetLID());
+							if(iterator != _snapshotHandles.end())
+							{
+								_networkNodes.InsertAt(iterator->second, node);
+								_networkHandles[node] = iterator->second;
+								_dirtyStateHashes.insert(iterator->second);
+							}
+						}
+					});
+
+					_snapshotHandles.clear();
+
+					RN::MessageCenter::GetSharedInstance()->RemoveObserver(this);
+					ActivateDownpour();
+					RN::World::GetActiveWorld()->Update(0.0f);
+					
+					_isLoadingWorld = false;
+					ReplayDeferredPackets();
+					
+				}, this);
+				
+				// The deserializer reads directly from the receivers buffer, which is only released once the world is loaded
+				RN::Deserializer *deserializer = _snapshotReceiver.GetDeserializer()->Retain();
+
+				int32 handleCount = deserializer->DecodeInt32();
+				_snapshotHandles.clear();
+				_snapshotHandles.reserve(handleCount);
+
+				for(int32 i = 0; i < handleCount; i ++)
+				{
+					uint64 lid = deserializer->DecodeInt64();
+					_snapshotHandles[lid] = deserializer->DecodeInt64();
+				}
+
+				// The snapshot replaces whatever level was open, so there are no chunks to carry over into a save
+				_levelManager.ResetLevelChunks();
+				_transformCodec.Reset();
+				
+				RN::WorldCoordinator::GetSharedInstance()->LoadWorld(deserializer);
+				deserializer->Release();
+				
+				_snapshotReceiver.Reset();
+				CloseSnapshotProgress();
+			});
+		});
+	}
+	
+	void WorldAttachment::ReplayDeferredPackets()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
 		
-		/* Initiate the connection, allocating the two channels 0 and 1. */
-		RN_ASSERT((_peer = enet_host_connect(_host, &address, 2, 0)), "Enet couldn't create a peer!");
+		_isAwaitingWorld = false;
 		
-		/* Wait up to 5 seconds for the connection attempt to succeed. */
-		if(enet_host_service(_host, &event, 5000) > 0 && event.type == ENET_EVENT_TYPE_CONNECT)
+		std::vector<Packet *> packets;
+		std::swap(packets, _deferredPackets);
+		
+		for(Packet *packet : packets)
 		{
-			_isConnected = true;
-			SendPacketToServer(Packet::WithType(Packet::Type::RequestWorld));
+			HandleClientPacket(packet);
+			packet->Release();
 		}
-		else
+	}
+	
+	void WorldAttachment::UpdateSnapshotProgress()
+	{
+		if(!_snapshotProgress)
 		{
-			_isConnected = false;
-			InfoPanel::WithMessage(RNCSTR("Couldn't connect to server! Ping time out"));
+			_snapshotProgress = new ProgressPanel(RNCSTR("Receiving World"));
+			_snapshotProgress->Open();
 		}
+		
+		float received = (_snapshotReceiver.GetLength() * _snapshotReceiver.GetProgress()) / (1024.0f * 1024.0f);
+		float total = _snapshotReceiver.GetLength() / (1024.0f * 1024.0f);
+		
+		_snapshotProgress->SetMessage(RNSTR("%.1f of %.1f MB", received, total));
+		_snapshotProgress->SetProgress(_snapshotReceiver.GetProgress());
 	}
 	
-	void WorldAttachment::Disconnect()
+	void WorldAttachment::CloseSnapshotProgress()
 	{
-		if(!_peer || !_isConnected)
+		if(_snapshotProgress)
+		{
+			_snapshotProgress->Close();
+			_snapshotProgress->Release();
+			_snapshotProgress = nullptr;
+		}
+	}
+	
+	void WorldAttachment::CreateServer()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		if(!_levelManager.PrepareServer())
 			return;
 		
+		DestroyHost();
+		
+		ENetAddress address;
+		address.host = ENET_HOST_ANY;
+		address.port = 2003;
+		
+		// Review sessions can have a lot of read-only viewers, ENet itself caps the peer IDs at 4095
+		size_t maxPeers = std::min<size_t>(GetSizeSetting(RNCSTR("DPMaxPeers"), kDPNetworkDefaultMaxPeers), ENET_PROTOCOL_MAXIMUM_PEER_ID);
+		
+		ENetHost *host;
+		RN_ASSERT((host = enet_host_create(&address, std::max<size_t>(maxPeers, 1), kDPNetworkChannelCount, 0, 0)), "Enet couldn't create server");
+		
+		_network = new NetworkHost(host);
+		PrepareServer();
+	}
+	
+	void WorldAttachment::PrepareServer()
+	{
+		_statistics.Reset();
+		
+		_isServer    = true;
+		_isConnected = true;
+		_stringTable.SetAuthoritative(true);
+		_hostID = 0;
+		_clientCount = 0;
+		
+		// The quantization grid is a session setting, clients receive it along with their host ID
+		RN::Settings *settings = RN::Settings::GetSharedInstance();
+		_transformCodec.SetPositionGrid(settings->GetFloatForKey(RNCSTR("DPTransformPositionGrid"), kDPTransformCodecDefaultPositionGrid));
+		_transformCodec.SetScaleGrid(settings->GetFloatForKey(RNCSTR("DPTransformScaleGrid"), kDPTransformCodecDefaultScaleGrid));
+		
+		_interestManager.SetCellSize(std::max(settings->GetFloatForKey(RNCSTR("DPInterestCellSize"), kDPInterestDefaultCellSize), 1.0f));
+		_catchUpTimer = 0.0f;
+		
+		if(!_workerPool)
+			_workerPool = new WorkerPool(GetSizeSetting(RNCSTR("DPFanOutThreads"), 0));
+		
+		_handleBlockSize = std::max<size_t>(GetSizeSetting(RNCSTR("DPHandleBlockSize"), kDPHandleBlockDefaultSize), 1);
+		_peerBudget      = GetSizeSetting(RNCSTR("DPPeerBudget"), kDPPeerDefaultBudget);
+		
+		_snapshotCache.SetChunkSize(std::max<size_t>(GetSizeSetting(RNCSTR("DPSnapshotChunkSize"), kDPSnapshotDefaultChunkSize), 1024));
+		_snapshotCache.SetWindowSize(GetSizeSetting(RNCSTR("DPSnapshotWindowSize"), kDPSnapshotDefaultWindowSize));
+		_snapshotCache.SetTailLimit(GetSizeSetting(RNCSTR("DPSnapshotTailLimit"), kDPSnapshotDefaultTailLimit));
+		
+		RN::String *policy = settings->GetObjectForKey<RN::String>(RNCSTR("DPConflictPolicy"));
+		_operationLog.SetConflictPolicy((policy && policy->IsEqual(RNCSTR("FirstWriterWins"))) ? ConflictPolicy::FirstWriterWins : ConflictPolicy::LastWriterWins);
+		_operationLog.SetCapacity(GetSizeSetting(RNCSTR("DPOperationLogCapacity"), kDPOperationLogDefaultCapacity));
+		
+		RN::Array *nodes = RN::World::GetActiveWorld()->GetSceneNodes();
+		
+		{
+			RN::LockGuard<decltype(_lock)> lock(_lock);
+			
+			_networkNodes.Clear();
+			_networkHandles.clear();
+			_networkNodes.Reserve(nodes->GetCount());
+			_stateHash.Clear();
+			_dirtyStateHashes.clear();
+			
+			nodes->Enumerate<RN::SceneNode>([this](RN::SceneNode *node, size_t i, bool &stop) {
+				if(!node->IsKindOfClass(RN::Camera::GetMetaClass()))
+					RegisterSceneNode(node, _networkNodes.Insert(node));
+			});
+		}
+		
+		RN::String *capture = settings->GetObjectForKey<RN::String>(RNCSTR("DPCaptureFile"));
+		if(capture && _network)
+			StartCapture(capture->GetUTF8String());
+	}
+	
+	void WorldAttachment::CreateClient()
+	{
 		RN::LockGuard<decltype(_lock)> lock(_lock);
-		ENetEvent event;
+		DestroyHost();
 		
-		enet_peer_disconnect(_peer, 0);
-		_isConnected = false;
+		ENetHost *host;
+		RN_ASSERT((host = enet_host_create(NULL, 1, kDPNetworkChannelCount, 0, 0)), "Enet couldn't create client!");
+		
+		_network = new NetworkHost(host);
+		_statistics.Reset();
+		_isServer = false;
+		
+		RN::Settings *settings = RN::Settings::GetSharedInstance();
 		
-		while(enet_host_service(_host, &event, 3000) > 0)
+		_interestRadius = settings->GetFloatForKey(RNCSTR("DPInterestRadius"), kDPInterestDefaultRadius);
+		_isInterestDirty = true;
+		
+		_stateHashInterval = settings->GetFloatForKey(RNCSTR("DPStateHashInterval"), kDPStateHashDefaultInterval);
+		_stateHashTimer = 0.0f;
+		
+		RN::String *capture = settings->GetObjectForKey<RN::String>(RNCSTR("DPCaptureFile"));
+		if(capture)
+			StartCapture(capture->GetUTF8String());
+	}
+	
+	void WorldAttachment::DestroyHost()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		delete _loadGenerator;
+		_loadGenerator = nullptr;
+		
+		Disconnect();
+		
+		_pendingTransforms.clear();
+		_pendingUnreliableTransforms.clear();
+		_continuousEditNodes.clear();
+		_pendingCorrections.clear();
+		_committedEdits.clear();
+		_transformCodec.Reset();
+		
+		_operationLog.Reset();
+		_operationSequencer.Clear();
+		
+		_stringTable.Reset();
+		_stringTable.SetAuthoritative(false);
+		
+		_interestManager.Reset();
+		_peerTransformCodecs.clear();
+		_peerBacklog.clear();
+		
+		_peerHandles.clear();
+		_handleBlock.clear();
+		_isAwaitingHandles = false;
+		
+		_stateHash.Clear();
+		_dirtyStateHashes.clear();
+		_stateHashTimer = 0.0f;
+		
+		RollbackProvisionalOperations();
+		
+		delete _workerPool;
+		_workerPool = nullptr;
+		
+		for(Packet *packet : _deferredPackets)
+			packet->Release();
+		
+		_deferredPackets.clear();
+		_isAwaitingWorld = false;
+		
+		StopCapture();
+		
+		// A partially received snapshot is kept, so that the next connection can resume the transfer
+		_snapshotCache.Reset();
+		CloseSnapshotProgress();
+	}
+	
+	void WorldAttachment::Connect(const std::string &ip)
+	{
+		if(!_network || _isServer)
+			return;
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		ENetAddress address;
+		
+		/* Connect to some.server.net:1234. */
+		enet_address_set_host(&address, ip.c_str());
+		address.port = 2003;
+		
+		/* The connection is established on the I/O thread, StepClient() requests the world once it succeeded. */
+		_serverAddress = ip;
+		_serverPeer = _network->Connect(address);
+	}
+	
+	bool WorldAttachment::StartCapture(const std::string &path)
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		if(!_network)
+			return false;
+		
+		return _capture.Open(path, _isServer ? PacketCapture::Role::Server : PacketCapture::Role::Client);
+	}
+	
+	void WorldAttachment::StopCapture()
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		_capture.Close();
+	}
+	
+	bool WorldAttachment::StartLoadTest(const LoadGenerator::Configuration &configuration)
+	{
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		if(_loadGenerator)
+			return false;
+		
+		if(!_network || !_isServer)
+			CreateServer();
+		
+		std::vector<NetworkHandle> nodes;
+		nodes.reserve(_networkNodes.GetCount());
+		
+		_networkNodes.Enumerate([&](NetworkHandle handle, RN::SceneNode *node) {
+			nodes.push_back(handle);
+		});
+		
+		RNInfo("Downpour: Starting load test with %u clients for %.1f seconds", static_cast<uint32>(configuration.clients), configuration.duration);
+		
+		_loadGenerator = new LoadGenerator(configuration, nodes);
+		return true;
+	}
+	
+	void WorldAttachment::FinishLoadTest()
+	{
+		RN::String *report = _loadGenerator->CreateReport();
+		
+		delete _loadGenerator;
+		_loadGenerator = nullptr;
+		
+		RNInfo("Downpour: %s", report->GetUTF8String());
+		
+		if(Workspace::GetSharedInstance())
+			InfoPanel::WithMessage(report);
+	}
+	
+	bool WorldAttachment::ReplayCapture(const std::string &path)
+	{
+		PacketCaptureReader reader;
+		
+		if(!reader.Open(path) || reader.GetRole() != PacketCapture::Role::Server)
+			return false;
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		// The replay runs the server without a network host, everything it sends is only counted
+		DestroyHost();
+		PrepareServer();
+		
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t packets = 0;
+		
+		PacketCaptureReader::Record record;
+		
+		while(true)
 		{
-			switch(event.type)
+			RN::AutoreleasePool pool;
+			
+			if(!reader.ReadRecord(record))
+				break;
+			
+			NetworkHost::Event event;
+			event.peer = record.peer;
+			event.packet = nullptr;
+			
+			switch(record.kind)
 			{
-				case ENET_EVENT_TYPE_RECEIVE:
-					enet_packet_destroy(event.packet);
+				case PacketCapture::Kind::Connect:
+					event.type = NetworkHost::Event::Type::Connect;
+					HandleServerEvent(event);
 					break;
 					
-				case ENET_EVENT_TYPE_DISCONNECT:
-					_peer = nullptr;
-					return;
+				case PacketCapture::Kind::Disconnect:
+					event.type = NetworkHost::Event::Type::Disconnect;
+					HandleServerEvent(event);
+					break;
 					
-				default:
+				case PacketCapture::Kind::Received:
+					event.type = NetworkHost::Event::Type::Receive;
+					event.packet = record.packet->Retain();
+					
+					HandleServerEvent(event);
+					
+					packets ++;
+					break;
+					
+				case PacketCapture::Kind::Step:
+				{
+					// Steps happen exactly where they happened in the session, so batching and catch ups are the same
+					{
+						NetworkStatistics::Timer timer(_statistics, NetworkStatistics::Timer::Kind::Step);
+						
+						_catchUpTimer += record.delta;
+						FinishServerStep();
+					}
+					
+					_statistics.Step(record.delta, nullptr);
+					break;
+				}
+					
+				case PacketCapture::Kind::Sent:
 					break;
 			}
 		}
 		
-		enet_peer_reset(_peer);
-		_peer = nullptr;
+		FinishServerStep();
+		
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+		RNInfo("Downpour: Replayed %u packets from %s in %.3f seconds", static_cast<uint32>(packets), path.c_str(), duration.count());
+		
+		DestroyHost();
+		
+		_isServer = false;
+		_isConnected = false;
+		
+		return true;
+	}
+	
+	void WorldAttachment::Disconnect()
+	{
+		if(!_network)
+			return;
+		
+		RN::LockGuard<decltype(_lock)> lock(_lock);
+		
+		// Blocks until the I/O thread gracefully disconnected all peers and shut down
+		delete _network;
+		
+		_network = nullptr;
+		_serverPeer = 0;
+		_isConnected = false;
 	}
 	
 	
 	void WorldAttachment::SendPacketToServer(Packet *packet)
 	{
-		SendPacketToPeer(_peer, packet);
+		SendPacketToPeer(_serverPeer, packet);
 	}
 	
-	void WorldAttachment::SendPacketToPeer(ENetPeer *peer, Packet *packet)
+	void WorldAttachment::SendPacketToPeer(uint32 peer, Packet *packet)
 	{
 		if(!_isConnected)
 			return;
 		
-		RN::LockGuard<decltype(_lock)> lock(_lock);
+		_statistics.RecordSent(packet);
+		_capture.RecordSent(peer, packet);
 		
-		// Encode the packet
-		RN::Data *data;
-		{
-			RN::FlatSerializer *serializer = new RN::FlatSerializer();
-			serializer->EncodeObject(packet);
-			
-			data = serializer->GetSerializedData();
-			serializer->Release();
-		}
+		if(_network)
+			_network->Send(peer, packet);
+	}
+	
+	void WorldAttachment::SendPacketToPeers(const std::vector<uint32> &peers, Packet *packet)
+	{
+		if(!_isConnected || peers.empty())
+			return;
+		
+		_statistics.RecordSent(packet, peers.size());
 		
-		ENetPacket *enetPacket = enet_packet_create(data->GetBytes(), data->GetLength(), ENET_PACKET_FLAG_RELIABLE);
-		enet_peer_send(peer, 0, enetPacket);
+		for(uint32 peer : peers)
+			_capture.RecordSent(peer, packet);
+		
+		if(_network)
+			_network->Send(peers, packet);
 	}
 	
 	void WorldAttachment::BroadcastPacket(Packet *packet)
@@ -930,19 +3172,14 @@ namespace DP
 		if(!_isConnected)
 			return;
 		
-		RN::LockGuard<decltype(_lock)> lock(_lock);
+		if(_isServer)
+			_snapshotCache.RecordPacket(packet);
 		
-		// Encode the packet
-		RN::Data *data;
-		{
-			RN::FlatSerializer *serializer = new RN::FlatSerializer();
-			serializer->EncodeObject(packet);
-			
-			data = serializer->GetSerializedData();
-			serializer->Release();
-		}
+		// Clients only ever have the server as their peer
+		_statistics.RecordSent(packet, _isServer ? _peerTransformCodecs.size() : 1);
+		_capture.RecordSent(0, packet);
 		
-		ENetPacket *enetPacket = enet_packet_create(data->GetBytes(), data->GetLength(), ENET_PACKET_FLAG_RELIABLE);
-		enet_host_broadcast(_host, 0, enetPacket);
+		if(_network)
+			_network->Broadcast(packet);
 	}
 }
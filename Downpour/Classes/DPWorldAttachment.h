@@ -21,23 +21,47 @@
 #include <Rayne/Rayne.h>
 #include <enet/enet.h>
 #include "DPPacket.h"
+#include "DPHandleTable.h"
+#include "DPStateHash.h"
+#include "DPNetworkHost.h"
+#include "DPTransformCodec.h"
+#include "DPOperationLog.h"
+#include "DPStringTable.h"
+#include "DPInterestManager.h"
+#include "DPNetworkStatistics.h"
+#include "DPPacketCapture.h"
+#include "DPLoadGenerator.h"
+#include "DPWorkerPool.h"
+#include "DPSnapshotTransfer.h"
+#include "DPLevelManager.h"
+#include "DPProgressPanel.h"
 
 #define kDPWorldAttachmentDidAddSceneNode     RNCSTR("kDPWorldAttachmentDidAddSceneNode")
 #define kDPWorldAttachmentWillRemoveSceneNode RNCSTR("kDPWorldAttachmentWillRemoveSceneNode")
 
+// Provisional nodes of a client that the server never answered for are rolled back after this many seconds
+#define kDPProvisionalTimeout 10.0f
+
+// Below this many peers the per peer transform batches are encoded on the main thread alone
+#define kDPParallelFanOutThreshold 16
+
+// Number of network handles granted to a client at once, it asks for more once half of them are used up
+#define kDPHandleBlockDefaultSize 256
+
+// Bytes the server lets queue up for a peer before it only sends it catch ups, until a quarter of it is left
+#define kDPPeerDefaultBudget (256 * 1024)
+
 namespace DP
 {
 	class WorldAttachment : public RN::WorldAttachment, public RN::ISingleton<WorldAttachment>
 	{
 	public:
-		struct TransformRequest
+		struct SessionInfo
 		{
-		public:
 			uint32 hostID;
-			uint64 lid;
-			RN::Vector3 position;
-			RN::Vector3 scale;
-			RN::Quaternion rotation;
+			float positionGrid;
+			float scaleGrid;
+			uint8 conflictPolicy;
 		};
 		
 		WorldAttachment();
@@ -45,6 +69,7 @@ namespace DP
 		
 		void Activate(RN::Camera *camera);
 		
+		void StepWorld(float delta) override;
 		void DidBeginCamera(RN::Camera *camera) override;
 		
 		void DidAddSceneNode(RN::SceneNode *node) override;
@@ -52,11 +77,14 @@ namespace DP
 		
 		void SceneNodeDidUpdate(RN::SceneNode *node, RN::SceneNode::ChangeSet changeSet) override;
 		
-		void RequestSceneNode(RN::Object *object, const RN::Vector3 &position, uint32 hostID=-1);
+		bool RequestSceneNode(RN::Object *object, const RN::Vector3 &position, uint32 hostID=-1, uint32 provisional=0);
 		RN::SceneNode *CreateSceneNode(RN::Object *object, const RN::Vector3 &position);
 		void DeleteSceneNodes(RN::Array *sceneNodes);
-		void DuplicateSceneNodes(RN::Array *sceneNodes, uint32 hostID=-1);
-		void ApplyTransforms(const TransformRequest &request);
+		void DuplicateSceneNodes(RN::Array *sceneNodes, uint32 hostID=-1, uint32 provisional=0);
+		bool ApplyTransforms(const TransformRequest &request, bool reliable = true);
+		
+		void BeginContinuousEdit();
+		void EndContinuousEdit();
 		void RequestSceneNodePropertyChange(RN::SceneNode *node, const std::string &name, RN::Object *object, uint32 hostID=-1);
 		
 		void StepServer();
@@ -69,24 +97,109 @@ namespace DP
 		void Connect(const std::string &ip);
 		void Disconnect();
 		
+		bool StartCapture(const std::string &path);
+		void StopCapture();
+		bool IsCapturing() const { return _capture.IsOpen(); }
+		
+		bool ReplayCapture(const std::string &path);
+		
+		bool StartLoadTest(const LoadGenerator::Configuration &configuration);
+		bool IsRunningLoadTest() const { return (_loadGenerator != nullptr); }
 		
 		void SendPacketToServer(Packet *packet);
-		void SendPacketToPeer(ENetPeer *peer, Packet *packet);
+		void SendPacketToPeer(uint32 peer, Packet *packet);
+		void SendPacketToPeers(const std::vector<uint32> &peers, Packet *packet);
 		void BroadcastPacket(Packet *packet);
 		
 		bool IsServer() const { return _isServer; }
 		bool IsConnected() const { return _isConnected; }
+		bool HasNetwork() const { return (_network != nullptr); }
+		bool IsContinuousEdit() const { return _isContinuousEdit; }
+		
+		RN::Camera *GetCamera() const { return _camera; }
+		RN::Array *GetSelection() const { return _sceneNodes; }
+		
+		const NetworkStatistics &GetStatistics() const { return _statistics; }
+		LevelManager &GetLevelManager() { return _levelManager; }
+		
+		// Nodes of the editor itself are neither synchronized nor journaled
+		static bool IsEditorSceneNode(RN::SceneNode *node);
 		
 	private:
-		void HandleSceneNodeDeletion(const std::vector<uint64> &ids);
-		void RegisterSceneNodeRecursive(RN::SceneNode *node);
+		void QueueTransform(RN::SceneNode *node, NetworkHandle handle, uint32 hostID, uint32 edit, bool reliable);
+		void QueueCorrection(RN::SceneNode *node, NetworkHandle handle, uint32 hostID, uint32 edit);
+		void FlushTransforms();
+		void FlushTransforms(std::unordered_map<NetworkHandle, TransformRequest> &pending, bool reliable, uint8 flags);
+		
+		void FinishLoadTest();
+		
+		void BroadcastSceneNodeProperty(RN::SceneNode *node, NetworkHandle handle, const std::string &name, RN::Object *object, uint32 hostID, uint32 edit, uint8 flags);
+		void BroadcastSceneNodeDeletion(std::vector<NetworkHandle> handles);
+		void FlushStringDefinitions();
+		
+		void HandleInterestRequest(uint32 peer, Packet *packet);
+		void SendCatchUp(uint32 peer, bool interestingOnly, size_t limit = kDPInterestCatchUpLimit);
+		void HandleCatchUp(Packet *packet);
+		void UpdatePeerBudgets();
+		void PublishInterest();
+		
+		void PrepareServer();
+		void HandleServerEvent(NetworkHost::Event &event);
+		void FinishServerStep();
+		
+		void HandleClientPacket(Packet *packet);
+		bool IsOperationPacket(Packet *packet) const;
+		void ReplayDeferredPackets();
+		
+		void HandleWorldRequest(uint32 peer, Packet *packet);
+		void RefreshSnapshot();
+		void SendSnapshotTail(uint32 peer);
+		void LoadSnapshot();
+		void UpdateSnapshotProgress();
+		void CloseSnapshotProgress();
+		
+		void HandleSceneNodeDeletion(const std::vector<NetworkHandle> &handles);
+		
+		void GrantHandleBlock(uint32 peer);
+		void ReleaseHandleBlock(uint32 peer);
+		void RequestHandleBlock();
+		bool TakeHandles(size_t count, std::vector<NetworkHandle> &handles);
+		void AnnounceSceneNodes(RN::Array *sceneNodes, const std::vector<NetworkHandle> &handles);
+		void HandleSceneNodeAnnouncement(uint32 peer, Packet *packet);
+		
+		uint64 HashSceneNode(RN::SceneNode *node, NetworkHandle handle) const;
+		void HashSceneNodeProperty(NetworkHandle handle, const std::string &name, RN::Object *object);
+		void UpdateStateHashes();
+		bool IsStateSettled() const;
+		void CompareStateHash(float delta);
+		void RequestStateHashes(uint32 level, const std::vector<size_t> &indices);
+		void HandleStateHashRequest(uint32 peer, Packet *packet);
+		void HandleStateHashAnswer(Packet *packet);
+		void HandleStateResyncRequest(uint32 peer, Packet *packet);
+		void HandleStateResyncAnswer(Packet *packet);
+		
+		NetworkHandle GetNetworkHandle(RN::SceneNode *node) const;
+		std::vector<NetworkHandle> RegisterSceneNodes(RN::SceneNode *node);
+		void RegisterSceneNodes(RN::SceneNode *node, const std::vector<NetworkHandle> &handles, size_t &index);
+		void UnregisterSceneNodes(RN::SceneNode *node);
+		void RegisterSceneNode(RN::SceneNode *node, NetworkHandle handle);
+		void RegisterSceneNodeRecursive(RN::SceneNode *node, std::vector<NetworkHandle> &handles);
+		void RegisterSceneNodeRecursive(RN::SceneNode *node, const std::vector<NetworkHandle> &handles, size_t &index);
 		void UnregisterSceneNodeRecursive(RN::SceneNode *node);
+		void CollectNetworkHandles(RN::SceneNode *node, std::vector<NetworkHandle> &handles) const;
+		RN::Array *CopySceneNodes(RN::Array *sceneNodes);
+		
+		uint32 BeginProvisionalOperation(const std::vector<RN::SceneNode *> &nodes);
+		void ResolveProvisionalOperation(uint32 provisional, const std::vector<RN::SceneNode *> &nodes);
+		void ExpireProvisionalOperations(float delta);
+		void RollbackProvisionalOperations();
 		
 		RN::Array *_sceneNodes;
 		RN::Camera *_camera;
 		
-		ENetHost *_host;
-		ENetPeer *_peer;
+		NetworkHost *_network;
+		uint32 _serverPeer;
+		std::string _serverAddress;
 		
 		uint32 _hostID;
 		uint32 _clientCount;
@@ -95,11 +208,85 @@ namespace DP
 		bool _isServer;
 		bool _isRemoteChange;
 		bool _isLoadingWorld;
+		bool _isContinuousEdit;
+		bool _isAwaitingWorld;
+		
+		uint32 _editCounter;
+		std::unordered_set<NetworkHandle> _continuousEditNodes;
+		
+		// Nodes a client created or duplicated locally ahead of the servers answer. They are never registered,
+		// so nothing about them goes out until the server confirmed them under their real handles
+		struct ProvisionalNode
+		{
+			RN::SceneNode *node;
+			RN::Vector3 position;
+			RN::Quaternion rotation;
+			RN::Vector3 scale;
+		};
+		
+		struct ProvisionalOperation
+		{
+			std::vector<ProvisionalNode> nodes;
+			float age;
+		};
+		
+		std::unordered_map<uint32, ProvisionalOperation> _provisionalOperations;
+		uint32 _provisionalCounter;
+		std::unordered_map<uint32, uint32> _committedEdits;
 		
-		std::unordered_map<uint64, RN::SceneNode*> _sceneNodeLookup;
+		// Handles are the network identity of a node, the reverse map is needed because the engine has no slot for them
+		HandleTable<RN::SceneNode *> _networkNodes;
+		std::unordered_map<RN::SceneNode *, NetworkHandle> _networkHandles;
+		std::unordered_map<uint64, NetworkHandle> _snapshotHandles;
+		
+		// Handles the server reserved for each client, and on a client the ones it was granted but didn't use yet
+		std::unordered_map<uint32, std::unordered_set<NetworkHandle>> _peerHandles;
+		std::deque<NetworkHandle> _handleBlock;
+		size_t _handleBlockSize;
+		bool _isAwaitingHandles;
+		
+		StateHashTree _stateHash;
+		std::unordered_set<NetworkHandle> _dirtyStateHashes;
+		float _stateHashInterval;
+		float _stateHashTimer;
+		
+		std::unordered_map<NetworkHandle, TransformRequest> _pendingTransforms;
+		std::unordered_map<NetworkHandle, TransformRequest> _pendingUnreliableTransforms;
+		std::unordered_map<NetworkHandle, TransformRequest> _pendingCorrections;
+		TransformCodec _transformCodec;
+		
+		OperationLog _operationLog;
+		OperationSequencer _operationSequencer;
+		std::vector<Packet *> _deferredPackets;
+		
+		StringTable _stringTable;
+		
+		InterestManager _interestManager;
+		std::unordered_map<uint32, TransformCodec> _peerTransformCodecs;
+		WorkerPool *_workerPool;
+		float _catchUpTimer;
+		
+		size_t _peerBudget;
+		std::unordered_map<uint32, size_t> _peerBacklog;
+		
+		float _interestRadius;
+		RN::Vector3 _publishedInterestCenter;
+		bool _isInterestDirty;
+		
+		NetworkStatistics _statistics;
+		PacketCapture _capture;
+		LoadGenerator *_loadGenerator;
+		
+		SnapshotCache _snapshotCache;
+		SnapshotReceiver _snapshotReceiver;
+		std::string _snapshotAddress;
+		ProgressPanel *_snapshotProgress;
 		
 		RN::RecursiveSpinLock _lock;
 		
+		// Shares the lock above, so it has to come after it
+		LevelManager _levelManager;
+		
 		RN::MetaClass *_lightClass;
 		RN::MetaClass *_cameraClass;
 		